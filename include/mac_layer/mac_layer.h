@@ -11,6 +11,7 @@
 #include <mac_layer/resource_grid.h>
 #include <ue/ue.h>
 #include <threading/thread_pool.h>
+#include <utils/monitoring/metric_window.h>
 
 //--------------------------------------------------------------------------------------------------
 // mac_layer(): class which interfaces the resource allocation grids with other modules from the 
@@ -46,6 +47,8 @@ public:
     int get_rbg_size();
     int get_logical_units();
     void init(std::vector<ue> *ue_list);
+    void register_monitoring();
+    void flush_monitoring();
     void step(float current_t);
 
 public: 
@@ -68,4 +71,5 @@ private:
     int bandwidth; 
     bool log;   
     int verbosity = 0;    
+    metric_window scheduler_window[2]; // Local windows of the mac_scheduler series, dl and ul
 };
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+// Data plane used by the real UEs of a [UE] block (capture_backend key).
+enum class capture_backend
+{
+    NFQUEUE,     // Netfilter queues (ul_queue_n/dl_queue_n)
+    PACKET_MMAP, // AF_PACKET TPACKET_V2 rings between two interfaces (ul_if_in -> ul_if_out, ...)
+    SYNTHETIC    // In process replay of a trace file (ul_trace/dl_trace), no kernel involved
+};
+
+// Per direction capture settings of a real UE, besides the NFQUEUE number.
+struct capture_config
+{
+    capture_backend backend = capture_backend::NFQUEUE;
+    // PACKET_MMAP: frames received on if_in are emulated and sent out of if_out
+    std::string if_in;
+    std::string if_out;
+    // SYNTHETIC: pcap or "<time_s> <bytes>" trace, replay speed (0 = as fast as possible), looping
+    // and ECN codepoint of the generated packets
+    std::string trace;
+    float speed = 1.0f;
+    bool loop = false;
+    int ecn = 0;
+};
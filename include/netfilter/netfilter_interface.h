@@ -2,10 +2,17 @@
 #define NETFILTER_INTERFACE_H
 
 //#define DEBUG_NETFILTER_INTERFACE // Uncomment/Comment to enable/disable debug
+#include <stddef.h>
 #include <stdint.h>
 #include <functional>
 #include <vector>
 
+#include <netfilter/nfqueue_config.h>
+
+struct mmsghdr;
+struct iovec;
+struct sockaddr_nl;
+
 extern "C" {
 
 typedef struct netfilter_interface netfilter_interface_t;
@@ -17,7 +24,13 @@ struct nfq_packet_metadata
 	uint64_t bytes = 0;
 	uint32_t pkt_id = 0;
 	uint8_t ecn = 0;
-	std::vector<uint8_t> payload;
+	// GSO super-packet: number of segments it stands for and the header bytes each extra one adds
+	bool gso = false;
+	uint32_t segments = 1;
+	uint32_t segment_hdr_bytes = 0;
+	// Copied part of the packet (up to copy_range bytes), only valid during the callback
+	const uint8_t *payload = nullptr;
+	uint32_t payload_len = 0;
 };
 
 typedef std::function<void(void*, netfilter_interface_t*, const nfq_packet_metadata&)> add_pkt_callback_t;
@@ -28,23 +41,49 @@ struct netfilter_interface {
 	struct mnl_socket *nl;
 	add_pkt_callback_t callback;
 	void *callback_data;
-	char *buf;
+	char *buf; // recv_batch receive buffers of sizeof_buf bytes
 	size_t sizeof_buf;
-	pthread_t tid;
+	unsigned int copy_range; // Bytes of each packet copied to userspace (NFQNL_COPY_PACKET range)
+	unsigned int recv_batch;
+	struct mmsghdr *msgs;
+	struct iovec *iovs;
+	struct sockaddr_nl *addrs;
 	uint32_t last_recv_id; // Last received packed it (for debug)
 	uint32_t total_recv; // Total received packets (for debug)
 	uint32_t bytes_recv;
 	uint32_t last_rlsd_id; // Last released packed it (for debug)
 	uint32_t total_rlsd; // Total released packets (for debug)
 	uint32_t recv_fails;
+	uint32_t kernel_drops; // ENOBUFS: the socket overran and the kernel dropped packets
+	uint32_t parse_fails; // Messages we could not parse
+	uint32_t overflow_drops; // Packets dropped by the receive thread because the consumer was full
+	uint32_t gso_pkts; // GSO super-packets received (only with nfqueue_config::gso)
 	uint32_t rlsd_fails;
+	uint32_t rlsd_batches; // Verdict sendto calls
+	char *vbuf; // Pending verdict messages, sent together by netfilter_interface_flush_verdicts()
+	struct mnl_nlmsg_batch *vbatch;
+	uint32_t vbatch_pkts;
+	uint32_t vbatch_last_id;
 };
 
+// Applies to the queues opened afterwards; call before the first netfilter_interface_open().
+void netfilter_interface_configure(const nfqueue_config *cfg);
+nfqueue_config netfilter_interface_get_config();
+
 netfilter_interface_t *netfilter_interface_open(int queue_num, add_pkt_callback_t callback, void *handler);
 
 int netfilter_interface_release_pkt(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept);
+// Immediate DROP from the receive thread, for packets the consumer has no room for. Only touches
+// receive side counters, so it is safe next to the slot thread's batched verdicts.
+int netfilter_interface_drop_overflow(netfilter_interface_t *nfiface, uint32_t pkt_id);
 int netfilter_interface_release_pkt_payload(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, const uint8_t *payload, uint32_t payload_len);
 
+// Batched verdicts: queue_verdict appends a NFQNL_MSG_VERDICT message to the pending batch (payload may
+// be NULL) and flush_verdicts sends every pending message with a single sendto.
+int netfilter_interface_queue_verdict(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, const uint8_t *payload, uint32_t payload_len);
+int netfilter_interface_queue_verdict_mark(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, uint32_t mark);
+int netfilter_interface_flush_verdicts(netfilter_interface_t *nfiface);
+
 void netfilter_interface_close(netfilter_interface_t *nfiface);
 
 }
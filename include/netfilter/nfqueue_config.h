@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// Process wide settings of the NFQUEUE receive path, shared by every queue ([NFQueue] section).
+struct nfqueue_config
+{
+    // > 0: set SO_BUSY_POLL (usec) on the queue sockets and spin on epoll instead of sleeping
+    // in it. Trades a core for wake-up latency, meant for latency-critical lab runs.
+    int busy_poll_us = 0;
+    // Receiver threads (max 16); queue q is read by thread q % receive_threads. Raise it together
+    // with queue balance ranges (ul_queue_n: 100:103) to spread one UE over several cores.
+    int receive_threads = 1;
+    // Datagrams fetched per recvmmsg call; each one gets its own receive buffer.
+    int recv_batch = 16;
+    // > 0: socket receive buffer size, forced with SO_RCVBUFFORCE (falls back to SO_RCVBUF).
+    int rcvbuf_bytes = 0;
+    // Do not report kernel side overruns (ENOBUFS); lost packets are then silently dropped.
+    bool no_enobufs = false;
+    // Bytes of each packet copied to userspace. 0xffff copies whole packets; a small value (e.g. 64)
+    // copies only the headers, which is all the emulator needs unless packets are CE marked.
+    int copy_range = 0xffff;
+    // Packet mark set on ACCEPT_CE verdicts of packets captured truncated (copy_range shorter than the
+    // packet): the kernel cannot splice a mangled header into a longer packet, so CE has to be applied
+    // by a rule matching this mark after the queue (e.g. nft "meta mark 0x1 ip ecn set ce"). 0 disables.
+    uint32_t ce_mark = 0;
+    // Slots of the ring handing captured packets from the receive thread to the slot thread. Packets
+    // arriving while it is full are dropped right away (nfqueue_overflow_drops).
+    int capture_ring = 1024;
+    // Request NFQA_CFG_F_GSO: GSO/GRO super-packets are queued whole instead of being segmented by the
+    // kernel first. They are accounted as the gso_mss sized segments they will be sent as, and CE on
+    // them always goes through ce_mark (rewriting their payload would drop the checksum offload state).
+    bool gso = false;
+    int gso_mss = 1448;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <netfilter/pkt_capture.h>
+
+// Ring geometry (TPACKET_V2): 2 KB frames hold a 1500 byte MTU frame plus the tpacket header.
+#define PACKET_MMAP_FRAME_SIZE 2048
+#define PACKET_MMAP_BLOCK_SIZE (1 << 20)
+#define PACKET_MMAP_RX_FRAMES 4096
+#define PACKET_MMAP_TX_FRAMES 4096
+
+//--------------------------------------------------------------------------------------------------
+// packet_mmap_capture(): capture backend for a bump in the wire between two interfaces, as an
+// alternative to Netfilter Queues. Frames arriving on if_in are read from a mmap'ed AF_PACKET RX
+// ring by a receive thread and go through the same SPSC ring as NFQUEUE packets; accepted frames
+// are written to a TX ring on if_out and sent with one send() per slot (flush_verdicts()), so there
+// is no per packet syscall in either direction. if_in is put in promiscuous mode (the opposite
+// direction does the same for if_out) and frames are forwarded unchanged, so the endpoints must
+// share an L2 segment through the emulator (e.g. veth pairs in network namespaces). Non IPv4 frames
+// (ARP, ...) are forwarded right away without emulation. ACCEPT_CE rewrites the IPv4 header in
+// place, there is no kernel mangling limit here. Each forwarded frame is copied twice: from the RX
+// ring into the slab slot where it waits for its verdict, and from there into the TX ring. Frames
+// larger than a ring slot (GSO/GRO super-frames) are dropped, so TSO, GSO and GRO must be off on
+// the interfaces along the path. Needs CAP_NET_RAW.
+// Input:
+//      _if_in: interface the frames of this direction arrive on.
+//      _if_out: interface they leave from.
+//--------------------------------------------------------------------------------------------------
+class packet_mmap_capture : public pkt_capture
+{
+public:
+    packet_mmap_capture(std::string _if_in, std::string _if_out);
+    ~packet_mmap_capture() override;
+
+    void start() override;
+    void close() override;
+    void verdict(uint32_t pkt_id, packet_capture_action action) override;
+    void flush_verdicts() override;
+    packet_capture_stats stats() const override;
+
+protected:
+    // Frame level handling, apart from the sockets so it can be fed built frames. use_tx_ring()
+    // points the TX side at a caller owned TPACKET_V2 ring; detach it (nullptr) before close().
+    void handle_frame(const uint8_t* frame, uint32_t len, uint32_t wire_len, uint64_t arrival_us);
+    void transmit(const uint8_t* frame, uint32_t len);
+    void use_tx_ring(uint8_t* ring, size_t size)
+    {
+        tx_ring = ring;
+        tx_ring_size = size;
+        tx_frame = 0;
+    }
+
+private:
+    bool open_rx();
+    bool open_tx();
+    void receive_loop();
+
+private:
+    std::string if_in;
+    std::string if_out;
+
+    int rx_fd = -1;
+    uint8_t *rx_ring = nullptr;
+    size_t rx_ring_size = 0;
+    uint32_t rx_frame = 0;
+
+    int tx_fd = -1;
+    uint8_t *tx_ring = nullptr;
+    size_t tx_ring_size = 0;
+    uint32_t tx_frame = 0;
+    uint32_t tx_pending = 0;
+
+    int pass_fd = -1; // Plain socket on if_out for the frames forwarded by the receive thread
+    int stop_fd = -1;
+    std::thread rx_thread;
+
+    uint32_t next_id = 0;
+    std::atomic<uint32_t> total_recv{0};
+    std::atomic<uint32_t> bytes_recv{0};
+    std::atomic<uint32_t> overflow_drops{0};
+    std::atomic<uint32_t> gso_pkts{0}; // Truncated GSO/GRO frames, dropped
+    uint32_t total_rlsd = 0;
+    std::atomic<uint32_t> rlsd_fails{0}; // Also counts pass through send() failures of the receive thread
+    uint32_t rlsd_batches = 0;
+};
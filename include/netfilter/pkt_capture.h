@@ -2,15 +2,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <deque>
 #include <iostream>
 #include <functional>
-#include <mutex>
-#include <unordered_map>
+#include <memory>
 #include <vector>
 #include <netfilter/netfilter_interface.h>
+#include <pdcp_layer/uid_ring.h>
 #include <pkts/pkts.h>
+#include <utils/spsc_ring.h>
 #include <utils/terminal_logging.h>
 
 struct packet_capture_stats
@@ -20,7 +21,12 @@ struct packet_capture_stats
     uint32_t total_rlsd = 0;
     uint32_t bytes_recv = 0;
     uint32_t recv_fails = 0;
+    uint32_t kernel_drops = 0;
+    uint32_t parse_fails = 0;
+    uint32_t overflow_drops = 0;
+    uint32_t gso_pkts = 0;
     uint32_t rlsd_fails = 0;
+    uint32_t rlsd_batches = 0;
 };
 
 enum class packet_capture_action
@@ -35,28 +41,72 @@ struct captured_packet_info
     uint64_t bytes = 0;
     uint32_t pkt_id = 0;
     uint8_t ecn = ECN_NOT_ECT;
+    // Arrival time, microseconds since the epoch: NFQA_TIMESTAMP when the kernel provides it, else
+    // taken by the receive thread. 0 if unknown.
+    uint64_t arrival_us = 0;
+    // GSO super-packet, sent out as segments copies of its headers (segment_hdr_bytes) plus MSS
+    bool gso = false;
+    uint32_t segments = 1;
+    uint32_t segment_hdr_bytes = 0;
 };
 
+// Largest slab slot; longer captured packets get their own buffer.
+#define PKT_CAPTURE_SLAB_SLOT_MAX 2048
+// The slab grows by chunks of slots up to a fixed number of chunks, so a slot never moves once
+// the receive thread has written it. Packets beyond that get their own buffer too.
+#define PKT_CAPTURE_SLAB_CHUNK_SLOTS 256
+#define PKT_CAPTURE_SLAB_CHUNKS 1024
+
 //--------------------------------------------------------------------------------------------------
 // pkt_capture(): simple class which interfaces with the C API provided by Netfilter Queues to
 // assign callbacks to the configured Netfilter Queues. This class is instanced for each transmission
 // direction (DL/UL) for each UE attached to actual IP traffic. It configures a callback associated 
 // to the specific Netfilter Queue. There are two methods (release(id)/drop(id)) defined by this class 
 // to send the appropiate command to Netfilter Queues. 
+// Captured packets go from the receive thread to the slot thread through a lock free SPSC ring, so
+// neither side waits for the other. The receive thread copies each packet once, straight into the
+// slab slot where it waits for the verdict; freed slots go back to it through a second SPSC ring.
+// Everything else is only touched by the slot thread.
 // Input: 
 //      _queue_num: the queue id for the Netfilter Queue that we want this instance to handle.
 //--------------------------------------------------------------------------------------------------
 class pkt_capture
 {
 public:
-    pkt_capture(int _queue_num)
+    pkt_capture(int _queue_num) : pkt_capture(_queue_num, ring_capacity()) {}
+
+    virtual ~pkt_capture()
+    {
+        close();
+    }
+
+protected:
+    static size_t ring_capacity()
+    {
+        int n = netfilter_interface_get_config().capture_ring;
+        return n > 0 ? (size_t)n : 1024;
+    }
+
+    // slot_size: bytes of each slab slot; 0 sizes them from [NFQueue] copy_range. Backends that do
+    // not copy through Netfilter pass the largest packet they can deliver instead.
+    pkt_capture(int _queue_num, size_t ring_slots, uint32_t slot_size = 0)
+        : ring(ring_slots),
+          free_ring(PKT_CAPTURE_SLAB_CHUNK_SLOTS * PKT_CAPTURE_SLAB_CHUNKS),
+          slab(PKT_CAPTURE_SLAB_CHUNKS)
     {
         queue_num_v = _queue_num;
+        nfqueue_config cfg = netfilter_interface_get_config();
+        ce_mark = cfg.ce_mark;
+        if(slot_size == 0) slot_size = cfg.copy_range > 0 ? (uint32_t)cfg.copy_range : PKT_CAPTURE_SLAB_SLOT_MAX;
+        slot_bytes = slot_size < PKT_CAPTURE_SLAB_SLOT_MAX ? slot_size : PKT_CAPTURE_SLAB_SLOT_MAX;
     }
 
-    virtual ~pkt_capture()
+    // Base of a capture that only forwards to other pkt_capture instances and never stores packets
+    // itself: no ring entries, slab or free slot ring are allocated.
+    struct no_storage {};
+    pkt_capture(int _queue_num, no_storage) : ring(1), free_ring(1)
     {
-        close();
+        queue_num_v = _queue_num;
     }
 
 public:
@@ -87,61 +137,92 @@ public:
         prev_id = id; 
     }
 
+    //----------------------------------------------------------------------------------------------
+    // verdict(): queues the verdict for pkt_id. Verdicts are only sent to the kernel by
+    // flush_verdicts(), which the owner calls once per slot after its release pass.
+    // ACCEPT_CE of a fully copied packet sends back the copy with the IPv4 ECN field set to CE. The
+    // kernel replaces the whole packet with the verdict payload, so a header only capture (copy_range
+    // shorter than the packet) cannot be mangled, and neither can a GSO super-packet, whose checksum
+    // offload state the mangling would reset. Those are accepted with ce_mark instead, leaving the CE
+    // marking to a rule after the queue; segmentation then copies CE to every segment.
+    //----------------------------------------------------------------------------------------------
     virtual void verdict(uint32_t pkt_id, packet_capture_action action)
     {
-        std::lock_guard<std::mutex> lock(mtx);
         check_pkt_order((int)pkt_id);
-
-        if(action == packet_capture_action::DROP)
+        stored_payload *stored = payloads.find(pkt_id);
+        if(nfiface == nullptr || action != packet_capture_action::ACCEPT_CE)
         {
-            netfilter_interface_release_pkt(nfiface, pkt_id, 0);
-            payloads.erase(pkt_id);
+            if(nfiface != nullptr) netfilter_interface_queue_verdict(nfiface, pkt_id, action == packet_capture_action::ACCEPT, nullptr, 0);
+            if(stored != nullptr) release_payload(pkt_id, *stored);
             return;
         }
 
-        if(action == packet_capture_action::ACCEPT)
+        if(stored == nullptr)
         {
-            netfilter_interface_release_pkt(nfiface, pkt_id, 1);
-            payloads.erase(pkt_id);
+            LOG_ERROR_I("pkt_capture::verdict") << "Missing payload for pkt_id " << pkt_id
+                                                << " with ACCEPT_CE; falling back to DROP" << END();
+            netfilter_interface_queue_verdict(nfiface, pkt_id, 0, nullptr, 0);
             return;
         }
 
-        std::unordered_map<uint32_t, stored_payload>::iterator it = payloads.find(pkt_id);
-        if(it == payloads.end())
+        if(stored->truncated || stored->gso)
         {
-            LOG_ERROR_I("pkt_capture::verdict") << "Missing payload for pkt_id " << pkt_id
-                                                << " with ACCEPT_CE; falling back to DROP" << END();
-            netfilter_interface_release_pkt(nfiface, pkt_id, 0);
+            if(ce_mark != 0) netfilter_interface_queue_verdict_mark(nfiface, pkt_id, 1, ce_mark);
+            else
+            {
+                if(!warned_truncated_ce) LOG_WARNING_I("pkt_capture::verdict") << "Queue " << queue_num_v
+                    << " got a header only or GSO packet to CE mark and ce_mark is not set; accepting it unmarked" << END();
+                warned_truncated_ce = true;
+                netfilter_interface_queue_verdict(nfiface, pkt_id, 1, nullptr, 0);
+            }
+            release_payload(pkt_id, *stored);
             return;
         }
 
-        apply_ipv4_ecn(it->second.payload, ECN_CE);
-        netfilter_interface_release_pkt_payload(nfiface, pkt_id, 1, it->second.payload.data(),
-                                                (uint32_t)it->second.payload.size());
-        payloads.erase(it);
+        uint8_t *data = payload_data(*stored);
+        apply_ipv4_ecn(data, stored->len, ECN_CE);
+        netfilter_interface_queue_verdict(nfiface, pkt_id, 1, data, stored->len);
+        release_payload(pkt_id, *stored);
+    }
+
+    virtual void flush_verdicts()
+    {
+        if(nfiface != nullptr) netfilter_interface_flush_verdicts(nfiface);
     }
 
 public:
+    //----------------------------------------------------------------------------------------------
+    // pop_captured_packet(): takes the oldest packet out of the ring (slot thread only). Its bytes
+    // stay in the slab slot the receive thread wrote them to until the verdict.
+    //----------------------------------------------------------------------------------------------
     virtual bool pop_captured_packet(captured_packet_info& out)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        if(captured_packets.empty()) return false;
-        out = captured_packets.front();
-        captured_packets.pop_front();
+        capture_descriptor *d = ring.front();
+        if(d == nullptr) return false;
+        out = d->info;
+
+        stored_payload stored;
+        stored.len = d->len;
+        stored.truncated = d->len < d->info.bytes;
+        stored.gso = d->info.gso;
+        stored.original_ecn = d->info.ecn;
+        stored.slot = d->slot;
+        if(!d->large.empty()) stored.large.swap(d->large);
+        ring.pop();
+        payloads.insert(out.pkt_id, std::move(stored));
         return true;
     }
 
-    int captured_queue_size() const
+    virtual int captured_queue_size() const
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        return (int)captured_packets.size();
+        return (int)ring.size();
     }
 
-    bool peek_oldest_captured(captured_packet_info& out) const
+    virtual bool peek_oldest_captured(captured_packet_info& out) const
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        if(captured_packets.empty()) return false;
-        out = captured_packets.front();
+        const capture_descriptor *d = ring.front();
+        if(d == nullptr) return false;
+        out = d->info;
         return true;
     }
 
@@ -152,7 +233,6 @@ public:
 
     virtual packet_capture_stats stats() const
     {
-        std::lock_guard<std::mutex> lock(mtx);
         packet_capture_stats out;
         out.queue_num = queue_num_v;
         if(nfiface == nullptr) return out;
@@ -160,18 +240,34 @@ public:
         out.total_rlsd = nfiface->total_rlsd;
         out.bytes_recv = nfiface->bytes_recv;
         out.recv_fails = nfiface->recv_fails;
+        out.kernel_drops = nfiface->kernel_drops;
+        out.parse_fails = nfiface->parse_fails;
+        out.overflow_drops = nfiface->overflow_drops;
+        out.gso_pkts = nfiface->gso_pkts;
         out.rlsd_fails = nfiface->rlsd_fails;
+        out.rlsd_batches = nfiface->rlsd_batches;
         return out;
     }
 
 private:
+    // Copied bytes of a captured packet: a slab slot, or its own buffer when longer than a slot.
     struct stored_payload
     {
-        stored_payload() {}
-        stored_payload(std::vector<uint8_t> _payload, uint8_t _original_ecn)
-            : payload(std::move(_payload)), original_ecn(_original_ecn) {}
-        std::vector<uint8_t> payload;
+        uint32_t slot = 0;
+        uint32_t len = 0;
+        bool truncated = false;
+        bool gso = false;
         uint8_t original_ecn = ECN_NOT_ECT;
+        std::vector<uint8_t> large;
+    };
+
+    // Ring entry; the copied bytes live in slab slot unless they needed large.
+    struct capture_descriptor
+    {
+        captured_packet_info info;
+        uint32_t len = 0;
+        uint32_t slot = 0;
+        std::vector<uint8_t> large;
     };
 
     static uint16_t ipv4_checksum(const uint8_t* data, size_t len)
@@ -186,25 +282,110 @@ private:
         return (uint16_t)(~sum);
     }
 
-    static void apply_ipv4_ecn(std::vector<uint8_t>& payload, uint8_t ecn)
+protected:
+    static void apply_ipv4_ecn(uint8_t* payload, size_t len, uint8_t ecn)
     {
-        if(payload.size() < 20) return;
+        if(len < 20) return;
         uint8_t ihl = (payload[0] & 0x0f) * 4;
-        if(ihl < 20 || payload.size() < ihl) return;
+        if(ihl < 20 || len < ihl) return;
         payload[1] = (payload[1] & 0xfc) | (ecn & 0x03);
         payload[10] = 0;
         payload[11] = 0;
-        uint16_t csum = ipv4_checksum(payload.data(), ihl);
+        uint16_t csum = ipv4_checksum(payload, ihl);
         payload[10] = (uint8_t)(csum >> 8);
         payload[11] = (uint8_t)(csum & 0xff);
     }
 
+    // Bytes stored for pkt_id by pop_captured_packet(), nullptr if none.
+    uint8_t* stored_bytes(uint32_t pkt_id, uint32_t& len)
+    {
+        stored_payload *stored = payloads.find(pkt_id);
+        if(stored == nullptr) return nullptr;
+        len = stored->len;
+        return payload_data(*stored);
+    }
+
+    void forget_stored(uint32_t pkt_id)
+    {
+        stored_payload *stored = payloads.find(pkt_id);
+        if(stored != nullptr) release_payload(pkt_id, *stored);
+    }
+
+private:
+    uint8_t* payload_data(stored_payload& stored)
+    {
+        if(!stored.large.empty()) return stored.large.data();
+        return slot_data(stored.slot);
+    }
+
+    uint8_t* slot_data(uint32_t slot)
+    {
+        return slab[slot / PKT_CAPTURE_SLAB_CHUNK_SLOTS].get() + (size_t)(slot % PKT_CAPTURE_SLAB_CHUNK_SLOTS) * slot_bytes;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // take_slot(): receive thread side of the slab. Reuses a slot freed by the slot thread, else the
+    // next one of the newest chunk, adding a chunk when that one is used up.
+    // Output: false once all PKT_CAPTURE_SLAB_CHUNKS chunks are in use.
+    //----------------------------------------------------------------------------------------------
+    bool take_slot(uint32_t& slot)
+    {
+        uint32_t *freed = free_ring.front();
+        if(freed != nullptr)
+        {
+            slot = *freed;
+            free_ring.pop();
+            return true;
+        }
+        if(fresh_slot % PKT_CAPTURE_SLAB_CHUNK_SLOTS == 0)
+        {
+            uint32_t chunk = fresh_slot / PKT_CAPTURE_SLAB_CHUNK_SLOTS;
+            if(chunk >= PKT_CAPTURE_SLAB_CHUNKS) return false;
+            slab[chunk].reset(new uint8_t[(size_t)PKT_CAPTURE_SLAB_CHUNK_SLOTS * slot_bytes]);
+        }
+        slot = fresh_slot++;
+        return true;
+    }
+
+    // Slot thread side: hands the slot back to the receive thread. free_ring holds every slot, so
+    // it never fills up.
+    void release_payload(uint32_t pkt_id, stored_payload& stored)
+    {
+        if(stored.large.empty() && stored.len > 0)
+        {
+            uint32_t *freed = free_ring.claim();
+            if(freed != nullptr)
+            {
+                *freed = stored.slot;
+                free_ring.publish();
+            }
+        }
+        payloads.erase(pkt_id);
+    }
+
 protected:
-    void enqueue_captured_packet(captured_packet_info info, std::vector<uint8_t> payload, uint8_t original_ecn)
+    //----------------------------------------------------------------------------------------------
+    // enqueue_captured_packet(): producer side of the ring (receive thread). payload is copied into
+    // a slab slot, so it only has to stay valid for the duration of the call. A copy shorter than
+    // info.bytes marks the packet as header only. When the ring is full the packet is dropped at once
+    // instead of waiting for the slot thread.
+    // Output: false if the packet did not fit.
+    //----------------------------------------------------------------------------------------------
+    bool enqueue_captured_packet(const captured_packet_info& info, const uint8_t* payload, uint32_t len)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        payloads[info.pkt_id] = stored_payload(std::move(payload), original_ecn);
-        captured_packets.push_back(info);
+        capture_descriptor *d = ring.claim();
+        if(d == nullptr)
+        {
+            if(nfiface != nullptr) netfilter_interface_drop_overflow(nfiface, info.pkt_id);
+            return false;
+        }
+
+        d->info = info;
+        d->len = payload != nullptr ? len : 0;
+        if(d->len > slot_bytes || (d->len > 0 && !take_slot(d->slot))) d->large.assign(payload, payload + d->len);
+        else if(d->len > 0) memcpy(slot_data(d->slot), payload, d->len);
+        ring.publish();
+        return true;
     }
 
 private:
@@ -214,9 +395,12 @@ private:
         info.bytes = meta.bytes;
         info.pkt_id = meta.pkt_id;
         info.ecn = meta.ecn;
-        enqueue_captured_packet(info, meta.payload, meta.ecn);
+        info.arrival_us = meta.timestamp_sec * 1000000ULL + meta.timestamp_usec;
+        info.gso = meta.gso;
+        info.segments = meta.segments;
+        info.segment_hdr_bytes = meta.segment_hdr_bytes;
+        enqueue_captured_packet(info, meta.payload, meta.payload_len);
     }
-    mutable std::mutex mtx;
 
 private: 
     int prev_id = -1; 
@@ -225,8 +409,16 @@ private:
     netfilter_interface_t *nfiface = nullptr;
 
 private:
-    std::unordered_map<uint32_t, stored_payload> payloads;
-    std::deque<captured_packet_info> captured_packets;
+    spsc_ring<capture_descriptor> ring;
+    spsc_ring<uint32_t> free_ring; // Slab slots given back by the slot thread
+    uid_ring<stored_payload> payloads;
+    // Per queue storage of the copied bytes, slot_bytes per packet. Chunks are added by the receive
+    // thread and read by the slot thread only for slots published through ring.
+    std::vector<std::unique_ptr<uint8_t[]>> slab;
+    uint32_t fresh_slot = 0; // Receive thread: first slot never handed out
+    uint32_t slot_bytes = PKT_CAPTURE_SLAB_SLOT_MAX;
+    uint32_t ce_mark = 0;
+    bool warned_truncated_ce = false;
 
 private:
     bool is_running = false;
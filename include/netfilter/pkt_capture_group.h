@@ -0,0 +1,145 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <netfilter/pkt_capture.h>
+#include <pdcp_layer/uid_ring.h>
+
+//--------------------------------------------------------------------------------------------------
+// pkt_capture_group(): one transmission direction of a UE spread over several Netfilter Queues
+// (iptables/nft --queue-balance first:last). xt_NFQUEUE hashes each flow to one queue, so a single
+// flow is only spread with --queue-cpu-fanout. Each queue keeps its own pkt_capture, socket and
+// ring, so the queues can be read by different receiver threads (nfqueue_config::receive_threads).
+// pop_captured_packet() merges them in arrival timestamp order and renumbers the packets with one
+// sequential uid, since the NFQUEUE ids of different queues overlap; verdicts are routed back to the
+// owning queue with its own id.
+// Input:
+//      first_queue: first queue of the range.
+//      count: number of queues in the range.
+//--------------------------------------------------------------------------------------------------
+class pkt_capture_group : public pkt_capture
+{
+public:
+    pkt_capture_group(int first_queue, int count) : pkt_capture(first_queue, no_storage())
+    {
+        for(int i = 0; i < count; i++) members.emplace_back(new pkt_capture(first_queue + i));
+    }
+
+    explicit pkt_capture_group(std::vector<std::unique_ptr<pkt_capture>> _members)
+        : pkt_capture(_members.empty() ? -1 : _members.front()->queue_num(), no_storage()),
+          members(std::move(_members))
+    {
+    }
+
+    ~pkt_capture_group() override
+    {
+        close();
+    }
+
+public:
+    void start() override
+    {
+        for(size_t i = 0; i < members.size(); i++) members[i]->start();
+    }
+
+    void close() override
+    {
+        for(size_t i = 0; i < members.size(); i++) members[i]->close();
+    }
+
+    void verdict(uint32_t uid, packet_capture_action action) override
+    {
+        member_ref *ref = refs.find(uid);
+        if(ref == nullptr)
+        {
+            LOG_ERROR_I("pkt_capture_group::verdict") << "Unknown uid " << uid << END();
+            return;
+        }
+        members[ref->member]->verdict(ref->pkt_id, action);
+        refs.erase(uid);
+    }
+
+    void flush_verdicts() override
+    {
+        for(size_t i = 0; i < members.size(); i++) members[i]->flush_verdicts();
+    }
+
+    bool pop_captured_packet(captured_packet_info& out) override
+    {
+        int member = oldest_member(nullptr);
+        if(member < 0 || !members[member]->pop_captured_packet(out)) return false;
+
+        member_ref ref;
+        ref.member = member;
+        ref.pkt_id = out.pkt_id;
+        refs.insert(next_uid, ref);
+        out.pkt_id = next_uid++;
+        return true;
+    }
+
+    int captured_queue_size() const override
+    {
+        int size = 0;
+        for(size_t i = 0; i < members.size(); i++) size += members[i]->captured_queue_size();
+        return size;
+    }
+
+    bool peek_oldest_captured(captured_packet_info& out) const override
+    {
+        if(oldest_member(&out) < 0) return false;
+        out.pkt_id = next_uid;
+        return true;
+    }
+
+    packet_capture_stats stats() const override
+    {
+        packet_capture_stats out;
+        out.queue_num = queue_num();
+        for(size_t i = 0; i < members.size(); i++)
+        {
+            packet_capture_stats m = members[i]->stats();
+            out.total_recv += m.total_recv;
+            out.total_rlsd += m.total_rlsd;
+            out.bytes_recv += m.bytes_recv;
+            out.recv_fails += m.recv_fails;
+            out.kernel_drops += m.kernel_drops;
+            out.parse_fails += m.parse_fails;
+            out.overflow_drops += m.overflow_drops;
+            out.gso_pkts += m.gso_pkts;
+            out.rlsd_fails += m.rlsd_fails;
+            out.rlsd_batches += m.rlsd_batches;
+        }
+        return out;
+    }
+
+private:
+    // Member whose oldest packet arrived first (lowest queue on ties), -1 if all are empty.
+    int oldest_member(captured_packet_info *oldest) const
+    {
+        int best = -1;
+        captured_packet_info best_info;
+        for(size_t i = 0; i < members.size(); i++)
+        {
+            captured_packet_info info;
+            if(!members[i]->peek_oldest_captured(info)) continue;
+            if(best < 0 || info.arrival_us < best_info.arrival_us)
+            {
+                best = (int)i;
+                best_info = info;
+            }
+        }
+        if(best >= 0 && oldest != nullptr) *oldest = best_info;
+        return best;
+    }
+
+private:
+    struct member_ref
+    {
+        int member = -1;
+        uint32_t pkt_id = 0;
+    };
+
+    std::vector<std::unique_ptr<pkt_capture>> members;
+    uid_ring<member_ref> refs;
+    uint32_t next_uid = 0;
+};
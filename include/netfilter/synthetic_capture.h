@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netfilter/pkt_capture.h>
+
+// One packet of a replayed trace: offset from the trace start and IP length.
+struct synthetic_trace_pkt
+{
+    double t_s = 0.0;
+    uint32_t bytes = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+// synthetic_capture(): in process capture backend replaying a trace into the capture ring, so the
+// real UE path (captured_packet_handler) can run without iptables, NFQUEUE or root, e.g. in CI or to
+// measure its ceiling. The trace is a pcap file (Ethernet or raw IP link type) or a text file in the
+// data/XR_traffic format, one "<time_s> <bytes>" line per packet. Packets carry a synthetic IPv4
+// header with the configured ECN codepoint. Verdicts are only counted (and optionally recorded).
+// Input:
+//      _trace: path of the trace file.
+//      _speed: replay speed, 1.0 follows the trace timestamps, 2.0 twice as fast; 0 pushes packets
+//              as fast as the slot thread takes them, waiting instead of dropping when the ring is full.
+//      _loop: restart the trace when it ends.
+//      _ecn: ECN codepoint of the generated packets.
+//--------------------------------------------------------------------------------------------------
+class synthetic_capture : public pkt_capture
+{
+public:
+    struct verdict_record
+    {
+        uint32_t pkt_id;
+        packet_capture_action action;
+    };
+
+    synthetic_capture(std::string _trace, float _speed = 1.0f, bool _loop = false, uint8_t _ecn = ECN_NOT_ECT);
+    ~synthetic_capture() override;
+
+    void start() override;
+    void close() override;
+    void verdict(uint32_t pkt_id, packet_capture_action action) override;
+    void flush_verdicts() override {}
+    packet_capture_stats stats() const override;
+
+    static bool load_trace(const std::string& path, std::vector<synthetic_trace_pkt>& out);
+
+    bool finished() const { return done.load(); }
+    uint32_t accepted() const { return n_accept; }
+    uint32_t accepted_ce() const { return n_accept_ce; }
+    uint32_t dropped() const { return n_drop; }
+    void keep_records(bool keep) { record = keep; }
+    const std::vector<verdict_record>& records() const { return verdicts; }
+
+private:
+    void replay();
+
+private:
+    std::string trace;
+    float speed;
+    bool loop;
+    uint8_t ecn;
+    std::vector<synthetic_trace_pkt> pkts;
+
+    std::thread replay_thread;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> total_recv{0};
+    std::atomic<uint32_t> bytes_recv{0};
+    std::atomic<uint32_t> overflow_drops{0};
+
+    uint32_t n_accept = 0;
+    uint32_t n_accept_ce = 0;
+    uint32_t n_drop = 0;
+    bool record = false;
+    std::vector<verdict_record> verdicts;
+};
@@ -12,6 +12,11 @@
 
 #include <netfilter/pkt_capture.h>
 #include <pdcp_layer/packet_handler.h>
+#include <pdcp_layer/uid_ring.h>
+
+// Packets popped during ingest may carry a timestamp slightly after the ingest time; beyond this,
+// the capture timestamp is taken to be on another clock.
+#define ARRIVAL_TS_SLACK_S 0.1f
 
 class captured_packet_handler : public packet_handler
 {
@@ -31,7 +36,7 @@ public:
 
 private:
     float get_current_ts() const;
-    void sort_by_id();
+    float arrival_ts(const captured_packet_info& info, float now, bool& clock_mismatch) const;
     bool add_data(ip_pkt *recv_pkt);
     bool remove_data(int id, float bits);
     bool check_order(int id);
@@ -45,6 +50,11 @@ private:
     int prev_released_id = -1;
     int ce_rewrite_packets = 0;
     int drop_packets = 0;
+    double capture_delay_sum = 0.0;
+    int capture_delay_packets = 0;
+    float capture_delay_max = 0.0f;
+    int capture_clock_mismatches = 0;
     std::unique_ptr<pkt_capture> pkt_cptr;
-    std::deque<ip_pkt> out_pkts;
+    // Reorder buffer of pushed packets keyed by NFQUEUE id, released from the lowest id.
+    uid_ring<ip_pkt> out_pkts;
 };
@@ -56,6 +56,7 @@ public:
     int get_generated_packets(bool partial = true);
     float get_error(bool partial = true);
     bool add_pkt(ip_pkt pkt);
+    bool split_burst(ip_pkt& pkt, ip_pkt& rejected);
     void configure_l4s(dualpi2_config cfg);
     bool using_dualpi2() const { return l4s_cfg.enabled; }
     dualpi2_stats get_l4s_stats() const;
@@ -68,13 +69,16 @@ public:
 private:
     dualpi2_config l4s_cfg;
     dualpi2_queue l4s_queue;
+    ip_pkt l4s_head;
+    bool l4s_head_valid = false;
 
 private:
     bool backend_has_pkts() const;
     int backend_size() const;
-    bool backend_pop_next(ip_pkt& pkt);
+    ip_pkt* backend_front();
+    void backend_pop_front();
     bool backend_pop_oldest(ip_pkt& pkt);
-    void backend_requeue_front(ip_pkt pkt);
+    void backend_enqueue(ip_pkt pkt);
     const ip_pkt* backend_peek_oldest() const;
     float backend_oldest_timestamp() const;
 };
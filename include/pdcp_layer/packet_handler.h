@@ -11,8 +11,10 @@
 #include <memory>
 #include <random>
 
+#include <netfilter/capture_config.h>
 #include <pdcp_layer/pdcp_config.h>
 #include <pdcp_layer/pdcp_queue_status.h>
+#include <pdcp_layer/release_wheel.h>
 #include <pkts/pkts.h>
 #include <traffic_models/traffic_config.h>
 #include <utils/logging/mean_handler.h>
@@ -41,6 +43,9 @@ public:
     virtual void drop(harq_pkt pkt);
     virtual float release();
     virtual void fill_queue_status(pdcp_queue_status& status, float current_t) const;
+    // True when a multi packet entry that overflows the IP buffer may be cut down to the packets
+    // that fit (ip_buffer::split_burst()). Entries standing for one real packet stay all or nothing.
+    virtual bool splits_bursts() const { return false; }
 
     float get_generated(bool partial = true);
     float get_error(bool partial = true);
@@ -55,7 +60,7 @@ protected:
 
 protected:
     std::deque<ip_pkt> ingress_pkts;
-    std::deque<harq_pkt> pkt_list;
+    release_wheel pkt_list;
     float current_t = 0;
     float bh_d = 0;
     float bh_d_var = 0;
@@ -79,6 +84,8 @@ struct packet_handler_config
     int ue_type;
     int tx_dir;
     int queue_num;
+    int queue_count = 1;
+    capture_config capture_c;
     int ue_id;
     std::chrono::microseconds *init_t;
     traffic_config traffic_c;
@@ -86,6 +93,7 @@ struct packet_handler_config
     dualpi2_config l4s_c;
     bool log_traffic;
     bool log_quality;
+    bool fluid_pkts = false;
 };
 
 std::unique_ptr<packet_handler> make_packet_handler(packet_handler_config cfg);
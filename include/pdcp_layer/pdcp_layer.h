@@ -36,6 +36,8 @@ public:
     float get_tp(bool partial = true);
     bool using_l4s() const;
     pdcp_queue_status get_queue_status() const;
+    int ip_queue_size() const { return _ip_buffer.size(); }
+    int harq_queue_size() const { return _harq_buffer.size(); }
     dualpi2_stats get_l4s_interval_stats();
     void set_pkt_delay_budget(float budget_s) { pkt_delay_budget_s = budget_s; }
     float get_pkt_delay_budget() const { return pkt_delay_budget_s; }
@@ -20,6 +20,12 @@ struct pdcp_queue_status
     int capture_size = 0;
     int capture_oldest_uid = -1;
     float capture_oldest_age = -1.0f;
+    // Capture path delay (arrival timestamp to slot ingest): totals since start and max of the last ingest
+    double capture_delay_sum_s = 0.0;
+    int capture_delay_packets = 0;
+    float capture_delay_max_s = 0.0f;
+    // Captured packets whose timestamp was not on the emulator clock and arrived at ingest time instead
+    int capture_clock_mismatches = 0;
 
     int release_size = 0;
     int release_oldest_uid = -1;
@@ -34,7 +40,12 @@ struct pdcp_queue_status
     int nfqueue_total_rlsd = 0;
     int nfqueue_bytes_recv = 0;
     int nfqueue_recv_fails = 0;
+    int nfqueue_kernel_drops = 0;
+    int nfqueue_parse_fails = 0;
+    int nfqueue_overflow_drops = 0;
+    int nfqueue_gso_pkts = 0;
     int nfqueue_rlsd_fails = 0;
+    int nfqueue_rlsd_batches = 0;
 
     float pkt_delay_budget_s = -1.0f;
 
@@ -0,0 +1,69 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <pkts/pkts.h>
+
+// Wheel resolution, one 5G NR slot at numerology 3. Only affects bucketing, release times are exact.
+#define RELEASE_WHEEL_TICK_S 0.000125f
+#define RELEASE_WHEEL_L0_BITS 8
+#define RELEASE_WHEEL_L1_BITS 6
+
+//--------------------------------------------------------------------------------------------------
+// release_wheel(): two level hierarchical timing wheel holding HARQ packets waiting for their
+// backhaul release time (t_out). Packets are bucketed by tick = t_out / tick_s: level 0 holds the
+// ticks of the current 256 tick round, level 1 the rounds of the current 64 round cycle, and
+// anything further away waits in an overflow list until its cycle starts. Each call to pop_due()
+// only visits the buckets elapsed since the previous call, so per slot cost is proportional to the
+// packets that are due instead of to the queue length. Jittered t_out values are handled since
+// nothing assumes the packets are pushed in t_out order. Release order says nothing about age, so
+// the (ip_t, id) of every packet also goes to a min-heap for peek_oldest(); released packets are
+// removed lazily through a second heap, keeping push and pop at O(log n) without allocating.
+//--------------------------------------------------------------------------------------------------
+class release_wheel
+{
+public:
+    explicit release_wheel(float tick_s = RELEASE_WHEEL_TICK_S);
+
+    void push(harq_pkt pkt);
+    bool pop_due(float current_t, harq_pkt& pkt);
+    const harq_pkt* peek_next() const;
+    bool peek_oldest(int& id, float& ip_t) const;
+    void clear();
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+private:
+    void forget_age(const harq_pkt& pkt);
+    int64_t tick_of(float t) const;
+    void place(harq_pkt&& pkt);
+    void advance(int64_t now, float current_t);
+    void collect(std::vector<harq_pkt>& bucket, float current_t);
+    void cascade();
+
+private:
+    float tick_s;
+    int64_t cursor = 0;
+    size_t count = 0;
+    size_t l0_count = 0;
+    size_t l1_count = 0;
+    std::vector<std::vector<harq_pkt>> l0;
+    std::vector<std::vector<harq_pkt>> l1;
+    std::vector<harq_pkt> overflow;
+    std::deque<harq_pkt> ready;
+    // Min-heaps of (ip_t, id): every waiting packet, and the released ones still to be taken out of
+    // by_age, which only happens once they reach its top.
+    std::vector<std::pair<float, int>> by_age;
+    std::vector<std::pair<float, int>> released_age;
+};
@@ -7,33 +7,53 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <pdcp_layer/packet_handler.h>
+#include <pdcp_layer/uid_ring.h>
 #include <traffic_models/traffic_model.h>
 
+//--------------------------------------------------------------------------------------------------
+// simulated_packet_handler(): packet source for simulated UEs. Bits generated by the traffic model
+// are split into IP packets of pkt_size bits. In fluid mode, all the bits generated in a slot are
+// enqueued as a single burst entry (see ip_pkt::pkt_count), so the queueing cost scales with the
+// number of bursts instead of the number of packets. A burst partly lost in HARQ only drops the
+// packets its lost fragments touch, as per-packet mode would; the rest are accepted. Packet
+// boundaries are taken as size / pkt_count, i.e. a burst is assumed to hold equal size packets.
+//--------------------------------------------------------------------------------------------------
 class simulated_packet_handler : public packet_handler
 {
 public:
-    simulated_packet_handler(int ue_id, traffic_config traffic_c, pdcp_config pdcp_c, int verbosity = 0);
+    simulated_packet_handler(int ue_id, traffic_config traffic_c, pdcp_config pdcp_c, int verbosity = 0, bool fluid_pkts = false);
 
     float ingest(int tx_dir, float current_t) override;
+    void drop_ingress_pkt(ip_pkt pkt) override;
     void drop(harq_pkt pkt) override;
     float release() override;
+    bool splits_bursts() const override { return fluid_pkts; }
 
 private:
     struct pending_packet_result
     {
         float original_size = 0.0f;
         float accounted_bits = 0.0f;
-        bool dropped = false;
+        // Indexes of the burst packets touched by lost fragments, as sorted disjoint [first, last]
+        // ranges, so a packet hit by several lost fragments is counted once. Empty unless
+        // something was lost.
+        std::vector<std::pair<uint32_t, uint32_t>> lost;
         bool congestion_signal = false;
     };
 
     void update_pending_packet(const ip_pkt& pkt, bool dropped);
+    static void add_lost_range(pending_packet_result& state, uint32_t first, uint32_t last);
+    static uint32_t lost_count(const pending_packet_result& state);
 
 private:
     std::unique_ptr<traffic_model> traffic_m;
     int current_id = 0;
-    std::unordered_map<uint32_t, pending_packet_result> pending_results;
+    bool fluid_pkts = false;
+    // Per uid fragment accounting until the final verdict. uids come from current_id, so the ring
+    // stays dense and only grows while old packets are still partially in flight.
+    uid_ring<pending_packet_result> pending_results;
 };
@@ -0,0 +1,164 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// uid_ring(): growable ring buffer of T indexed by packet uid. The slot of a uid is its offset from
+// the uid stored at the head, so lookup, insertion and head removal are O(1) as long as the live
+// uids are dense (NFQUEUE ids and simulated ids are sequential). Entries are kept in uid order and
+// the head is always the lowest live uid. uids are compared with serial arithmetic so the 32-bit
+// NFQUEUE id wrap is handled. T must be default constructible and copy assignable.
+//--------------------------------------------------------------------------------------------------
+template<typename T>
+class uid_ring
+{
+public:
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    T& front() { return slots[head].value; }
+    const T& front() const { return slots[head].value; }
+    uint32_t front_uid() const { return base_uid; }
+
+    //----------------------------------------------------------------------------------------------
+    // find(): returns the entry stored for uid or nullptr if there is none.
+    //----------------------------------------------------------------------------------------------
+    T* find(uint32_t uid)
+    {
+        if(count == 0) return nullptr;
+        int32_t offset = (int32_t)(uid - base_uid);
+        if(offset < 0 || (size_t)offset >= span) return nullptr;
+        slot &s = at((size_t)offset);
+        return s.used ? &s.value : nullptr;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // insert(): stores value for uid, replacing any previous entry, and returns a reference to it.
+    // uids lower than the current head are accepted and become the new head.
+    //----------------------------------------------------------------------------------------------
+    T& insert(uint32_t uid, T value)
+    {
+        if(count == 0)
+        {
+            reserve(1);
+            head = 0;
+            span = 0;
+            base_uid = uid;
+        }
+
+        int32_t offset = (int32_t)(uid - base_uid);
+        if(offset < 0)
+        {
+            size_t shift = (size_t)(-(int64_t)offset);
+            reserve(span + shift);
+            head = (head + slots.size() - shift) & (slots.size() - 1);
+            span += shift;
+            base_uid = uid;
+            offset = 0;
+        }
+        else if((size_t)offset >= span)
+        {
+            reserve((size_t)offset + 1);
+            span = (size_t)offset + 1;
+        }
+
+        slot &s = at((size_t)offset);
+        if(!s.used) count++;
+        s.used = true;
+        s.value = std::move(value);
+        return s.value;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // pop_front(): removes the lowest uid entry.
+    //----------------------------------------------------------------------------------------------
+    void pop_front()
+    {
+        if(count == 0) return;
+        release(slots[head]);
+        trim();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // erase(): removes the entry stored for uid, if any.
+    //----------------------------------------------------------------------------------------------
+    void erase(uint32_t uid)
+    {
+        if(count == 0) return;
+        int32_t offset = (int32_t)(uid - base_uid);
+        if(offset < 0 || (size_t)offset >= span) return;
+        slot &s = at((size_t)offset);
+        if(!s.used) return;
+        release(s);
+        trim();
+    }
+
+    void clear()
+    {
+        for(size_t i = 0; i < span; i++) at(i) = slot();
+        count = 0;
+        span = 0;
+        head = 0;
+    }
+
+private:
+    struct slot
+    {
+        bool used = false;
+        T value;
+    };
+
+    slot& at(size_t offset) { return slots[(head + offset) & (slots.size() - 1)]; }
+
+    void release(slot &s)
+    {
+        s.used = false;
+        s.value = T();
+        count--;
+    }
+
+    // Advances the head past free slots so it always points at the lowest live uid.
+    void trim()
+    {
+        while(span > 0 && !slots[head].used)
+        {
+            head = (head + 1) & (slots.size() - 1);
+            base_uid++;
+            span--;
+        }
+        if(count == 0)
+        {
+            span = 0;
+            head = 0;
+        }
+    }
+
+    // Grows the storage to a power of two holding at least n slots, keeping the uid order.
+    void reserve(size_t n)
+    {
+        if(n <= slots.size()) return;
+        size_t capacity = slots.empty() ? 64 : slots.size();
+        while(capacity < n) capacity <<= 1;
+
+        std::vector<slot> grown(capacity);
+        for(size_t i = 0; i < span; i++) grown[i] = std::move(at(i));
+        slots.swap(grown);
+        head = 0;
+    }
+
+private:
+    std::vector<slot> slots;
+    size_t head = 0;
+    size_t span = 0;
+    size_t count = 0;
+    uint32_t base_uid = 0;
+};
@@ -49,6 +49,8 @@ struct ip_pkt
         t_out = current_t; 
     };
 
+    ip_pkt() : ip_pkt(0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f) {}
+
     ip_pkt(const ip_pkt &cpy_pkt)
     {
         current_t = cpy_pkt.current_t; 
@@ -69,6 +71,8 @@ struct ip_pkt
         original_ecn = cpy_pkt.original_ecn;
         ce_marked = cpy_pkt.ce_marked;
         aqm_dropped = cpy_pkt.aqm_dropped;
+        pkt_count = cpy_pkt.pkt_count;
+        offset = cpy_pkt.offset;
     };
 
     bool is_ready()
@@ -94,14 +98,15 @@ struct ip_pkt
     uint8_t original_ecn = ECN_NOT_ECT;
     bool ce_marked = false;
     bool aqm_dropped = false;
+    // Number of IP packets represented by this entry. Always 1 except for fluid
+    // (aggregated) simulated traffic, where one entry is a burst of packets
+    // sharing the same arrival time.
+    uint32_t pkt_count = 1;
+    // Bits of the original packet (or burst) that precede this fragment. Lets a
+    // lost fragment be mapped to the packets of a burst it overlaps.
+    float offset = 0.0f;
 };
 
-
-static bool sorter(ip_pkt & lval, ip_pkt & rval) 
-{
-    return (lval.uid < rval.uid);
-} 
-
 // HARQ packet which includes full and/or fragments of IP packets
 struct harq_pkt
 {
@@ -23,6 +23,8 @@
 #include <mac_layer/tdd_handler.h>
 #include <utils/logging/log_handler.h>
 #include <utils/monitoring/monitoring_config.h>
+#include <netfilter/nfqueue_config.h>
+#include <utils/logging/recorder_config.h>
 
 std::string getBaseMapPath();
 
@@ -222,6 +224,10 @@ public:
     std::string getClosestMapFile(int scenario_type, double frequency);
     // monitoring config
     monitoring_config get_monitoring_config();
+    nfqueue_config get_nfqueue_config();
+    recorder_config get_recorder_config();
+    log_writer_config get_log_writer_config();
+    std::string get_health_socket();
 
 private:
     float duration = DURATION_DEFAULT;
@@ -267,6 +273,14 @@ private:
 
     // Monitoring
     monitoring_config monitoring_c;
+    // NFQUEUE receive path
+    nfqueue_config nfqueue_c;
+    // Binary UE recorder
+    recorder_config recorder_c;
+    // Text log writer
+    log_writer_config log_writer_c;
+    // Health endpoint, disabled when empty
+    std::string health_socket;
     float rtx_proc_delay_dl = RTX_PROC_DELAY_DEFAULT;
     float rtx_proc_delay_var_dl = RTX_PROC_DELAY_VAR_DEFAULT;
     // METRIC COFIGURATION
@@ -38,6 +38,7 @@ private:
     void handle_time_log(double sim_time_s);
     void log_runtime_start();
     void log_runtime_stop(const std::string &reason);
+    void stop_monitoring();
     void maybe_log_progress(double sim_time_s);
 
     void step(unsigned int _ts);
@@ -89,6 +89,13 @@ public:
         }
     }
     
+    // Time the slot being run was scheduled for, in us from the start. Only valid in the tick
+    // callback; the current slot's lateness is its start time minus this.
+    unsigned int get_due_ts() const
+    {
+        return due_ts;
+    }
+
     unsigned int get_current_ts()
     {
         return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch() - init_t).count(); 
@@ -110,6 +117,7 @@ private:
                 current_ts = get_current_ts(); 
                 func(current_ts); 
                 int wait = std::max(0, period*(count+1) - (int)get_current_ts());
+                due_ts = period*(count+1);
                 std::this_thread::sleep_for(std::chrono::microseconds(wait));
                 previous_ts = current_ts; 
                 count++;
@@ -119,6 +127,7 @@ private:
                 func(count*1000);
                 previous_ts = count*1000; 
                 count++;               
+                due_ts = count*1000;
             }
         }
         std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t);
@@ -142,7 +151,10 @@ private:
             
                 int diff = (int)(period - (current_ts - previous_ts)); 
                 int sign = (diff > 0) ? 1 : -1 ; 
-                int wait = std::max(0, (int)(period - sign*diff -(get_current_ts() - current_ts)));
+                unsigned int now = get_current_ts();
+                int wait = std::max(0, (int)(period - sign*diff -(now - current_ts)));
+                // Each slot is scheduled from the previous wake up, not from the start
+                due_ts = now + wait;
                 std::this_thread::sleep_for(std::chrono::microseconds(wait));
                 previous_ts = current_ts; 
                 count++;
@@ -152,6 +164,7 @@ private:
                 func(count*1000);
                 previous_ts = count*1000; 
                 count++;                  
+                due_ts = count*1000;
             }
         }
         std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t);
@@ -169,6 +182,7 @@ private:
 
     unsigned int current_ts = 0; 
     unsigned int previous_ts = 0; 
+    unsigned int due_ts = 0; 
     bool run = false; 
     int goal = 0; 
     bool finished = false; 
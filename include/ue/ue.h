@@ -21,6 +21,9 @@
 
 // Logging
 #include "utils/logging/mean_handler.h"
+#include "utils/monitoring/metric_window.h"
+#include "utils/logging/binary_recorder.h"
+#include "utils/monitoring/health_endpoint.h"
 #include <ue/ue_config.h>
 
 struct schedule_candidate
@@ -32,6 +35,32 @@ struct schedule_candidate
     int ue_id = -1;
 };
 
+// Interval PDCP statistics and queue status of one slot. The pdcp_layer getters restart their
+// interval when read and the queue status walks the buffers, so both are taken at most once per slot,
+// when a consumer needs them, and shared by the text log, the monitoring windows and the recorder.
+struct pdcp_slot_stats
+{
+    float tp = 0.0f;
+    float generated = 0.0f;
+    float error = 0.0f;
+    float latency = 0.0f;
+    float ip_latency = 0.0f;
+    bool read = false;
+    pdcp_queue_status queue;
+    bool queue_read = false;
+};
+
+// Consumers of the UE data of one slot, see ue::plan_slot().
+struct ue_slot_plan
+{
+    bool text_traffic = false;
+    bool mobility = false;
+    bool pdcp[2] = {false, false};
+    bool queue[2] = {false, false};
+    bool l4s[2] = {false, false};
+    bool phy[2] = {false, false};
+};
+
 //--------------------------------------------------------------------------------------------------
 // ue(): this class is in charge of modeling and updating the simulated UE's position, 
 // generating/handling packets, estimating the Channel State Indicator and Releasing or Dropping the 
@@ -149,11 +178,17 @@ public:
 
 private: 
     void init_logger(); 
+    void register_monitoring();
     void emit_pdcp_monitoring();
     void emit_queue_monitoring();
     void emit_phy_monitoring();
     void emit_l4s_monitoring();
     void emit_mobility_monitoring();
+    void plan_slot();
+    const pdcp_slot_stats &slot_pdcp_stats(int tx_dir);
+    const pdcp_queue_status &slot_queue_status(int tx_dir);
+    void record_slot();
+    void update_health(const std::chrono::steady_clock::time_point *t);
     phy_layer& phy(int tx_dir);
     const phy_layer& phy(int tx_dir) const;
     pdcp_layer& pdcp(int tx_dir);
@@ -175,6 +210,7 @@ protected:
 
 public:
     void print_traffic();
+    void flush_monitoring();
 
 protected: 
     int id; 
@@ -196,6 +232,16 @@ protected:
     bool log_mobility; 
     bool log_quality; 
     int verbosity; 
+    // Local windows of the registered monitoring series, indexed by tx_dir
+    metric_window mobility_window;
+    metric_window pdcp_window[2];
+    metric_window queue_window[2];
+    metric_window l4s_window[2];
+    metric_window phy_window[2];
+    pdcp_slot_stats pdcp_slot[2];
+    ue_slot_plan plan;
+    recorder_stream *recorder = nullptr; // Binary per slot record, null when not recording
+    ue_health_counters *health = nullptr; // Health endpoint counters, null when it is not open
     bool store_data; 
 
 protected: 
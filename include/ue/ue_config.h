@@ -12,6 +12,7 @@
 #include <pdcp_layer/pdcp_config.h>
 #include <mobility_models/mobility_config.h>
 #include <common/direction.h>
+#include <netfilter/capture_config.h>
 
 #define MAX_N_ANTENNAS 4
 #define MIN_N_ANTENNAS 1
@@ -88,6 +89,8 @@ struct ue_model
 //              *delay_t_metric: metric-specific parameter.
 //              *beta_metric: metric-specific parameters. 
 //              *priority: used by the user priotitization algorithm implemented in the MAC Layer. 
+//              *fluid_pkts: (SIM UEs only) queue each slot's generated bits as one burst instead of
+//                           individual pkt_size packets. Ignored when the L4S dual queue is enabled.
 //      _scenario_c: scenario configuration struct which includes: 
 //              *type: scenario type ID from the ones implemented.
 //              *w: width of the beam.
@@ -138,6 +141,12 @@ struct ue_config
             }
     int ul_queue_n = -1; 
     int dl_queue_n = -1;
+    // Queues in the --queue-balance range starting at ul/dl_queue_n
+    int ul_queue_count = 1;
+    int dl_queue_count = 1;
+    // (REAL UEs only) capture backend and its per direction interfaces
+    capture_config ul_capture_c;
+    capture_config dl_capture_c;
     ue_model ue_m; 
     traffic_config traffic_c; 
     mobility_config mobility_c; 
@@ -152,6 +161,7 @@ struct ue_config
     bool log_quality = false;
     std::string log_id = "";   
     float priority = 1; 
+    bool fluid_pkts = false;
     dualpi2_config l4s_c;
     phy_ue_config get_phy_config()
     {
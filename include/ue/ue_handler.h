@@ -39,6 +39,7 @@ public:
     void step(double _current_t);
 
     void print_traffic();
+    void flush_monitoring();
 
 public: 
     std::vector<ue>* get_ue_list();
@@ -0,0 +1,126 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utils/logging/recorder_config.h>
+
+#define RECORDER_MAGIC "FKREC001"
+#define RECORDER_CHUNK_MAGIC 0x4b4e4843u // "CHNK"
+#define RECORDER_CODEC_NONE 0
+#define RECORDER_CODEC_ZLIB 1
+#define RECORDER_NAME_LEN 23
+// Chunks a UE may have queued to the writer before its new rows are dropped.
+#define RECORDER_MAX_QUEUED_PER_STREAM 8
+
+// Fixed schema of a recorded UE slot. Column names follow the keys of the text UE logs.
+enum recorder_column
+{
+    REC_T, // float64, the rest are float32
+    REC_X, REC_Y,
+    REC_RUL, REC_RDL, REC_LUL, REC_LDL, REC_ILUL, REC_ILDL, REC_EUL, REC_EDL, REC_GUL, REC_GDL,
+    REC_CEUL, REC_CEDL, REC_CEBUL, REC_CEBDL, REC_AQMDUL, REC_AQMDDL, REC_AQMDBUL, REC_AQMDBDL,
+    REC_QLUL, REC_QLDL, REC_QCUL, REC_QCDL, REC_PLUL, REC_PLDL, REC_PCUL, REC_PCDL, REC_PCLUL, REC_PCLDL,
+    REC_SINR_UL, REC_SINR_DL, REC_RSRP_UL, REC_RSRP_DL, REC_CQI_UL, REC_CQI_DL, REC_MCS_UL, REC_MCS_DL,
+    REC_RI_UL, REC_RI_DL,
+    REC_N_COLUMNS
+};
+
+class binary_recorder;
+
+// Chunk of rows of one UE, stored column after column.
+struct recorder_chunk
+{
+    int ue_id = -1;
+    uint32_t rows = 0;
+    std::vector<uint8_t> data;
+};
+
+//--------------------------------------------------------------------------------------------------
+// recorder_stream(): rows of one UE. Only touched by the thread stepping that UE; full chunks are
+// handed to the writer thread, which gives them back for reuse once written.
+//--------------------------------------------------------------------------------------------------
+class recorder_stream
+{
+public:
+    // row holds REC_N_COLUMNS values, in recorder_column order.
+    void record(const double *row);
+
+private:
+    friend class binary_recorder;
+    binary_recorder *owner = nullptr;
+    int ue_id = -1;
+    recorder_chunk *chunk = nullptr;
+    int queued = 0; // Chunks of this stream waiting for the writer, guarded by the recorder mutex
+    uint64_t dropped_rows = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+// binary_recorder(): native replacement of the per slot text UE logs for offline runs. UE threads
+// append rows to their recorder_stream, in preallocated columnar chunks; a background thread
+// (optionally zlib compresses and) writes the full chunks, so recording every slot for hundreds of
+// UEs costs the slot threads a few stores per value.
+//
+// File layout (little endian):
+//      header: "FKREC001", uint32 version (1), uint32 n_columns, then per column uint8 dtype
+//              (0 float32, 1 float64) and char name[23], zero padded.
+//      chunks: uint32 "CHNK", int32 ue_id, uint32 rows, uint32 codec (0 none, 1 zlib),
+//              uint64 stored_bytes, uint64 raw_bytes, then stored_bytes of payload padded to 8 bytes.
+//              The raw payload is each column's rows values back to back, each column padded to 8
+//              bytes, so an uncompressed chunk can be mapped with numpy.memmap
+//              (py_analyzers/ue_record.py).
+//--------------------------------------------------------------------------------------------------
+class binary_recorder
+{
+public:
+    binary_recorder() = default;
+    ~binary_recorder();
+
+    static binary_recorder &instance();
+
+    bool open(const recorder_config &cfg);
+    bool is_open() const { return file != nullptr; }
+    recorder_stream *open_stream(int ue_id);
+    void close();
+
+    static const char *column_name(int column);
+    static size_t column_size(int column) { return column == REC_T ? 8 : 4; }
+    static size_t column_bytes(int column, uint32_t rows) { return (column_size(column) * rows + 7) & ~(size_t)7; }
+
+private:
+    friend class recorder_stream;
+    recorder_chunk *take_chunk(recorder_stream &stream);
+    void submit(recorder_stream &stream);
+    void writer_loop();
+    void write_chunk(recorder_chunk &chunk);
+
+private:
+    recorder_config cfg;
+    int codec = RECORDER_CODEC_NONE;
+    FILE *file = nullptr;
+    size_t chunk_bytes = 0;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::pair<recorder_stream*, recorder_chunk*>> full;
+    std::vector<recorder_chunk*> free_chunks;
+    std::vector<std::unique_ptr<recorder_chunk>> chunks;
+    std::vector<std::unique_ptr<recorder_stream>> streams;
+    bool stopping = false;
+    std::thread writer;
+
+    std::vector<uint8_t> packed; // Writer thread only
+    std::vector<uint8_t> compressed;
+};
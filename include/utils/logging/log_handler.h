@@ -6,9 +6,10 @@
 
 #pragma once
 
-#include "spdlog/async.h"
-#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/fmt/fmt.h"
+#include "utils/logging/log_writer.h"
 #include <functional>
+#include <string>
 
 //--------------------------------------------------------------------------------------------------
 // log_config(): logger configuration struct.
@@ -34,7 +35,7 @@ struct log_config
 };
 
 //--------------------------------------------------------------------------------------------------
-// log_handler(): log handling class which interfaces with spdlog library. 
+// log_handler(): log handling class, its lines are written by the shared log_writer thread. 
 // Input: 
 //              *dir: directory where the file will be created. 
 //              *filename: filename name, has to be UNIQUE.
@@ -49,24 +50,20 @@ public:
         monitoring_cb = cb;
     }
 
+    // The file is opened by the shared log_writer on the first line, once the writer is configured.
     void init( std::string dir, std::string filename)
     {
         if(dir[dir.length() - 1] != '/') dir += "/";
-        logger = spdlog::basic_logger_mt<spdlog::async_factory_nonblock>(filename, dir + filename + ".txt");
-        logger->set_pattern("%v");
+        path = dir + filename + ".txt";
         is_init = true; 
         is_ready = true; 
     }
 
     void init( std::string dir, std::string filename, int log_freq)
     {
-        if(dir[dir.length() - 1] != '/') dir += "/";
-        logger = spdlog::basic_logger_mt<spdlog::async_factory_nonblock>(filename, dir + filename + ".txt");
-        logger->set_pattern("%v");
+        init(dir, filename);
         use_counter = log_freq != -1;
         counter_goal = 1000/log_freq - 1; 
-        is_init = true; 
-        is_ready = true; 
     }
 
     bool ready()
@@ -76,14 +73,14 @@ public:
 
     void log(std::string info)
     {
-        if(is_ready) logger->info(info);
+        if(is_ready) write_line(info.data(), info.size());
         emit_monitoring(info);
         if(use_counter) handle_counter(); 
     }
 
     void log_force(std::string info)
     {
-        logger->info(info);
+        write_line(info.data(), info.size());
         emit_monitoring(info);
     }
 
@@ -104,7 +101,7 @@ public:
         if(is_ready)
         {
             auto formatted = fmt::format(fmt, std::forward<Args>(args)...);
-            logger->info(formatted);
+            write_line(formatted.data(), formatted.size());
             emit_monitoring(formatted);
         }
         if(use_counter) handle_counter(); 
@@ -114,32 +111,28 @@ public:
     void log_force(const FormatString &fmt, Args&&... args)
     {
         auto formatted = fmt::format(fmt, std::forward<Args>(args)...);
-        logger->info(formatted);
+        write_line(formatted.data(), formatted.size());
         emit_monitoring(formatted);
     }
 
-   void log_partial(std::string info)
+    void log_partial(const std::string &info)
     {
-         if(is_ready) info_out += info; ;
+        if(is_ready) info_out.append(info.data(), info.data() + info.size());
     }
 
+    // Formats straight into info_out, no temporary string per call.
     template<typename FormatString, typename... Args>
     void log_partial(const FormatString &fmt, Args&&... args)
     {
-        if(is_ready) info_out += fmt::format(fmt, std::forward<Args>(args)...);
+        if(is_ready) fmt::format_to(info_out, fmt, std::forward<Args>(args)...);
     }
 
-    void flush(std::string info)
+    void flush(const std::string &info)
     {
         if(is_ready && info_out.size() > 0) 
         {
-            info_out += info; 
-            if(info_out.size() > 0)
-            {
-                logger->info(info_out);
-                emit_monitoring(info_out);
-            }
-            reset_info(); 
+            info_out.append(info.data(), info.data() + info.size());
+            write_info();
         }
         if(use_counter) handle_counter(); 
     }
@@ -149,28 +142,15 @@ public:
     {
         if(is_ready)
         {
-            info_out += fmt::format(fmt, std::forward<Args>(args)...);
-            if(info_out.size() > 0)
-            {
-                logger->info(info_out);
-                emit_monitoring(info_out);
-            }
-            reset_info(); 
+            fmt::format_to(info_out, fmt, std::forward<Args>(args)...);
+            write_info();
         }
         if(use_counter) handle_counter(); 
     }
 
     void flush()
     {
-        if(is_ready)
-        {
-            if(info_out.size() > 0)
-            {
-                logger->info(info_out);
-                emit_monitoring(info_out);
-            }
-            reset_info(); 
-        }
+        if(is_ready) write_info();
         if(use_counter) handle_counter(); 
     }
     
@@ -180,10 +160,27 @@ private:
         if(monitoring_cb) monitoring_cb(info);
     }
 
-    void reset_info()
+    void write_line(const char *data, size_t size)
+    {
+        if(stream == nullptr && !open_failed)
+        {
+            stream = log_writer::instance().open_stream(path);
+            open_failed = stream == nullptr;
+        }
+        if(stream != nullptr) stream->write(data, size);
+    }
+
+    // Queues the accumulated line to the log writer and clears info_out, keeping its capacity.
+    void write_info()
     {
-        info_out.erase();
+        if(info_out.size() > 0)
+        {
+            write_line(info_out.data(), info_out.size());
+            if(monitoring_cb) emit_monitoring(std::string(info_out.data(), info_out.size()));
+        }
+        info_out.clear();
     }
+
 private: 
     bool is_init = false; 
     bool is_ready = false; 
@@ -194,9 +191,11 @@ private:
     int counter_goal = 0; 
 
 private: 
-    std::string info_out = ""; 
+    fmt::memory_buffer info_out; 
 
 private: 
-    std::shared_ptr<spdlog::logger> logger; 
+    std::string path;
+    log_stream *stream = nullptr; // Owned by log_writer
+    bool open_failed = false;
     monitoring_cb_t monitoring_cb = nullptr;
 };
@@ -0,0 +1,95 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utils/spsc_ring.h>
+
+// Text log transport ([Global] log_* keys), see log_writer.
+struct log_writer_config
+{
+    // Bytes of lines each log may have queued to the writer; lines logged while it is full are dropped.
+    int queue_bytes = 32 << 10;
+    // Bytes collected per file before they are written.
+    int buffer_bytes = 64 << 10;
+    // Longest time a line waits in the writer before it reaches its file.
+    int flush_ms = 200;
+};
+
+class log_writer;
+
+//--------------------------------------------------------------------------------------------------
+// log_stream(): one log file. write() is called by the single thread logging to it (a UE or the MAC
+// grid) and only copies the line, behind its length, into a preallocated byte ring drained by the
+// writer thread. Indexes are free running byte counts, each on its own cache line as in spsc_ring.
+//--------------------------------------------------------------------------------------------------
+class log_stream
+{
+public:
+    bool write(const char *data, size_t size);
+
+private:
+    friend class log_writer;
+    explicit log_stream(size_t bytes);
+    void copy_in(size_t pos, const char *src, size_t n);
+    void copy_out(size_t pos, char *dst, size_t n) const;
+
+    std::vector<char> ring;
+    size_t mask = 0;
+    uint64_t dropped = 0; // Producer side
+    int fd = -1;          // Writer side
+    std::string path;
+    std::string out;
+
+    char pad0[SPSC_RING_CACHE_LINE];
+    std::atomic<size_t> tail{0}; // Written by the producer
+    size_t head_cache = 0;
+    char pad1[SPSC_RING_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> head{0}; // Written by the writer
+    char pad2[SPSC_RING_CACHE_LINE - sizeof(std::atomic<size_t>)];
+};
+
+//--------------------------------------------------------------------------------------------------
+// log_writer(): the single writer thread of the text logs. Every log_stream is a lock free single
+// producer ring, so together they form a multi producer queue drained by one consumer: the writer
+// collects the lines of each file in a buffer and writes it when it holds buffer_bytes or every
+// flush_ms, so the logging threads never format a pattern, take a lock or touch a file.
+//--------------------------------------------------------------------------------------------------
+class log_writer
+{
+public:
+    log_writer() = default;
+    ~log_writer();
+
+    static log_writer &instance();
+
+    // Applies to the streams opened afterwards.
+    void configure(const log_writer_config &cfg);
+    // Opens (appends to) path, creating its directory. nullptr when the file cannot be opened.
+    log_stream *open_stream(const std::string &path);
+    // Writes what is queued and stops the writer. Logging threads must be done.
+    void stop();
+
+private:
+    void writer_loop();
+    size_t drain(log_stream &stream, size_t buffer_bytes);
+    void write_out(log_stream &stream);
+
+private:
+    log_writer_config cfg;
+    std::mutex mtx; // Guards streams and the writer start
+    std::vector<std::unique_ptr<log_stream>> streams;
+    std::atomic<size_t> n_streams{0};
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// Binary per slot UE recorder ([Recorder] section), see binary_recorder.
+struct recorder_config
+{
+    bool enabled = false;
+    // Output file. Empty: ue_record.bin in the UE log directory (logs/<log_id>/ue/), where
+    // py_analyzers/draw_ue.py looks for it.
+    std::string path;
+    // Block compression of the chunks: none (readable with numpy.memmap) or zlib.
+    std::string compression = "none";
+    // Slots per UE chunk.
+    int chunk_rows = 1024;
+};
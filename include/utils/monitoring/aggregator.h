@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <unordered_map>
 #include <map>
@@ -7,8 +9,16 @@
 #include <chrono>
 #include <functional>
 #include <thread>
+#include <memory>
+#include <vector>
 #include "monitoring_config.h"
 
+// Upper bound of the fields of one registered series (size of metric_values).
+#define METRIC_MAX_FIELDS 64
+// Registered series table: AGGREGATOR_SERIES_PAGES pages of AGGREGATOR_SERIES_PAGE series.
+#define AGGREGATOR_SERIES_PAGE 256
+#define AGGREGATOR_SERIES_PAGES 256
+
 enum class field_aggregation
 {
     sum,
@@ -30,17 +40,62 @@ struct metric_point
     std::int64_t ts_ns = 0;
 };
 
+struct metric_field_spec
+{
+    std::string name;
+    field_aggregation aggregation = field_aggregation::mean;
+};
+
+//--------------------------------------------------------------------------------------------------
+// metric_schema / metric_values: the two visitors of a field list function, i.e. a function calling
+// f(name, aggregation, value) once per field of a measurement. metric_schema collects the names at
+// registration, metric_values collects the values on the publish path into a fixed array, in the same
+// order, so the field list is written once and a series can never be published with shifted values.
+//--------------------------------------------------------------------------------------------------
+struct metric_schema
+{
+    std::vector<metric_field_spec> fields;
+
+    void operator()(const char *name, field_aggregation aggregation, double)
+    {
+        metric_field_spec field;
+        field.name = name;
+        field.aggregation = aggregation;
+        fields.push_back(field);
+    }
+};
+
+struct metric_values
+{
+    double values[METRIC_MAX_FIELDS];
+    int n = 0;
+
+    void operator()(const char *, field_aggregation, double value)
+    {
+        if(n < METRIC_MAX_FIELDS) values[n++] = value;
+    }
+};
+
 class aggregator
 {
 public:
     using emit_cb_t = std::function<void(const std::string &line)>;
+    using flush_cb_t = std::function<void()>;
 
     aggregator() = default;
     ~aggregator();
 
     void init(const monitoring_config &cfg);
+    void stop();
     void add_point(const metric_point &p);
+    int register_series(const std::string &measurement, const std::map<std::string,std::string> &tags,
+                        const std::vector<metric_field_spec> &fields);
+    void add_values(int series_id, const double *values, std::int64_t ts_ns);
+    void add_window(int series_id, const double *sums, const double *lasts, int samples, std::int64_t ts_ns);
+    unsigned window_index() const { return windows.load(std::memory_order_relaxed); }
     void set_emit_callback(emit_cb_t cb) { emit_cb = cb; }
+    // Called after the last line of each window, e.g. to send a batch.
+    void set_flush_callback(flush_cb_t cb) { flush_cb = cb; }
 
 private:
     struct window_accum
@@ -59,10 +114,51 @@ private:
         std::int64_t latest_ts_ns = 0;
     };
 
+    // One window of a registered series.
+    struct series_buffer
+    {
+        std::vector<window_accum> fields;
+        std::int64_t latest_ts_ns = 0;
+        bool touched = false;
+    };
+
+    // Series registered up front: the line prefix is built once and the accumulators are preallocated.
+    // Each series is its own shard: its single publisher writes buffers[epoch & 1] without locking,
+    // the flush thread bumps epoch at the window boundary and drains the other buffer.
+    struct registered_series
+    {
+        std::string line_prefix; // measurement,tag1=val,tag2=val
+        std::vector<metric_field_spec> fields;
+        series_buffer buffers[2];
+        std::atomic<unsigned> epoch{0};
+        std::atomic<bool> publishing{false};
+    };
+
+    // Fixed table of pages so that registering a series never moves the ones being published.
+    struct series_page
+    {
+        std::unique_ptr<registered_series> series[AGGREGATOR_SERIES_PAGE];
+    };
+
+    static void merge(window_accum &a, field_aggregation aggregation, double sum, double last, int samples,
+                      std::int64_t ts_ns);
+    static double window_value(const window_accum &a);
+    registered_series *find_series(int series_id) const;
+    bool stop_worker();
+    void flush_window();
+    void flush_registered();
+
     monitoring_config cfg;
-    std::mutex mtx;
+    std::mutex mtx; // Ad hoc points (add_point) and series registration
     std::unordered_map<std::string, series_window> accum;
-    bool running = false;
+    std::unique_ptr<series_page> pages[AGGREGATOR_SERIES_PAGES];
+    std::atomic<int> series_count{0};
+    std::atomic<unsigned> windows{0}; // Aggregation windows flushed so far
+    bool running = false; // Guarded by stop_mtx
+    std::mutex stop_mtx;
+    std::condition_variable stop_cv;
     std::thread worker;
     emit_cb_t emit_cb;
+    flush_cb_t flush_cb;
+    std::string line; // Reused by the flush thread for every line
 };
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HEALTH_LATENESS_BUCKETS 32
+
+// Counters of one UE, written by the thread stepping it.
+struct ue_health_counters
+{
+    std::atomic<std::uint64_t> pdcp_ns{0};
+    std::atomic<std::uint64_t> phy_ns{0};
+    std::atomic<std::uint64_t> mobility_ns{0};
+    std::atomic<std::uint64_t> monitoring_ns{0};
+    std::atomic<int> ip_packets[2];
+    std::atomic<int> harq_packets[2];
+
+    ue_health_counters()
+    {
+        for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+        {
+            ip_packets[tx_dir].store(0);
+            harq_packets[tx_dir].store(0);
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+// health_endpoint(): progress/health snapshot served on a Unix stream socket (health_socket in
+// [Global]). Every connection gets one JSON document with the simulated time, the per phase step
+// times (MAC, UE and, summed over the UEs, PDCP, mobility, PHY and monitoring), the slot lateness
+// percentiles in realtime mode, the queue depths and the UE count, then the connection is closed:
+//      socat - UNIX-CONNECT:/tmp/fikore_health.sock
+// The slot and UE threads only update relaxed atomics; the JSON is built by the endpoint thread.
+//--------------------------------------------------------------------------------------------------
+class health_endpoint
+{
+public:
+    health_endpoint() = default;
+    ~health_endpoint();
+
+    static health_endpoint &instance();
+
+    bool open(const std::string &socket_path, bool realtime);
+    bool is_open() const { return listen_fd != -1; }
+    void close();
+
+    // Counters of a new UE, owned by the endpoint; nullptr when the endpoint is not open.
+    ue_health_counters *add_ue();
+
+    // Called by the slot thread after each slot.
+    void slot_done(double sim_time_s, std::int64_t lateness_us, std::uint64_t mac_ns, std::uint64_t ue_ns)
+    {
+        slots.fetch_add(1, std::memory_order_relaxed);
+        sim_time_us.store((std::int64_t)(sim_time_s * 1e6), std::memory_order_relaxed);
+        mac_total_ns.fetch_add(mac_ns, std::memory_order_relaxed);
+        ue_total_ns.fetch_add(ue_ns, std::memory_order_relaxed);
+        if(!realtime_mode) return;
+        if(lateness_us < 0) lateness_us = 0;
+        int bucket = 0;
+        while(bucket < HEALTH_LATENESS_BUCKETS - 1 && (lateness_us >> bucket) > 0) bucket++;
+        lateness_hist[bucket].fetch_add(1, std::memory_order_relaxed);
+        if(lateness_us > lateness_max_us.load(std::memory_order_relaxed))
+            lateness_max_us.store(lateness_us, std::memory_order_relaxed);
+    }
+
+    // JSON snapshot, also used by tests.
+    std::string snapshot() const;
+
+private:
+    void serve();
+
+private:
+    int listen_fd = -1;
+    std::string path;
+    bool realtime_mode = false;
+    std::atomic<bool> stopping{false};
+    std::thread server;
+    std::chrono::steady_clock::time_point start_tp;
+
+    mutable std::mutex ues_mtx;
+    std::vector<std::unique_ptr<ue_health_counters>> ues;
+    std::atomic<std::size_t> n_ues{0};
+
+    std::atomic<std::uint64_t> slots{0};
+    std::atomic<std::int64_t> sim_time_us{0};
+    std::atomic<std::uint64_t> mac_total_ns{0};
+    std::atomic<std::uint64_t> ue_total_ns{0};
+    // Bucket b counts slots started less than 2^b us late (bucket 0: on time)
+    std::atomic<std::uint64_t> lateness_hist[HEALTH_LATENESS_BUCKETS] = {};
+    std::atomic<std::int64_t> lateness_max_us{0};
+};
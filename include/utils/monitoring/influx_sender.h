@@ -5,6 +5,13 @@
 #include <memory>
 #include "../monitoring/monitoring_config.h"
 
+//--------------------------------------------------------------------------------------------------
+// influx_sender(): ships line protocol to the configured outputs. Lines are collected into one batch
+// and sent on flush() (the aggregator flushes after each window): datagram outputs (udp, unix) get the
+// batch cut into datagrams of at most udp_payload_bytes, all datagrams for all destinations of a
+// socket family going out in one sendmmsg(); tcp outputs get it appended to a per output buffer that
+// is written as the socket accepts it, with reconnection (exponential backoff) when the peer is down.
+//--------------------------------------------------------------------------------------------------
 class influx_sender
 {
 public:
@@ -13,6 +20,7 @@ public:
 
     bool init(const monitoring_config &cfg);
     void send_line(const std::string &line);
+    void flush();
 
 private:
     struct impl;
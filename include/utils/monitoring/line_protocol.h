@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Influx line protocol formatting appended to a caller owned buffer, so the flush thread can reuse
+// one buffer per line instead of going through streams, locales and temporaries.
+
+// Appends value with six decimals, same text as printf("%.6f") (nan/inf included).
+void lp_append_fixed6(std::string &out, double value);
+// Appends a decimal integer (timestamps).
+void lp_append_int(std::string &out, std::int64_t value);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include "aggregator.h"
+
+//--------------------------------------------------------------------------------------------------
+// metric_window(): running sums of one registered series, kept by its publisher between hand-overs.
+// Visited by a field list function like metric_values, it adds each sample to a per field sum and
+// last value; monitoring_manager::publish(window) hands the window to the aggregator once per
+// aggregation window, so the aggregator is touched once per window instead of once per slot while
+// sum/mean/last keep their meaning (mean is sum over samples, merged with the sample count).
+// With a sample period of N slots only every Nth slot is visited and sum fields are scaled by N, so
+// a sum stays an estimate of the per slot total.
+// Input:
+//      series_id: id returned by monitoring_manager::register_series(), -1 disables the window.
+//      n_fields: number of fields of the series.
+//      sample_period: sample every sample_period slots (>= 1).
+//--------------------------------------------------------------------------------------------------
+class metric_window
+{
+public:
+    void init(int _series_id, size_t n_fields, int _sample_period)
+    {
+        series_id = _series_id;
+        sample_period = _sample_period > 1 ? _sample_period : 1;
+        sums.assign(n_fields, 0.0);
+        lasts.assign(n_fields, 0.0);
+        slot = 0;
+    }
+
+    int id() const { return series_id; }
+
+    // Called every slot; true when this slot has to be sampled.
+    bool sample_due()
+    {
+        if(series_id < 0) return false;
+        if(++slot < sample_period) return false;
+        slot = 0;
+        return true;
+    }
+
+    void operator()(const char *, field_aggregation aggregation, double value)
+    {
+        if(n >= sums.size()) return;
+        sums[n] += aggregation == field_aggregation::sum ? value * sample_period : value;
+        lasts[n] = value;
+        n++;
+    }
+
+    // Closes the sample being visited.
+    void end_sample()
+    {
+        n = 0;
+        samples++;
+    }
+
+    int sample_count() const { return samples; }
+    const double *sum_values() const { return sums.data(); }
+    const double *last_values() const { return lasts.data(); }
+
+    // Starts a new window after a hand-over.
+    void reset(unsigned window)
+    {
+        for(size_t i = 0; i < sums.size(); i++) sums[i] = 0.0;
+        samples = 0;
+        handed_window = window;
+    }
+
+    unsigned handed_over_window() const { return handed_window; }
+
+private:
+    int series_id = -1;
+    int sample_period = 1;
+    int slot = 0;
+    std::vector<double> sums;
+    std::vector<double> lasts;
+    size_t n = 0;
+    int samples = 0;
+    unsigned handed_window = 0;
+};
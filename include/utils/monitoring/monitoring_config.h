@@ -26,6 +26,18 @@ struct monitoring_config
     bool emit_emulator_runtime = true;
     bool emit_runtime_debug_logs = false;
     bool emit_text_logs_compat = false;
+    // Per measurement sampling: sample every N slots (1 = every slot). Sums are scaled by N.
+    int sample_slots_ue_phy = 1;
+    int sample_slots_ue_pdcp = 1;
+    int sample_slots_ue_queue = 1;
+    int sample_slots_ue_mobility = 1;
+    int sample_slots_l4s = 1;
+    int sample_slots_mac_scheduler = 1;
+    // Largest datagram sent to udp/unix outputs; lines are packed up to it (one line per datagram
+    // at most when a line alone is longer).
+    int udp_payload_bytes = 1400;
+    // Bytes kept per tcp output while it is slow or reconnecting; later batches are dropped.
+    int tcp_buffer_bytes = 4 << 20;
     std::vector<monitoring_output_config> outputs;
     std::map<std::string,std::string> extra;
 };
@@ -2,6 +2,7 @@
 
 #include "monitoring_config.h"
 #include "aggregator.h"
+#include "metric_window.h"
 #include "influx_sender.h"
 #include <atomic>
 #include <memory>
@@ -14,6 +15,12 @@ public:
     bool is_enabled() const;
     const monitoring_config &get_config() const;
     void publish(const metric_point &point);
+    int register_series(const std::string &measurement, const std::map<std::string,std::string> &tags,
+                        const std::vector<metric_field_spec> &fields);
+    void publish(int series_id, const double *values);
+    void publish(metric_window &window);
+    void hand_over(metric_window &window);
+    void stop();
     void send_text_line(const std::string &line);
     void set_slot_timestamp_ns(std::int64_t ts_ns);
     void clear_slot_timestamp_ns();
@@ -22,6 +29,7 @@ public:
 
 private:
     monitoring_manager();
+    std::int64_t publish_ts_ns() const;
     monitoring_config cfg;
     aggregator ag;
     influx_sender sender;
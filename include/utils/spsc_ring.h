@@ -0,0 +1,100 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#define SPSC_RING_CACHE_LINE 64
+
+//--------------------------------------------------------------------------------------------------
+// spsc_ring(): bounded lock free ring between exactly one producer thread and one consumer thread.
+// The slots are preallocated and reused: the producer fills the slot returned by claim() and makes it
+// visible with publish(), the consumer reads the slot returned by front() and gives it back with
+// pop(). Neither side ever waits; claim() returns nullptr when the ring is full. Each index lives on
+// its own cache line next to the cached copy of the other side's index, so the two threads only
+// touch each other's line when their cached view runs out.
+// Input:
+//      capacity: number of slots, rounded up to a power of two.
+//--------------------------------------------------------------------------------------------------
+template<typename T>
+class spsc_ring
+{
+public:
+    explicit spsc_ring(size_t capacity)
+    {
+        size_t n = 1;
+        while(n < capacity) n <<= 1;
+        slots.resize(n);
+        mask = n - 1;
+    }
+
+    size_t capacity() const { return slots.size(); }
+    size_t index_of(const T* slot) const { return (size_t)(slot - slots.data()); }
+
+    // Approximate when called from a thread other than producer or consumer. head is loaded before
+    // tail: head never passes tail, so a later tail is never behind it and the difference cannot wrap.
+    size_t size() const
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+
+    // Producer side
+    T* claim()
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head_cache == slots.size())
+        {
+            head_cache = head.load(std::memory_order_acquire);
+            if(t - head_cache == slots.size()) return nullptr;
+        }
+        return &slots[t & mask];
+    }
+
+    void publish()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side
+    T* front()
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail_cache)
+        {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if(h == tail_cache) return nullptr;
+        }
+        return &slots[h & mask];
+    }
+
+    const T* front() const
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &slots[h & mask];
+    }
+
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+
+    char pad0[SPSC_RING_CACHE_LINE];
+    std::atomic<size_t> tail{0}; // Written by the producer
+    size_t head_cache = 0;
+    char pad1[SPSC_RING_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> head{0}; // Written by the consumer
+    size_t tail_cache = 0;
+    char pad2[SPSC_RING_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
@@ -7,7 +7,11 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <string>
 
 inline std::chrono::steady_clock::time_point& _t0() {
     static auto t0 = std::chrono::steady_clock::now(); // init on first use
@@ -38,11 +42,99 @@ inline uint64_t ms_since_start() {
 #define BOLDCYAN    "\033[1m\033[36m"      /* Bold Cyan */
 #define BOLDWHITE   "\033[1m\033[37m"      /* Bold White */
 
+#define TERMINAL_LOG_INFO 1
+#define TERMINAL_LOG_WARNING 2
+#define TERMINAL_LOG_ERROR 3
+#define TERMINAL_LOG_OFF 4
 
-#define LOG_ERROR_I(where) std::cout << RED << ms_since_start() << " [ERROR][" << (where) << "]: " 
-#define LOG_ERROR() std::cout << RED <<  ms_since_start() <<  " [ERROR]: " 
-#define LOG_INFO_I(where) std::cout << BLUE << ms_since_start() <<  " [INFO][" << (where) << "]: "
-#define LOG_INFO() std::cout << BLUE << ms_since_start() << " [INFO]: "
-#define LOG_WARNING_I(where) std::cout << YELLOW << ms_since_start() << " [WARNING][" << (where) << "]: "
-#define LOG_WARNING() std::cout << YELLOW << ms_since_start() << " [WARNING]: "
-#define END() RESET << std::endl
+// Lowest level compiled in, e.g. make CPPFLAGS="-Iinclude -DTERMINAL_LOG_LEVEL=TERMINAL_LOG_WARNING"
+#ifndef TERMINAL_LOG_LEVEL
+#define TERMINAL_LOG_LEVEL TERMINAL_LOG_INFO
+#endif
+// Identical lines one call site may print per second. Further repeats are counted and reported
+// with the site's next printed line, by terminal_flush() and at exit.
+#ifndef TERMINAL_LOG_RATE
+#define TERMINAL_LOG_RATE 20
+#endif
+// Bytes of lines waiting for the terminal writer; lines logged while it is full are dropped
+#ifndef TERMINAL_LOG_QUEUE_BYTES
+#define TERMINAL_LOG_QUEUE_BYTES (1 << 20)
+#endif
+
+// Rate limit state of one LOG_* call site: the hash of its last line and how often it repeated.
+struct terminal_site
+{
+    std::atomic<uint64_t> window_s{0};
+    std::atomic<uint64_t> last_hash{0};
+    std::atomic<uint32_t> repeats{0};
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<bool> watched{false}; // Known to the writer, which reports its count at exit
+};
+
+struct terminal_end {};
+
+//--------------------------------------------------------------------------------------------------
+// terminal_line(): one line of the LOG_* macros. The values are formatted into a per thread stream
+// and the finished line is queued to the terminal writer thread when the statement ends, so the
+// logging thread never flushes or waits on stdout. Only repeats of the site's previous line count
+// against its rate, so a loop printing one line per UE is never cut short.
+//--------------------------------------------------------------------------------------------------
+class terminal_line
+{
+public:
+    terminal_line(terminal_site &site, const char *color, const char *tag, const char *where);
+    ~terminal_line();
+    terminal_line(const terminal_line &) = delete;
+    terminal_line &operator=(const terminal_line &) = delete;
+
+    template<typename T> terminal_line &operator<<(const T &value)
+    {
+        *out << value;
+        return *this;
+    }
+    terminal_line &operator<<(const terminal_end &) { return *this; }
+    // Manipulators such as std::fixed or std::hex
+    terminal_line &operator<<(std::ostream &(*manip)(std::ostream &))
+    {
+        *out << manip;
+        return *this;
+    }
+    terminal_line &operator<<(std::ios_base &(*manip)(std::ios_base &))
+    {
+        *out << manip;
+        return *this;
+    }
+
+private:
+    std::ostringstream *out = nullptr;
+    std::ostringstream *owned = nullptr; // Used instead of the thread's stream by nested lines
+    terminal_site &site;
+    const char *tag;
+    const char *where;
+    uint64_t window;
+    size_t text_start = 0; // Where the message starts, after the timestamp and tags
+};
+
+// Makes the macros a void expression, so they also work as the branch of an unbraced if/else.
+struct terminal_voidify
+{
+    void operator&(const terminal_line &) {}
+};
+
+// Writes the queued lines and the pending suppressed counts and waits for them, e.g. before a crash
+// is expected. Also done at exit.
+void terminal_flush();
+
+// A static rate limit state per expansion, one lambda type per call site.
+#define TERMINAL_SITE() ([]() -> terminal_site & { static terminal_site site; return site; }())
+// Lines below TERMINAL_LOG_LEVEL are a constant false branch the compiler removes.
+#define TERMINAL_LOG(level, color, tag, where) \
+    ((level) < TERMINAL_LOG_LEVEL) ? (void)0 : terminal_voidify() & terminal_line(TERMINAL_SITE(), color, tag, where)
+
+#define LOG_ERROR_I(where) TERMINAL_LOG(TERMINAL_LOG_ERROR, RED, "ERROR", where)
+#define LOG_ERROR() TERMINAL_LOG(TERMINAL_LOG_ERROR, RED, "ERROR", nullptr)
+#define LOG_INFO_I(where) TERMINAL_LOG(TERMINAL_LOG_INFO, BLUE, "INFO", where)
+#define LOG_INFO() TERMINAL_LOG(TERMINAL_LOG_INFO, BLUE, "INFO", nullptr)
+#define LOG_WARNING_I(where) TERMINAL_LOG(TERMINAL_LOG_WARNING, YELLOW, "WARNING", where)
+#define LOG_WARNING() TERMINAL_LOG(TERMINAL_LOG_WARNING, YELLOW, "WARNING", nullptr)
+#define END() terminal_end()
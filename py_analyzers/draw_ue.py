@@ -6,6 +6,7 @@ import sys
 import numpy as np
 import matplotlib.pyplot as plt
 from glob import glob
+from ue_record import read_record
 
 TIMESTAMP_DIR_RE = re.compile(r"^\d{4}_\d{2}_\d{2}_\d{2}_\d{2}_\d{2}$")
 
@@ -34,7 +35,8 @@ def parse_log_file_with_tx(file_path):
         'x': [], 'y': [],
         'rsrp_ul': [], 'rsrp_dl': [],
         'sinr_ul': [], 'sinr_dl': [],
-        'rul': [], 'rdl': [], 'ri': [],
+        'ri_ul': [], 'ri_dl': [],
+        'rul': [], 'rdl': [],
         'gul': [], 'gdl': [], 'eul': [], 'edl': [],
         'ceul': [], 'cedl': [], 'cebul': [], 'cebdl': [],
         'aqmdul': [], 'aqmddl': [], 'aqmdbul': [], 'aqmdbdl': [],
@@ -72,7 +74,12 @@ def parse_log_file_with_tx(file_path):
                     data['rsrp_ul'].append(temp['rsrp'])
                 else:
                     data['rsrp_dl'].append(temp['rsrp'])
-            for key in ['x', 'y', 'rul', 'rdl', 'ri', 'gul', 'gdl', 'eul', 'edl',
+            if 'ri' in temp and tx_flag is not None:
+                if tx_flag == 1:
+                    data['ri_ul'].append(temp['ri'])
+                else:
+                    data['ri_dl'].append(temp['ri'])
+            for key in ['x', 'y', 'rul', 'rdl', 'gul', 'gdl', 'eul', 'edl',
                         'ceul', 'cedl', 'cebul', 'cebdl',
                         'aqmdul', 'aqmddl', 'aqmdbul', 'aqmdbdl',
                         'nfqrecvul', 'nfqrecvdl', 'nfqrlsul', 'nfqrlsdl',
@@ -84,7 +91,7 @@ def parse_log_file_with_tx(file_path):
                 if key in temp:
                     data[key].append(temp[key])
             for key, value in temp.items():
-                if key not in ('tx', 'sinr', 'rsrp') and key not in ['x', 'y', 'rul', 'rdl', 'ri', 'gul', 'gdl', 'eul', 'edl',
+                if key not in ('tx', 'sinr', 'rsrp', 'ri') and key not in ['x', 'y', 'rul', 'rdl', 'gul', 'gdl', 'eul', 'edl',
                                                                       'ceul', 'cedl', 'cebul', 'cebdl',
                                                                       'aqmdul', 'aqmddl', 'aqmdbul', 'aqmdbdl',
                                                                       'nfqrecvul', 'nfqrecvdl', 'nfqrlsul', 'nfqrlsdl',
@@ -104,7 +111,7 @@ def plot_combined_trajectory(all_data, outdir):
         x, y = data['x'], data['y']
         n = min(len(x), len(y)) # Trim to the shortest length
         x, y = x[:n], y[:n]
-        if not x or not y:
+        if n == 0:
             continue
         plt.plot(x, y, label=f"UE {i}", alpha=0.6, color=cmap(i % cmap.N))
         plt.plot(x[0], y[0], 'o', color=cmap(i % cmap.N))
@@ -320,14 +327,20 @@ def main():
     out_dir = os.path.join(script_dir, "..", "results", log_folder, "ue")
     os.makedirs(out_dir, exist_ok=True)
 
-    all_data = [parse_log_file_with_tx(f) for f in log_files]
+    # The binary record, when the run wrote one, has every slot without parsing text
+    record_path = os.path.join(ue_dir, 'ue_record.bin')
+    if os.path.exists(record_path):
+        print(f"[INFO] Reading {record_path}")
+        all_data = [columns for _, columns in sorted(read_record(record_path).items())]
+    else:
+        all_data = [parse_log_file_with_tx(f) for f in log_files]
     plot_combined_trajectory(all_data, out_dir)
 
     plot_histograms_ul_dl(all_data, 'sinr_ul', 'sinr_dl', 'SINR Histogram', 'SINR (dB)', 'sinr_hist_ul_dl.png', bins=40, outdir=out_dir)
     plot_histograms_ul_dl(all_data, 'rsrp_ul', 'rsrp_dl', 'RSRP Histogram', 'RSRP (dBm)', 'rsrp_hist_ul_dl.png', bins=40, outdir=out_dir)
     plot_histograms_per_ue(all_data, 'rul', 'UL Throughput Histogram', 'Throughput (Mbps)', 'rul_hist.png', outdir=out_dir, bins=30)
     plot_histograms_per_ue(all_data, 'rdl', 'DL Throughput Histogram', 'Throughput (Mbps)', 'rdl_hist.png', outdir=out_dir, bins=30)
-    plot_histograms_per_ue(all_data, 'ri', 'Rank Indicator Histogram', 'Rank', 'ri_hist.png', outdir=out_dir, bins=np.arange(0.5, 5.5, 1))
+    plot_histograms_per_ue(all_data, 'ri_dl', 'DL Rank Indicator Histogram', 'Rank', 'ri_dl_hist.png', outdir=out_dir, bins=np.arange(0.5, 5.5, 1))
     plot_drop_sources(all_data, out_dir)
     if args.all:
         plot_histograms_per_ue(all_data, 'ceul', 'UL CE Marks Histogram', 'CE marks / log interval', 'ceul_hist.png', outdir=out_dir, bins=30)
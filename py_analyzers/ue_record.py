@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Reader of the binary UE record written by binary_recorder ([Recorder] section).
+
+Uncompressed chunks are mapped with numpy.memmap, zlib chunks are inflated in memory.
+The layout is documented in include/utils/logging/binary_recorder.h.
+"""
+import sys
+import zlib
+import numpy as np
+
+MAGIC = b"FKREC001"
+CHUNK_MAGIC = 0x4b4e4843
+CODEC_NONE = 0
+CODEC_ZLIB = 1
+NAME_LEN = 23
+
+CHUNK_HEADER = np.dtype([
+    ('magic', '<u4'), ('ue_id', '<i4'), ('rows', '<u4'), ('codec', '<u4'),
+    ('stored_bytes', '<u8'), ('raw_bytes', '<u8'),
+])
+
+
+def _padded(n):
+    return (n + 7) & ~7
+
+
+def read_header(raw):
+    if bytes(raw[:8]) != MAGIC:
+        raise ValueError("not a UE record file")
+    version, n_columns = np.frombuffer(raw, dtype='<u4', count=2, offset=8)
+    if version != 1:
+        raise ValueError(f"unsupported record version {version}")
+    columns = []
+    off = 16
+    for _ in range(n_columns):
+        dtype = np.dtype('<f8') if raw[off] == 1 else np.dtype('<f4')
+        name = bytes(raw[off + 1:off + 1 + NAME_LEN]).split(b'\0', 1)[0].decode()
+        # Records written before the DL rank column got its _dl suffix
+        if name == 'ri':
+            name = 'ri_dl'
+        columns.append((name, dtype))
+        off += 1 + NAME_LEN
+    return columns, off
+
+
+def _chunk_columns(buf, offset, rows, columns):
+    out = {}
+    for name, dtype in columns:
+        out[name] = np.frombuffer(buf, dtype=dtype, count=rows, offset=offset)
+        offset += _padded(rows * dtype.itemsize)
+    return out
+
+
+def read_record(path):
+    """Returns {ue_id: {column: np.ndarray}} with the slots of each UE in order."""
+    raw = np.memmap(path, dtype=np.uint8, mode='r')
+    columns, off = read_header(raw)
+    parts = {}
+    while off + CHUNK_HEADER.itemsize <= raw.size:
+        h = np.frombuffer(raw, dtype=CHUNK_HEADER, count=1, offset=off)[0]
+        if h['magic'] != CHUNK_MAGIC:
+            raise ValueError(f"bad chunk at offset {off}")
+        off += CHUNK_HEADER.itemsize
+        stored = int(h['stored_bytes'])
+        rows = int(h['rows'])
+        if h['codec'] == CODEC_NONE:
+            chunk = _chunk_columns(raw, off, rows, columns)
+        elif h['codec'] == CODEC_ZLIB:
+            chunk = _chunk_columns(zlib.decompress(raw[off:off + stored]), 0, rows, columns)
+        else:
+            raise ValueError(f"unknown codec {h['codec']}")
+        off += _padded(stored)
+        parts.setdefault(int(h['ue_id']), []).append(chunk)
+
+    record = {}
+    for ue_id, chunks in parts.items():
+        record[ue_id] = {name: np.concatenate([c[name] for c in chunks]) for name, _ in columns}
+    return record
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print(f"usage: {sys.argv[0]} ue_record.bin")
+        sys.exit(1)
+    for ue_id, cols in sorted(read_record(sys.argv[1]).items()):
+        print(f"UE {ue_id}: {len(cols['t'])} slots, columns: {' '.join(cols)}")
@@ -7,6 +7,7 @@ STATE_FILE="${GENERATED_DIR}/fikore_nfqueue_lab.env"
 
 ACTION="${1:-run}"
 BACKEND="${BACKEND:-}"
+CAPTURE_MODE="${CAPTURE_MODE:-}"
 CFG="${CFG:-}"
 CONFIG_FILE="${CONFIG_FILE:-${CFG}}"
 
@@ -21,6 +22,7 @@ UE_PREFIX="${UE_PREFIX:-10.201}"
 DN_EMU_IP="${DN_EMU_IP:-10.255.0.1}"
 DN_REAL_IP="${DN_REAL_IP:-10.255.0.2}"
 DN_CIDR="${DN_CIDR:-24}"
+PACKET_MMAP_UE_IP="${PACKET_MMAP_UE_IP:-10.255.0.3}"
 
 MGMT_HOST_IP="${MGMT_HOST_IP:-172.30.0.1}"
 MGMT_EMU_IP="${MGMT_EMU_IP:-172.30.0.2}"
@@ -51,8 +53,14 @@ die() {
 
 apply_default_settings() {
     BACKEND="${BACKEND:-host}"
-    CONFIG_FILE="${CONFIG_FILE:-${ROOT_DIR}/config/emulated_rural_n78_single_with_background.ini}"
-    UE_COUNT="${UE_COUNT:-2}"
+    CAPTURE_MODE="${CAPTURE_MODE:-nfqueue}"
+    if packet_mmap_mode; then
+        CONFIG_FILE="${CONFIG_FILE:-${ROOT_DIR}/config/emulated_rural_n78_single_packet_mmap.ini}"
+        UE_COUNT="${UE_COUNT:-1}"
+    else
+        CONFIG_FILE="${CONFIG_FILE:-${ROOT_DIR}/config/emulated_rural_n78_single_with_background.ini}"
+        UE_COUNT="${UE_COUNT:-2}"
+    fi
     if [[ -z "${UE_ACTIVE_SET}" ]]; then
         UE_ACTIVE_SET="$(default_active_ue_set "${UE_COUNT}")"
     fi
@@ -78,6 +86,7 @@ save_lab_state() {
     mkdir -p "${GENERATED_DIR}"
     cat > "${STATE_FILE}" <<EOF
 BACKEND='${BACKEND}'
+CAPTURE_MODE='${CAPTURE_MODE}'
 CONFIG_FILE='${CONFIG_FILE}'
 CONTAINER_NAME='${CONTAINER_NAME}'
 CONTAINER_WORKDIR='${CONTAINER_WORKDIR}'
@@ -88,6 +97,7 @@ UE_PREFIX='${UE_PREFIX}'
 DN_EMU_IP='${DN_EMU_IP}'
 DN_REAL_IP='${DN_REAL_IP}'
 DN_CIDR='${DN_CIDR}'
+PACKET_MMAP_UE_IP='${PACKET_MMAP_UE_IP}'
 UE_ACTIVE_SET='${UE_ACTIVE_SET}'
 MGMT_HOST_IP='${MGMT_HOST_IP}'
 MGMT_EMU_IP='${MGMT_EMU_IP}'
@@ -199,6 +209,21 @@ validate_backend() {
     esac
 }
 
+validate_capture_mode() {
+    case "${CAPTURE_MODE}" in
+        nfqueue) ;;
+        packet_mmap)
+            # The DL backend takes every frame arriving on the DN link, so it can only serve one UE
+            [[ "$(active_ue_count)" -eq 1 ]] || die "CAPTURE_MODE=packet_mmap supports a single UE (UE_COUNT=1)."
+            ;;
+        *) die "Invalid CAPTURE_MODE: ${CAPTURE_MODE}. Use nfqueue or packet_mmap." ;;
+    esac
+}
+
+packet_mmap_mode() {
+    [[ "${CAPTURE_MODE}" == "packet_mmap" ]]
+}
+
 emu_node_is_host() {
     [[ "${BACKEND}" == "host" || "${BACKEND}" == "docker-host" ]]
 }
@@ -240,7 +265,12 @@ mgmt_emu_if() {
 }
 
 ue_real_ip() {
-    printf "%s.%d.2" "${UE_PREFIX}" "$1"
+    if packet_mmap_mode; then
+        # Bridged: the UE sits on the DN subnet
+        printf "%s" "${PACKET_MMAP_UE_IP}"
+    else
+        printf "%s.%d.2" "${UE_PREFIX}" "$1"
+    fi
 }
 
 ue_emu_ip() {
@@ -491,6 +521,11 @@ setup_single_ue_namespace() {
     create_veth_pair "${host_if}" "${emu_if}"
     ip link set "${host_if}" netns "${ns}"
 
+    if packet_mmap_mode; then
+        setup_bridged_link "${ns}" "${host_if}" "${emu_if}" "${ue_ip}/${DN_CIDR}"
+        return 0
+    fi
+
     if emu_node_is_host; then
         ip addr add "${emu_ip}/30" dev "${emu_if}"
         ip link set "${emu_if}" up
@@ -508,6 +543,31 @@ setup_single_ue_namespace() {
     ip -n "${ns}" route add default via "${emu_ip}"
 }
 
+# packet_mmap mode: the EMU end has no address, FikoRE bridges frames between the UE and DN links.
+# Offloads are turned off on both ends: the AF_PACKET rings hold MTU sized frames only and forward
+# frames as they are, so GSO super-frames and unfinished checksums must not reach them.
+setup_bridged_link() {
+    local ns="$1"
+    local host_if="$2"
+    local emu_if="$3"
+    local addr="$4"
+
+    if emu_node_is_host; then
+        ip link set "${emu_if}" up
+    else
+        local pid
+        pid="$(docker_pid)"
+        ip link set "${emu_if}" netns "${pid}"
+        node_exec ip link set "${emu_if}" up
+    fi
+    node_exec ethtool -K "${emu_if}" tx off tso off gso off gro off >/dev/null
+
+    ip -n "${ns}" addr add "${addr}" dev "${host_if}"
+    ip -n "${ns}" link set lo up
+    ip -n "${ns}" link set "${host_if}" up
+    ip netns exec "${ns}" ethtool -K "${host_if}" tx off tso off gso off gro off >/dev/null
+}
+
 setup_ue_namespaces() {
     local i
     while read -r i; do
@@ -551,6 +611,11 @@ setup_dn_namespace() {
     create_veth_pair "${host_if}" "${emu_if}"
     ip link set "${host_if}" netns "${ns}"
 
+    if packet_mmap_mode; then
+        setup_bridged_link "${ns}" "${host_if}" "${emu_if}" "${DN_REAL_IP}/${DN_CIDR}"
+        return 0
+    fi
+
     if emu_node_is_host; then
         ip addr add "${DN_EMU_IP}/${DN_CIDR}" dev "${emu_if}"
         ip link set "${emu_if}" up
@@ -598,6 +663,7 @@ setup_iptables_chain() {
 }
 
 setup_nfqueue_rules() {
+    packet_mmap_mode && return 0
     setup_iptables_chain
 
     local dn_if i
@@ -711,6 +777,11 @@ start_topology() {
     fi
 
     UE_ACTIVE_SET="$(default_active_ue_set "${UE_COUNT}")"
+    validate_capture_mode
+    if packet_mmap_mode; then
+        require_cmd ethtool
+        node_exec ethtool --version >/dev/null 2>&1 || die "Missing required command on the EMU node: ethtool"
+    fi
     cleanup_namespaces
     if emu_node_is_host; then
         teardown_nfqueue_rules || true
@@ -760,6 +831,7 @@ status_topology() {
     fi
 
     echo "BACKEND=${BACKEND}"
+    echo "CAPTURE_MODE=${CAPTURE_MODE}"
     echo "CONFIG_FILE=${CONFIG_FILE}"
     echo "UE_COUNT=${UE_COUNT}"
     echo "UE_ACTIVE_SET=${UE_ACTIVE_SET}"
@@ -767,6 +839,10 @@ status_topology() {
     echo "Namespaces UE/DN:"
     while read -r i; do
         [[ -n "${i}" ]] || continue
+        if packet_mmap_mode; then
+            printf "  %s ue=%s bridged %s <-> %s\n" "$(ue_ns "${i}")" "$(ue_real_ip "${i}")" "$(ue_emu_if "${i}")" "$(dn_emu_if)"
+            continue
+        fi
         printf "  %s ue=%s emu=%s q_ul=%s q_dl=%s\n" \
             "$(ue_ns "${i}")" \
             "$(ue_real_ip "${i}")" \
@@ -774,7 +850,11 @@ status_topology() {
             "$(queue_ul "${i}")" \
             "$(queue_dl "${i}")"
     done < <(active_ue_indices)
-    printf "  %s ue=%s emu=%s\n" "$(dn_ns)" "${DN_REAL_IP}" "${DN_EMU_IP}"
+    if packet_mmap_mode; then
+        printf "  %s ue=%s bridged\n" "$(dn_ns)" "${DN_REAL_IP}"
+    else
+        printf "  %s ue=%s emu=%s\n" "$(dn_ns)" "${DN_REAL_IP}" "${DN_EMU_IP}"
+    fi
     if [[ "${BACKEND}" == "docker-none" ]]; then
         printf "  mgmt host=%s emu=%s\n" "${MGMT_HOST_IP}" "${MGMT_EMU_IP}"
     fi
@@ -994,6 +1074,7 @@ ue_add() {
     if ue_set_contains "${ue_idx}"; then
         die "UE${ue_idx} is already present in the lab."
     fi
+    packet_mmap_mode && die "ue-add is not available with CAPTURE_MODE=packet_mmap (single UE)."
 
     add_ue_to_active_set "${ue_idx}"
     setup_single_ue_namespace "${ue_idx}"
@@ -1028,6 +1109,7 @@ Usage: $(basename "$0") [run|up|down|status|capture-start|capture-stop|capture-s
 
 Variables:
   BACKEND=host|docker-host|docker-none
+  CAPTURE_MODE=nfqueue|packet_mmap
   CONFIG_FILE=/path/to/config.ini
   UE_COUNT=2
   CONTAINER_NAME=fikore-emu
@@ -1044,6 +1126,7 @@ Examples:
   sudo BACKEND=host UE_COUNT=2 $(basename "$0") up
   sudo CONFIG_FILE=$PWD/config/emulated_rural_n78_single_with_background.ini $(basename "$0") run
   sudo BACKEND=docker-host $(basename "$0") run
+  sudo CAPTURE_MODE=packet_mmap $(basename "$0") up
   sudo $(basename "$0") status
   sudo $(basename "$0") shell ue1
   sudo $(basename "$0") exec dn -- iperf3 -s -p 5202
@@ -34,12 +34,19 @@ std::string escape_influx_string_field(const std::string &value)
     return out;
 }
 
-metric_field make_metric_field(double value, field_aggregation aggregation)
+// Field list of the mac_scheduler measurement (see metric_schema / metric_values).
+template<typename F>
+void scheduler_fields(F &f, const grid_step_metrics &m)
 {
-    metric_field field;
-    field.value = value;
-    field.aggregation = aggregation;
-    return field;
+    f("scheduled_rbg_sum", field_aggregation::sum, m.scheduled_rbg_count);
+    f("empty_rbg_sum", field_aggregation::sum, m.empty_rbg_count);
+    f("scheduled_ues_sum", field_aggregation::sum, m.scheduled_ue_count);
+    f("active_ues_with_data_mean", field_aggregation::mean, m.active_ues_with_data);
+    f("scheduled_bits_sum", field_aggregation::sum, m.scheduled_bits);
+    f("effective_bits_sum", field_aggregation::sum, m.effective_bits);
+    f("grid_capacity_bits_last", field_aggregation::last, m.grid_capacity_bits);
+    f("utilization_ratio_mean", field_aggregation::mean, m.utilization_ratio);
+    f("scheduling_efficiency_ratio_mean", field_aggregation::mean, m.scheduling_efficiency_ratio);
 }
 
 std::string make_text_log_line(const std::string &direction, const std::string &line)
@@ -118,6 +125,32 @@ void mac_layer::init(std::vector<ue> *ue_list)
     grid_ul.init(ue_list);
 }
 
+//--------------------------------------------------------------------------------------------------
+// register_monitoring(): registers the mac_scheduler series. Must run after
+// monitoring_manager::init(), which happens after the MAC layer is constructed.
+//--------------------------------------------------------------------------------------------------
+void mac_layer::register_monitoring()
+{
+    monitoring_manager &monitoring = monitoring_manager::instance();
+    if(!monitoring.is_enabled() || !monitoring.get_config().emit_mac_scheduler) return;
+
+    metric_schema schema;
+    scheduler_fields(schema, grid_step_metrics());
+    const int period = monitoring.get_config().sample_slots_mac_scheduler;
+    scheduler_window[0].init(monitoring.register_series("mac_scheduler", {{"tx_dir", "dl"}}, schema.fields),
+                             schema.fields.size(), period);
+    scheduler_window[1].init(monitoring.register_series("mac_scheduler", {{"tx_dir", "ul"}}, schema.fields),
+                             schema.fields.size(), period);
+}
+
+// flush_monitoring(): hands over the scheduler windows still open, before monitoring stops.
+void mac_layer::flush_monitoring()
+{
+    monitoring_manager &monitoring = monitoring_manager::instance();
+    monitoring.hand_over(scheduler_window[0]);
+    monitoring.hand_over(scheduler_window[1]);
+}
+
 void mac_layer::flush_logs()
 {
     if(log)
@@ -149,40 +182,15 @@ void mac_layer::step(float current_t)
     }
 
     monitoring_manager &monitoring = monitoring_manager::instance();
-    if(monitoring.is_enabled() && monitoring.get_config().emit_mac_scheduler)
+    if(scheduler_window[0].sample_due())
+    {
+        scheduler_fields(scheduler_window[0], grid_dl.get_last_step_metrics());
+        monitoring.publish(scheduler_window[0]);
+    }
+    if(scheduler_window[1].sample_due())
     {
-        const grid_step_metrics &dl_metrics = grid_dl.get_last_step_metrics();
-        metric_point dl_point;
-        dl_point.measurement = "mac_scheduler";
-        dl_point.tags["tx_dir"] = "dl";
-        dl_point.ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count();
-        dl_point.fields["scheduled_rbg_sum"] = make_metric_field(dl_metrics.scheduled_rbg_count, field_aggregation::sum);
-        dl_point.fields["empty_rbg_sum"] = make_metric_field(dl_metrics.empty_rbg_count, field_aggregation::sum);
-        dl_point.fields["scheduled_ues_sum"] = make_metric_field(dl_metrics.scheduled_ue_count, field_aggregation::sum);
-        dl_point.fields["active_ues_with_data_mean"] = make_metric_field(dl_metrics.active_ues_with_data, field_aggregation::mean);
-        dl_point.fields["scheduled_bits_sum"] = make_metric_field(dl_metrics.scheduled_bits, field_aggregation::sum);
-        dl_point.fields["effective_bits_sum"] = make_metric_field(dl_metrics.effective_bits, field_aggregation::sum);
-        dl_point.fields["grid_capacity_bits_last"] = make_metric_field(dl_metrics.grid_capacity_bits, field_aggregation::last);
-        dl_point.fields["utilization_ratio_mean"] = make_metric_field(dl_metrics.utilization_ratio, field_aggregation::mean);
-        dl_point.fields["scheduling_efficiency_ratio_mean"] = make_metric_field(dl_metrics.scheduling_efficiency_ratio, field_aggregation::mean);
-        monitoring.publish(dl_point);
-
-        const grid_step_metrics &ul_metrics = grid_ul.get_last_step_metrics();
-        metric_point ul_point;
-        ul_point.measurement = "mac_scheduler";
-        ul_point.tags["tx_dir"] = "ul";
-        ul_point.ts_ns = dl_point.ts_ns;
-        ul_point.fields["scheduled_rbg_sum"] = make_metric_field(ul_metrics.scheduled_rbg_count, field_aggregation::sum);
-        ul_point.fields["empty_rbg_sum"] = make_metric_field(ul_metrics.empty_rbg_count, field_aggregation::sum);
-        ul_point.fields["scheduled_ues_sum"] = make_metric_field(ul_metrics.scheduled_ue_count, field_aggregation::sum);
-        ul_point.fields["active_ues_with_data_mean"] = make_metric_field(ul_metrics.active_ues_with_data, field_aggregation::mean);
-        ul_point.fields["scheduled_bits_sum"] = make_metric_field(ul_metrics.scheduled_bits, field_aggregation::sum);
-        ul_point.fields["effective_bits_sum"] = make_metric_field(ul_metrics.effective_bits, field_aggregation::sum);
-        ul_point.fields["grid_capacity_bits_last"] = make_metric_field(ul_metrics.grid_capacity_bits, field_aggregation::last);
-        ul_point.fields["utilization_ratio_mean"] = make_metric_field(ul_metrics.utilization_ratio, field_aggregation::mean);
-        ul_point.fields["scheduling_efficiency_ratio_mean"] = make_metric_field(ul_metrics.scheduling_efficiency_ratio, field_aggregation::mean);
-        monitoring.publish(ul_point);
+        scheduler_fields(scheduler_window[1], grid_ul.get_last_step_metrics());
+        monitoring.publish(scheduler_window[1]);
     }
     flush_logs(); 
 }
@@ -11,9 +11,9 @@ tdd_handler::tdd_handler(int n_dl_slots, int n_ul_slots, int transition_c, int _
     dl_slots = n_dl_slots;
     ul_slots = n_ul_slots;
     t_config = transition_c;
-    LOG_INFO_I("tdd_handler::tdd_handler") << "TDD Configuration DL [" << n_dl_slots << "]  UL [" << n_ul_slots << "] Transition [" << transition_c  << "] [";
-    for(int i = 0; i < 3; i++) for(int j = 0; j < TDD_5G_CONFIGURATION[transition_c][i]; j++) std::cout << TDD_ORDER[i];
-    LOG_INFO() << "]" << END();
+    std::string transition;
+    for(int i = 0; i < 3; i++) for(int j = 0; j < TDD_5G_CONFIGURATION[transition_c][i]; j++) transition += std::to_string(TDD_ORDER[i]);
+    LOG_INFO_I("tdd_handler::tdd_handler") << "TDD Configuration DL [" << n_dl_slots << "]  UL [" << n_ul_slots << "] Transition [" << transition_c  << "] [" << transition << "]" << END();
 }
 
 tdd_handler::tdd_handler(tdd_config tdd_c, int _tx)
@@ -26,9 +26,9 @@ tdd_handler::tdd_handler(tdd_config tdd_c, int _tx)
     dl_slots = tdd_c.n_dl_slots;
     ul_slots = tdd_c.n_ul_slots;
     t_config = tdd_c.transition_c;
-    LOG_INFO_I("tdd_handler::tdd_handler") << "TDD Configuration DL [" << tdd_c.n_dl_slots << "]  UL [" << tdd_c.n_ul_slots << "] Transition [" << tdd_c.transition_c  << "] [";
-    for(int i = 0; i < 3; i++) for(int j = 0; j < TDD_5G_CONFIGURATION[tdd_c.transition_c][i]; j++) std::cout << TDD_ORDER[i];
-    LOG_INFO() << "]" << END();
+    std::string transition;
+    for(int i = 0; i < 3; i++) for(int j = 0; j < TDD_5G_CONFIGURATION[tdd_c.transition_c][i]; j++) transition += std::to_string(TDD_ORDER[i]);
+    LOG_INFO_I("tdd_handler::tdd_handler") << "TDD Configuration DL [" << tdd_c.n_dl_slots << "]  UL [" << tdd_c.n_ul_slots << "] Transition [" << tdd_c.transition_c  << "] [" << transition << "]" << END();
 }
 
 void tdd_handler::set_syms(int _syms)
@@ -6,6 +6,12 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include <algorithm>
 
 #define _BSD_SOURCE             /* See feature_test_macros(7) */
 #include <endian.h>
@@ -22,6 +28,7 @@
 // We are using linux/... header files for homogeneity (instead of e.g. <netinet/ip.h>)
 #include <linux/if_ether.h> // ETH_P_IP
 #include <linux/ip.h>
+#include <linux/tcp.h>
 
 
 
@@ -227,8 +234,17 @@ Verdicts are:
 
 In practice, we shoud either NF_ACCEPT or NF_DROP
 
+NFQNL_MSG_VERDICT_BATCH applies one verdict to every queued packet with an id up to the given one. We cannot
+use it: packets that are still in the simulated PDCP/HARQ pipeline have lower ids than the ones we release.
+Instead, the verdicts of a slot are written back to back in one buffer (mnl_nlmsg_batch) and sent with a
+single sendto; the kernel processes every netlink message contained in the datagram.
+
 */
 
+// Soft limit for a verdict batch. The buffer has room for one extra message with a full payload.
+#define VERDICT_BATCH_LIMIT (MNL_SOCKET_BUFFER_SIZE * 16)
+#define VERDICT_BATCH_BUF_SIZE (VERDICT_BATCH_LIMIT + 0xffff + MNL_SOCKET_BUFFER_SIZE)
+
 #if 0 // Required to compile with libnetfilter_queue versions < 1.0.4
 static struct nlmsghdr *
 nfq_nlmsg_put(char *buf, int type, uint32_t queue_num)
@@ -256,6 +272,35 @@ nfq_nlmsg_put(char *buf, int type, uint32_t queue_num)
 #endif
 
 
+// Settings given to netfilter_interface_configure()
+static nfqueue_config receiver_cfg;
+
+/*
+ * A GSO super-packet leaves as ceil(l4 payload / mss) segments, each one with a copy of the IP and L4
+ * headers. NFQUEUE does not pass gso_size, so the configured MSS is used. Without the L4 header in the
+ * copied bytes a 20 byte TCP header is assumed.
+ */
+static void gso_segments(nfq_packet_metadata *meta, uint32_t orig_len)
+{
+	uint32_t mss = receiver_cfg.gso_mss > 0 ? receiver_cfg.gso_mss : 1448;
+	uint32_t hdr_len = sizeof(struct iphdr) + sizeof(struct tcphdr);
+
+	if (meta->payload && meta->payload_len >= sizeof(struct iphdr)) {
+		const struct iphdr *ip = (const struct iphdr *)meta->payload;
+		uint32_t ihl = ip->ihl * 4;
+		if (ip->protocol == IPPROTO_TCP && meta->payload_len >= ihl + sizeof(struct tcphdr))
+			hdr_len = ihl + ((const struct tcphdr *)(meta->payload + ihl))->doff * 4;
+		else if (ip->protocol == IPPROTO_UDP)
+			hdr_len = ihl + 8;
+	}
+
+	meta->gso = true;
+	if (orig_len > hdr_len) {
+		meta->segments = (orig_len - hdr_len + mss - 1) / mss;
+		meta->segment_hdr_bytes = hdr_len;
+	}
+}
+
 static int queue_cb(const struct nlmsghdr *nlh, void *data)
 {
 
@@ -284,7 +329,7 @@ static int queue_cb(const struct nlmsghdr *nlh, void *data)
 		orig_len = ntohl(mnl_attr_get_u32(attr[NFQA_CAP_LEN]));
 	}
 	else{
-		orig_len = nlh->nlmsg_len;
+		orig_len = attr[NFQA_PAYLOAD] ? mnl_attr_get_payload_len(attr[NFQA_PAYLOAD]) : 0;
 	}
 
 	if(attr[NFQA_TIMESTAMP]) {
@@ -316,15 +361,18 @@ static int queue_cb(const struct nlmsghdr *nlh, void *data)
 	meta.pkt_id = id;
 	meta.ecn = 0;
 	if(payload && plen > 0) {
-		uint8_t *payload_bytes = (uint8_t *)payload;
-		meta.payload.assign(payload_bytes, payload_bytes + plen);
+		meta.payload = (const uint8_t *)payload;
+		meta.payload_len = plen;
 	}
 
 	skbinfo = attr[NFQA_SKB_INFO] ? ntohl(mnl_attr_get_u32(attr[NFQA_SKB_INFO])) : 0;
 
 
-	if (skbinfo & NFQA_SKB_GSO)
+	if (skbinfo & NFQA_SKB_GSO) {
 		PRINTF("GSO ");
+		nfiface->gso_pkts++;
+		gso_segments(&meta, orig_len);
+	}
 
 	PRINTF("packet received (id=%u hw=0x%04x hook=%u, payload len %u",
 		id, ntohs(ph->hw_protocol), ph->hook, plen);
@@ -362,32 +410,195 @@ static int queue_cb(const struct nlmsghdr *nlh, void *data)
 }
 
 
+/*
+
+4. RECEIVER
+
+The queues are served by receive_threads receiver threads (one by default), queue q going to receiver
+q % receive_threads. Queue sockets are non-blocking and registered in the epoll set of their receiver; when
+a socket becomes readable the thread drains it until EAGAIN, so an idle emulator does not burn a core per
+queue. A thread is started with its first queue and stopped (through an eventfd) when its last one is
+closed. With busy_poll_us > 0 the threads spin on epoll_wait instead of sleeping in it. More than one
+thread only helps when the traffic is spread over several queues, e.g. with --queue-balance.
+
+*/
+
+#define RECEIVER_MAX_EVENTS 64
+#define RECEIVER_MAX_READS 64 // Datagrams read from one socket before serving the others
+#define RECEIVER_MAX_THREADS 16
+
+struct receiver_t {
+	pthread_mutex_t lock;
+	pthread_t tid;
+	int epfd;
+	int stopfd;
+	std::vector<netfilter_interface_t *> ifaces;
+
+	receiver_t() : tid(0), epfd(-1), stopfd(-1) {
+		pthread_mutex_init(&lock, NULL);
+	}
+};
+
+static receiver_t receivers[RECEIVER_MAX_THREADS];
+
+static receiver_t *receiver_of(netfilter_interface_t *nfiface) {
+	int threads = std::min(std::max(receiver_cfg.receive_threads, 1), RECEIVER_MAX_THREADS);
+	return &receivers[nfiface->queue_num % threads];
+}
+
+// Drains the socket with recvmmsg, up to recv_batch datagrams per call.
+static void receive_pkts(netfilter_interface_t *nfiface) {
+	int fd = mnl_socket_get_fd(nfiface->nl);
+	for (int i = 0; i < RECEIVER_MAX_READS; i++) {
+		for (unsigned int j = 0; j < nfiface->recv_batch; j++) {
+			nfiface->msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+			nfiface->msgs[j].msg_hdr.msg_flags = 0;
+			nfiface->msgs[j].msg_len = 0;
+		}
+
+		int n = recvmmsg(fd, nfiface->msgs, nfiface->recv_batch, MSG_DONTWAIT, NULL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			if (errno == ENOBUFS) {
+				nfiface->kernel_drops++;
+				continue; // Do not exit in this scenario
+			}
+			PERROR("recvmmsg");
+			nfiface->recv_fails++;
+			return;
+		}
+
+		for (int j = 0; j < n; j++) {
+			struct msghdr *hdr = &nfiface->msgs[j].msg_hdr;
+			// Only accept messages from the kernel, and drop the ones that did not fit the buffer
+			if (nfiface->addrs[j].nl_pid != 0 || (hdr->msg_flags & MSG_TRUNC)) {
+				nfiface->recv_fails++;
+				continue;
+			}
+			char *buf = (char *)nfiface->iovs[j].iov_base;
+			if (mnl_cb_run(buf, nfiface->msgs[j].msg_len, 0, nfiface->portid, queue_cb, nfiface) < 0) {
+				PERROR("mnl_cb_run");
+				nfiface->parse_fails++;
+			}
+		}
+
+		if ((unsigned int)n < nfiface->recv_batch)
+			return;
+	}
+}
+
 static void *run(void *arg) {
-	netfilter_interface_t *nfiface = (netfilter_interface_t *)arg;
-	
-	/* ENOBUFS is signalled to userspace when packets were lost
-	 * on kernel side.  In most cases, userspace isn't interested
-	 * in this information, so turn it off.
-	 */
-	int ret = 1;
-	//mnl_socket_setsockopt(nl, NETLINK_NO_ENOBUFS, &ret, sizeof(int));
+	receiver_t *receiver = (receiver_t *)arg;
+	struct epoll_event events[RECEIVER_MAX_EVENTS];
+	int timeout = receiver_cfg.busy_poll_us > 0 ? 0 : -1;
+	int epfd = receiver->epfd;
 
 	for (;;) {
-		ret = mnl_socket_recvfrom(nfiface->nl, nfiface->buf, nfiface->sizeof_buf);
-		if (ret == -1) {
-			PERROR("mnl_socket_recvfrom");
-			nfiface->recv_fails++;
-			if(errno == ENOBUFS)
-				continue; // Do not exit in this scenario	
-			//exit(EXIT_FAILURE);
+		int n = epoll_wait(epfd, events, RECEIVER_MAX_EVENTS, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			PERROR("epoll_wait");
+			return NULL;
+		}
+
+		pthread_mutex_lock(&receiver->lock);
+		for (int i = 0; i < n; i++) {
+			netfilter_interface_t *nfiface = (netfilter_interface_t *)events[i].data.ptr;
+			if (nfiface == NULL) {
+				pthread_mutex_unlock(&receiver->lock);
+				return NULL; // stopfd
+			}
+			// The queue may have been closed since epoll_wait returned
+			if (std::find(receiver->ifaces.begin(), receiver->ifaces.end(), nfiface) == receiver->ifaces.end())
+				continue;
+			receive_pkts(nfiface);
 		}
-		ret = mnl_cb_run(nfiface->buf, ret, 0, nfiface->portid, queue_cb, nfiface);
-		if (ret < 0){
-			PERROR("mnl_cb_run");
-			//exit(EXIT_FAILURE);
+		pthread_mutex_unlock(&receiver->lock);
+	}
+}
+
+static void receiver_remove(netfilter_interface_t *nfiface);
+
+static int receiver_add(netfilter_interface_t *nfiface) {
+	receiver_t *receiver = receiver_of(nfiface);
+	int fd = mnl_socket_get_fd(nfiface->nl);
+	if (receiver_cfg.busy_poll_us > 0) {
+		int busy_poll = receiver_cfg.busy_poll_us;
+		if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0)
+			PERROR("setsockopt SO_BUSY_POLL");
+	}
+
+	pthread_mutex_lock(&receiver->lock);
+	if (receiver->ifaces.empty()) {
+		receiver->epfd = epoll_create1(EPOLL_CLOEXEC);
+		receiver->stopfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		struct epoll_event stop_ev = {};
+		stop_ev.events = EPOLLIN;
+		stop_ev.data.ptr = NULL;
+		if (receiver->epfd < 0 || receiver->stopfd < 0 ||
+		    epoll_ctl(receiver->epfd, EPOLL_CTL_ADD, receiver->stopfd, &stop_ev) < 0 ||
+		    pthread_create(&receiver->tid, NULL, &run, receiver) != 0) {
+			PERROR("start receiver");
+			if (receiver->epfd >= 0) close(receiver->epfd);
+			if (receiver->stopfd >= 0) close(receiver->stopfd);
+			receiver->epfd = receiver->stopfd = -1;
+			pthread_mutex_unlock(&receiver->lock);
+			return -1;
 		}
 	}
 
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.ptr = nfiface;
+	receiver->ifaces.push_back(nfiface);
+	int ret = epoll_ctl(receiver->epfd, EPOLL_CTL_ADD, fd, &ev);
+	pthread_mutex_unlock(&receiver->lock);
+	if (ret < 0) {
+		PERROR("epoll_ctl");
+		receiver_remove(nfiface);
+		return -1;
+	}
+	return 0;
+}
+
+static void receiver_remove(netfilter_interface_t *nfiface) {
+	receiver_t *receiver = receiver_of(nfiface);
+	pthread_mutex_lock(&receiver->lock);
+	std::vector<netfilter_interface_t *>::iterator it = std::find(receiver->ifaces.begin(), receiver->ifaces.end(), nfiface);
+	if (it == receiver->ifaces.end()) {
+		pthread_mutex_unlock(&receiver->lock);
+		return;
+	}
+	epoll_ctl(receiver->epfd, EPOLL_CTL_DEL, mnl_socket_get_fd(nfiface->nl), NULL);
+	receiver->ifaces.erase(it);
+	if (!receiver->ifaces.empty()) {
+		pthread_mutex_unlock(&receiver->lock);
+		return;
+	}
+
+	// Last queue: stop the thread. It needs the lock to exit, so join after releasing it.
+	pthread_t tid = receiver->tid;
+	int epfd = receiver->epfd;
+	int stopfd = receiver->stopfd;
+	receiver->epfd = receiver->stopfd = -1;
+	uint64_t one = 1;
+	if (write(stopfd, &one, sizeof(one)) < 0)
+		PERROR("write stopfd");
+	pthread_mutex_unlock(&receiver->lock);
+
+	pthread_join(tid, NULL);
+	close(epfd);
+	close(stopfd);
+}
+
+void netfilter_interface_configure(const nfqueue_config *cfg) {
+	receiver_cfg = *cfg;
+}
+
+nfqueue_config netfilter_interface_get_config() {
+	return receiver_cfg;
 }
 
 
@@ -395,7 +606,14 @@ static void netfilter_interface_free(netfilter_interface_t *iface) {
 	if(iface) {
 		mnl_socket_close(iface->nl);
 		if(iface->buf)
-			delete(iface->buf);
+			free(iface->buf);
+		delete[] iface->msgs;
+		delete[] iface->iovs;
+		delete[] iface->addrs;
+		if(iface->vbatch)
+			mnl_nlmsg_batch_stop(iface->vbatch);
+		if(iface->vbuf)
+			free(iface->vbuf);
 		delete(iface);
 	}
 }
@@ -408,19 +626,26 @@ void cb(void* handler, netfilter_interface_t *nfiface, const nfq_packet_metadata
 netfilter_interface_t *netfilter_interface_open(int queue_num, add_pkt_callback_t callback, void *handler)
 {
 	struct nlmsghdr *nlh;
-	int ret;
 
 	netfilter_interface_t *nfiface = new netfilter_interface_t; 
-	printf("Queue_num: %d", queue_num);
 	nfiface->queue_num = queue_num;
 	nfiface->callback = callback;
 	nfiface->callback_data = handler;
 	nfiface->buf = NULL;
-	/* largest possible packet payload, plus netlink data overhead: */
-	nfiface->sizeof_buf = 0xffff + (MNL_SOCKET_BUFFER_SIZE/2);;
+	nfiface->msgs = NULL;
+	nfiface->iovs = NULL;
+	nfiface->addrs = NULL;
+	nfiface->recv_batch = receiver_cfg.recv_batch > 0 ? receiver_cfg.recv_batch : 1;
+	nfiface->vbuf = NULL;
+	nfiface->vbatch = NULL;
+	nfiface->vbatch_pkts = nfiface->vbatch_last_id = 0;
+	nfiface->copy_range = receiver_cfg.copy_range > 0 && receiver_cfg.copy_range < 0xffff ? receiver_cfg.copy_range : 0xffff;
+	/* largest copied packet payload, plus netlink data overhead: */
+	nfiface->sizeof_buf = nfiface->copy_range + (MNL_SOCKET_BUFFER_SIZE/2);
 
 	nfiface->last_recv_id = nfiface->total_recv = nfiface->last_rlsd_id = nfiface->total_rlsd = 0;
-	nfiface->bytes_recv = nfiface->recv_fails = nfiface->rlsd_fails = 0;
+	nfiface->bytes_recv = nfiface->recv_fails = nfiface->rlsd_fails = nfiface->rlsd_batches = 0;
+	nfiface->kernel_drops = nfiface->parse_fails = nfiface->overflow_drops = nfiface->gso_pkts = 0;
 
 	nfiface->nl = mnl_socket_open2(NETLINK_NETFILTER, SOCK_NONBLOCK);
 	if (nfiface->nl == NULL) {
@@ -437,12 +662,46 @@ netfilter_interface_t *netfilter_interface_open(int queue_num, add_pkt_callback_
 
 	nfiface->portid = mnl_socket_get_portid(nfiface->nl);
 
-	nfiface->buf = (char*)malloc(nfiface->sizeof_buf);
+	nfiface->buf = (char*)malloc(nfiface->sizeof_buf * nfiface->recv_batch);
 	if (!nfiface->buf) {
 		PERROR("allocate receive buffer");
 		netfilter_interface_free(nfiface);
 		return NULL;
 	}
+	nfiface->msgs = new struct mmsghdr[nfiface->recv_batch]();
+	nfiface->iovs = new struct iovec[nfiface->recv_batch]();
+	nfiface->addrs = new struct sockaddr_nl[nfiface->recv_batch]();
+	for (unsigned int i = 0; i < nfiface->recv_batch; i++) {
+		nfiface->iovs[i].iov_base = nfiface->buf + i * nfiface->sizeof_buf;
+		nfiface->iovs[i].iov_len = nfiface->sizeof_buf;
+		nfiface->msgs[i].msg_hdr.msg_name = &nfiface->addrs[i];
+		nfiface->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+		nfiface->msgs[i].msg_hdr.msg_iov = &nfiface->iovs[i];
+		nfiface->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if (receiver_cfg.rcvbuf_bytes > 0) {
+		int fd = mnl_socket_get_fd(nfiface->nl);
+		int rcvbuf = receiver_cfg.rcvbuf_bytes;
+		// SO_RCVBUFFORCE needs CAP_NET_ADMIN, SO_RCVBUF is capped by net.core.rmem_max
+		if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0 &&
+		    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0)
+			PERROR("setsockopt SO_RCVBUF");
+	}
+
+	if (receiver_cfg.no_enobufs) {
+		int on = 1;
+		if (mnl_socket_setsockopt(nfiface->nl, NETLINK_NO_ENOBUFS, &on, sizeof(int)) < 0)
+			PERROR("setsockopt NETLINK_NO_ENOBUFS");
+	}
+
+	nfiface->vbuf = (char*)malloc(VERDICT_BATCH_BUF_SIZE);
+	if (!nfiface->vbuf) {
+		PERROR("allocate verdict buffer");
+		netfilter_interface_free(nfiface);
+		return NULL;
+	}
+	nfiface->vbatch = mnl_nlmsg_batch_start(nfiface->vbuf, VERDICT_BATCH_LIMIT);
 
 	nlh = nfq_nlmsg_put(nfiface->buf, NFQNL_MSG_CONFIG, nfiface->queue_num);
 	nfq_nlmsg_cfg_put_cmd(nlh, AF_INET, NFQNL_CFG_CMD_BIND);
@@ -454,12 +713,16 @@ netfilter_interface_t *netfilter_interface_open(int queue_num, add_pkt_callback_
 	}	
     
 	nlh = nfq_nlmsg_put(nfiface->buf, NFQNL_MSG_CONFIG, nfiface->queue_num);
-	nfq_nlmsg_cfg_put_params(nlh, NFQNL_COPY_PACKET, 0xffff);
+	nfq_nlmsg_cfg_put_params(nlh, NFQNL_COPY_PACKET, nfiface->copy_range);
 	/*
-	 * Diagnostic setting: do not request NFQA_CFG_F_GSO while we are
-	 * rewriting ECN bits in userspace. This helps rule out interactions
-	 * between payload replacement and skb offload metadata.
+	 * NFQA_CFG_F_GSO is opt-in: without it the kernel segments every GSO skb before queueing it. GSO
+	 * packets are never mangled in the verdict (see pkt_capture::verdict), since payload replacement
+	 * resets the checksum offload state they depend on.
 	 */
+	if (receiver_cfg.gso) {
+		mnl_attr_put_u32(nlh, NFQA_CFG_FLAGS, htonl(NFQA_CFG_F_GSO));
+		mnl_attr_put_u32(nlh, NFQA_CFG_MASK, htonl(NFQA_CFG_F_GSO));
+	}
 
 	if (mnl_socket_sendto(nfiface->nl, nlh, nlh->nlmsg_len) < 0) {
 		PERROR("mnl_socket_send");
@@ -467,10 +730,7 @@ netfilter_interface_t *netfilter_interface_open(int queue_num, add_pkt_callback_
 		return NULL;
 	}
 	
-	ret = pthread_create(&nfiface->tid, NULL, &run, nfiface);
-
-	if(ret) {
-		PERROR("pthread_create");
+	if (receiver_add(nfiface) < 0) {
 		netfilter_interface_free(nfiface);
 		return NULL;
 	}
@@ -496,6 +756,20 @@ int netfilter_interface_release_pkt(netfilter_interface_t *nfiface, uint32_t pkt
 	return 0;
 }
 
+int netfilter_interface_drop_overflow(netfilter_interface_t *nfiface, uint32_t pkt_id) {
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	nlh = nfq_nlmsg_put(buf, NFQNL_MSG_VERDICT, nfiface->queue_num);
+	nfq_nlmsg_verdict_put(nlh, pkt_id, NF_DROP);
+
+	nfiface->overflow_drops++;
+	if (mnl_socket_sendto(nfiface->nl, nlh, nlh->nlmsg_len) < 0) {
+		PERROR("mnl_socket_send");
+		return -1;
+	}
+	return 0;
+}
+
 int netfilter_interface_release_pkt_payload(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, const uint8_t *payload, uint32_t payload_len) {
 	char buf[0xffff + MNL_SOCKET_BUFFER_SIZE];
 	struct nlmsghdr *nlh;
@@ -517,9 +791,66 @@ int netfilter_interface_release_pkt_payload(netfilter_interface_t *nfiface, uint
 	return 0;
 }
 
+static int send_verdict_batch(netfilter_interface_t *nfiface, size_t len, uint32_t pkts, uint32_t last_id) {
+	nfiface->rlsd_batches++;
+	if (mnl_socket_sendto(nfiface->nl, mnl_nlmsg_batch_head(nfiface->vbatch), len) < 0) {
+		PERROR("mnl_socket_send");
+		nfiface->rlsd_fails += pkts;
+		return -1;
+	}
+
+	nfiface->last_rlsd_id = last_id;
+	nfiface->total_rlsd += pkts;
+	return 0;
+}
+
+static struct nlmsghdr *put_verdict(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept) {
+	struct nlmsghdr *nlh = nfq_nlmsg_put((char*)mnl_nlmsg_batch_current(nfiface->vbatch), NFQNL_MSG_VERDICT, nfiface->queue_num);
+	nfq_nlmsg_verdict_put(nlh, pkt_id, accept ? NF_ACCEPT : NF_DROP);
+	return nlh;
+}
+
+static int commit_verdict(netfilter_interface_t *nfiface, uint32_t pkt_id) {
+	int ret = 0;
+	if (!mnl_nlmsg_batch_next(nfiface->vbatch)) {
+		/* The new message went over the limit: send the ones before it, reset moves it to the head */
+		ret = send_verdict_batch(nfiface, mnl_nlmsg_batch_size(nfiface->vbatch), nfiface->vbatch_pkts, nfiface->vbatch_last_id);
+		mnl_nlmsg_batch_reset(nfiface->vbatch);
+		nfiface->vbatch_pkts = 0;
+	}
+	nfiface->vbatch_pkts++;
+	nfiface->vbatch_last_id = pkt_id;
+	return ret;
+}
+
+int netfilter_interface_queue_verdict(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, const uint8_t *payload, uint32_t payload_len) {
+	struct nlmsghdr *nlh = put_verdict(nfiface, pkt_id, accept);
+	if(accept && payload != NULL && payload_len > 0) {
+		nfq_nlmsg_verdict_put_pkt(nlh, payload, payload_len);
+	}
+	return commit_verdict(nfiface, pkt_id);
+}
+
+int netfilter_interface_queue_verdict_mark(netfilter_interface_t *nfiface, uint32_t pkt_id, int accept, uint32_t mark) {
+	struct nlmsghdr *nlh = put_verdict(nfiface, pkt_id, accept);
+	nfq_nlmsg_verdict_put_mark(nlh, mark);
+	return commit_verdict(nfiface, pkt_id);
+}
+
+int netfilter_interface_flush_verdicts(netfilter_interface_t *nfiface) {
+	if (nfiface->vbatch_pkts == 0)
+		return 0;
+
+	int ret = send_verdict_batch(nfiface, mnl_nlmsg_batch_size(nfiface->vbatch), nfiface->vbatch_pkts, nfiface->vbatch_last_id);
+	mnl_nlmsg_batch_reset(nfiface->vbatch);
+	nfiface->vbatch_pkts = 0;
+	return ret;
+}
+
 void netfilter_interface_close(netfilter_interface_t *nfiface) {
 
-	pthread_cancel(nfiface->tid);
+	netfilter_interface_flush_verdicts(nfiface);
+	receiver_remove(nfiface);
 	netfilter_interface_free(nfiface);
 
 }
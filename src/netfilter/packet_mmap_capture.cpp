@@ -0,0 +1,264 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <netfilter/packet_mmap_capture.h>
+
+#define ETH_HDR_LEN 14
+
+packet_mmap_capture::packet_mmap_capture(std::string _if_in, std::string _if_out)
+    : pkt_capture(-1, ring_capacity(), PACKET_MMAP_FRAME_SIZE),
+      if_in(std::move(_if_in)),
+      if_out(std::move(_if_out))
+{
+}
+
+packet_mmap_capture::~packet_mmap_capture()
+{
+    close();
+}
+
+// Binds fd to the interface. RX sockets take every protocol (ETH_P_ALL) and make the interface
+// promiscuous; send-only sockets pass protocol 0 so the kernel does not queue a clone of every
+// frame on the interface to them.
+static bool bind_interface(int fd, const std::string& ifname, uint16_t protocol, bool promisc)
+{
+    int ifindex = (int)if_nametoindex(ifname.c_str());
+    if(ifindex == 0) return false;
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(protocol);
+    addr.sll_ifindex = ifindex;
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    if(!promisc) return true;
+
+    struct packet_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = ifindex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    return setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == 0;
+}
+
+// Sets up a TPACKET_V2 ring (PACKET_RX_RING or PACKET_TX_RING) of frames on fd and maps it.
+static uint8_t* map_ring(int fd, int ring_opt, unsigned int frames, size_t& size)
+{
+    int version = TPACKET_V2;
+    if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) return nullptr;
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = PACKET_MMAP_BLOCK_SIZE;
+    req.tp_frame_size = PACKET_MMAP_FRAME_SIZE;
+    req.tp_block_nr = frames / (PACKET_MMAP_BLOCK_SIZE / PACKET_MMAP_FRAME_SIZE);
+    req.tp_frame_nr = req.tp_block_nr * (PACKET_MMAP_BLOCK_SIZE / PACKET_MMAP_FRAME_SIZE);
+    if(setsockopt(fd, SOL_PACKET, ring_opt, &req, sizeof(req)) < 0) return nullptr;
+
+    size = (size_t)req.tp_block_size * req.tp_block_nr;
+    void *ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return ring == MAP_FAILED ? nullptr : (uint8_t*)ring;
+}
+
+bool packet_mmap_capture::open_rx()
+{
+    rx_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if(rx_fd < 0) return false;
+    rx_ring = map_ring(rx_fd, PACKET_RX_RING, PACKET_MMAP_RX_FRAMES, rx_ring_size);
+    // Bind after the ring exists so no frame is queued to the plain socket buffer
+    return rx_ring != nullptr && bind_interface(rx_fd, if_in, ETH_P_ALL, true);
+}
+
+bool packet_mmap_capture::open_tx()
+{
+    tx_fd = socket(AF_PACKET, SOCK_RAW, 0);
+    pass_fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if(tx_fd < 0 || pass_fd < 0) return false;
+    int one = 1;
+    setsockopt(tx_fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+    tx_ring = map_ring(tx_fd, PACKET_TX_RING, PACKET_MMAP_TX_FRAMES, tx_ring_size);
+    return tx_ring != nullptr && bind_interface(tx_fd, if_out, 0, false) && bind_interface(pass_fd, if_out, 0, false);
+}
+
+void packet_mmap_capture::start()
+{
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(stop_fd < 0 || !open_rx() || !open_tx())
+    {
+        LOG_ERROR_I("packet_mmap_capture::start") << "Cannot open PACKET_MMAP rings " << if_in << " -> " << if_out
+                                                  << ": " << strerror(errno) << END();
+        close();
+        return;
+    }
+    rx_thread = std::thread(&packet_mmap_capture::receive_loop, this);
+}
+
+void packet_mmap_capture::close()
+{
+    if(rx_thread.joinable())
+    {
+        uint64_t one = 1;
+        if(write(stop_fd, &one, sizeof(one)) < 0)
+            LOG_ERROR_I("packet_mmap_capture::close") << "write stop_fd: " << strerror(errno) << END();
+        rx_thread.join();
+    }
+    flush_verdicts();
+    if(rx_ring != nullptr) munmap(rx_ring, rx_ring_size);
+    if(tx_ring != nullptr) munmap(tx_ring, tx_ring_size);
+    rx_ring = tx_ring = nullptr;
+    if(rx_fd >= 0) ::close(rx_fd);
+    if(tx_fd >= 0) ::close(tx_fd);
+    if(pass_fd >= 0) ::close(pass_fd);
+    if(stop_fd >= 0) ::close(stop_fd);
+    rx_fd = tx_fd = pass_fd = stop_fd = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// receive_loop(): walks the RX ring, handing every frame the kernel filled to handle_frame() and
+// giving the slot straight back. Sleeps in poll() when the ring is empty.
+//--------------------------------------------------------------------------------------------------
+void packet_mmap_capture::receive_loop()
+{
+    const uint32_t frames = (uint32_t)(rx_ring_size / PACKET_MMAP_FRAME_SIZE);
+    struct pollfd fds[2];
+    fds[0].fd = rx_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_fd;
+    fds[1].events = POLLIN;
+
+    for(;;)
+    {
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr*)(rx_ring + (size_t)rx_frame * PACKET_MMAP_FRAME_SIZE);
+        if(!(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        {
+            fds[0].revents = fds[1].revents = 0;
+            if(poll(fds, 2, -1) < 0 && errno != EINTR) return;
+            if(fds[1].revents & POLLIN) return;
+            continue;
+        }
+
+        // Frames this host sends on if_in (e.g. the other direction's output) are not ours
+        const struct sockaddr_ll *sll = (const struct sockaddr_ll*)((uint8_t*)hdr + TPACKET_ALIGN(sizeof(struct tpacket2_hdr)));
+        if(sll->sll_pkttype != PACKET_OUTGOING)
+        {
+            uint64_t arrival_us = (uint64_t)hdr->tp_sec * 1000000ULL + hdr->tp_nsec / 1000;
+            handle_frame((uint8_t*)hdr + hdr->tp_mac, hdr->tp_snaplen, hdr->tp_len, arrival_us);
+        }
+
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        rx_frame = (rx_frame + 1) % frames;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// handle_frame(): hands an IPv4 frame to the slot thread and forwards anything else. A frame longer
+// than what the ring slot kept (wire_len > len) is a GSO/GRO super-frame: TSO or GRO is on along the
+// path and the kernel delivers up to 64 KB frames that PACKET_MMAP_FRAME_SIZE cuts short. Forwarding
+// the truncated copy would put a corrupt frame on if_out, so it is dropped and counted in gso_pkts.
+//--------------------------------------------------------------------------------------------------
+void packet_mmap_capture::handle_frame(const uint8_t* frame, uint32_t len, uint32_t wire_len, uint64_t arrival_us)
+{
+    if(wire_len > len)
+    {
+        if(gso_pkts++ == 0)
+            LOG_ERROR_I("packet_mmap_capture::handle_frame") << "Dropping " << wire_len << " byte GSO frame on " << if_in
+                                                             << ", disable TSO/GSO/GRO on both sides (ethtool -K <if> tso off gso off gro off)" << END();
+        return;
+    }
+
+    bool ipv4 = len >= ETH_HDR_LEN + 20 && frame[12] == 0x08 && frame[13] == 0x00;
+    if(!ipv4)
+    {
+        if(send(pass_fd, frame, len, MSG_DONTWAIT) < 0) rlsd_fails++;
+        return;
+    }
+
+    captured_packet_info info;
+    info.bytes = len - ETH_HDR_LEN;
+    info.pkt_id = next_id++;
+    info.ecn = frame[ETH_HDR_LEN + 1] & 0x03;
+    info.arrival_us = arrival_us;
+    total_recv++;
+    bytes_recv += (uint32_t)info.bytes;
+    if(!enqueue_captured_packet(info, frame, len)) overflow_drops++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// verdict(): writes accepted frames to the TX ring; they are sent by flush_verdicts(). Dropped
+// frames are simply forgotten.
+//--------------------------------------------------------------------------------------------------
+void packet_mmap_capture::verdict(uint32_t pkt_id, packet_capture_action action)
+{
+    uint32_t len = 0;
+    uint8_t *frame = stored_bytes(pkt_id, len);
+    if(frame == nullptr)
+    {
+        LOG_ERROR_I("packet_mmap_capture::verdict") << "Missing frame for pkt_id " << pkt_id << END();
+        return;
+    }
+
+    if(action == packet_capture_action::ACCEPT_CE) apply_ipv4_ecn(frame + ETH_HDR_LEN, len - ETH_HDR_LEN, ECN_CE);
+    if(action != packet_capture_action::DROP) transmit(frame, len);
+    forget_stored(pkt_id);
+}
+
+void packet_mmap_capture::transmit(const uint8_t* frame, uint32_t len)
+{
+    if(tx_ring == nullptr) return;
+    const uint32_t frames = (uint32_t)(tx_ring_size / PACKET_MMAP_FRAME_SIZE);
+    const size_t data_off = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+
+    struct tpacket2_hdr *hdr = (struct tpacket2_hdr*)(tx_ring + (size_t)tx_frame * PACKET_MMAP_FRAME_SIZE);
+    if(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+    {
+        // Ring full of frames the kernel has not sent yet: kick it once before giving up
+        flush_verdicts();
+        if(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+        {
+            rlsd_fails++;
+            return;
+        }
+    }
+    if(len > PACKET_MMAP_FRAME_SIZE - data_off)
+    {
+        rlsd_fails++;
+        return;
+    }
+
+    memcpy((uint8_t*)hdr + data_off, frame, len);
+    hdr->tp_len = len;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    tx_frame = (tx_frame + 1) % frames;
+    tx_pending++;
+    total_rlsd++;
+}
+
+void packet_mmap_capture::flush_verdicts()
+{
+    if(tx_fd < 0 || tx_pending == 0) return;
+    if(send(tx_fd, nullptr, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN) rlsd_fails++;
+    rlsd_batches++;
+    tx_pending = 0;
+}
+
+packet_capture_stats packet_mmap_capture::stats() const
+{
+    packet_capture_stats out;
+    out.queue_num = -1;
+    out.total_recv = total_recv.load();
+    out.bytes_recv = bytes_recv.load();
+    out.overflow_drops = overflow_drops.load();
+    out.gso_pkts = gso_pkts.load();
+    out.total_rlsd = total_rlsd;
+    out.rlsd_fails = rlsd_fails.load();
+    out.rlsd_batches = rlsd_batches;
+    return out;
+}
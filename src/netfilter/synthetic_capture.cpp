@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+#include <netfilter/synthetic_capture.h>
+
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET 1
+#define PCAP_LINKTYPE_RAW 101
+#define SYNTHETIC_HDR_LEN 20
+
+synthetic_capture::synthetic_capture(std::string _trace, float _speed, bool _loop, uint8_t _ecn)
+    : pkt_capture(-1),
+      trace(std::move(_trace)),
+      speed(_speed),
+      loop(_loop),
+      ecn(_ecn)
+{
+}
+
+synthetic_capture::~synthetic_capture()
+{
+    close();
+}
+
+static uint32_t read_u32(const unsigned char* p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+// Reads a classic pcap file. Packet sizes are IP lengths (the original length minus the Ethernet
+// header on Ethernet captures).
+static bool load_pcap(std::ifstream& file, std::vector<synthetic_trace_pkt>& out)
+{
+    unsigned char hdr[24];
+    if(!file.read((char*)hdr, sizeof(hdr))) return false;
+    uint32_t magic = read_u32(hdr, false);
+    bool swap = magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS);
+    magic = read_u32(hdr, swap);
+    if(magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) return false;
+    double frac = magic == PCAP_MAGIC_NS ? 1e-9 : 1e-6;
+    uint32_t linktype = read_u32(hdr + 20, swap);
+    uint32_t l2_len = linktype == PCAP_LINKTYPE_ETHERNET ? 14 : 0;
+    if(linktype != PCAP_LINKTYPE_ETHERNET && linktype != PCAP_LINKTYPE_RAW) return false;
+
+    unsigned char rec[16];
+    double t0 = -1.0;
+    while(file.read((char*)rec, sizeof(rec)))
+    {
+        double t = read_u32(rec, swap) + read_u32(rec + 4, swap) * frac;
+        uint32_t incl_len = read_u32(rec + 8, swap);
+        uint32_t orig_len = read_u32(rec + 12, swap);
+        if(!file.seekg(incl_len, std::ios::cur)) break;
+        if(orig_len <= l2_len) continue;
+        if(t0 < 0.0) t0 = t;
+        synthetic_trace_pkt pkt;
+        pkt.t_s = t - t0;
+        pkt.bytes = orig_len - l2_len;
+        out.push_back(pkt);
+    }
+    return true;
+}
+
+bool synthetic_capture::load_trace(const std::string& path, std::vector<synthetic_trace_pkt>& out)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if(!file) return false;
+    if(load_pcap(file, out)) return true;
+
+    out.clear();
+    file.clear();
+    file.seekg(0);
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        synthetic_trace_pkt pkt;
+        if(fields >> pkt.t_s >> pkt.bytes) out.push_back(pkt);
+    }
+    return !out.empty();
+}
+
+void synthetic_capture::start()
+{
+    close();
+    pkts.clear();
+    // An empty trace (e.g. a pcap with a header and no records) would make a looping replay spin
+    if(!load_trace(trace, pkts) || pkts.empty())
+    {
+        LOG_ERROR_I("synthetic_capture::start") << "Cannot read trace or trace is empty " << trace << END();
+        done = true;
+        return;
+    }
+    stop = false;
+    done = false;
+    replay_thread = std::thread(&synthetic_capture::replay, this);
+}
+
+void synthetic_capture::close()
+{
+    stop = true;
+    if(replay_thread.joinable()) replay_thread.join();
+}
+
+//--------------------------------------------------------------------------------------------------
+// replay(): producer thread. Waits for each packet's trace time (scaled by speed) and pushes it to
+// the capture ring, stamped with the wall clock so arrival times line up with the emulator clock.
+//--------------------------------------------------------------------------------------------------
+void synthetic_capture::replay()
+{
+    uint8_t header[SYNTHETIC_HDR_LEN];
+    uint32_t next_id = 0;
+    do
+    {
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        for(size_t i = 0; i < pkts.size() && !stop; i++)
+        {
+            if(speed > 0.0f)
+            {
+                std::chrono::system_clock::time_point due = start + std::chrono::microseconds((int64_t)(pkts[i].t_s / speed * 1e6));
+                std::this_thread::sleep_until(due);
+            }
+
+            captured_packet_info info;
+            info.pkt_id = next_id++;
+            info.bytes = std::max<uint32_t>(pkts[i].bytes, SYNTHETIC_HDR_LEN);
+            info.ecn = ecn;
+            info.arrival_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+            // Minimal IPv4 header so ECN rewriting sees a valid packet
+            memset(header, 0, sizeof(header));
+            header[0] = 0x45;
+            header[1] = ecn & 0x03;
+            header[2] = (uint8_t)(info.bytes >> 8);
+            header[3] = (uint8_t)(info.bytes & 0xff);
+            header[8] = 64;
+            header[9] = 17;
+
+            while(!enqueue_captured_packet(info, header, sizeof(header)))
+            {
+                if(speed > 0.0f || stop)
+                {
+                    overflow_drops++;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            total_recv++;
+            bytes_recv += (uint32_t)info.bytes;
+        }
+    } while(loop && !stop);
+    done = true;
+}
+
+void synthetic_capture::verdict(uint32_t pkt_id, packet_capture_action action)
+{
+    if(action == packet_capture_action::ACCEPT) n_accept++;
+    else if(action == packet_capture_action::ACCEPT_CE) n_accept_ce++;
+    else n_drop++;
+    if(record)
+    {
+        verdict_record r;
+        r.pkt_id = pkt_id;
+        r.action = action;
+        verdicts.push_back(r);
+    }
+    forget_stored(pkt_id);
+}
+
+packet_capture_stats synthetic_capture::stats() const
+{
+    packet_capture_stats out;
+    out.queue_num = -1;
+    out.total_recv = total_recv.load();
+    out.bytes_recv = bytes_recv.load();
+    out.overflow_drops = overflow_drops.load();
+    out.total_rlsd = n_accept + n_accept_ce + n_drop;
+    return out;
+}
@@ -41,13 +41,24 @@ float captured_packet_handler::ingest(int tx_dir, float current_t)
     if(!pkt_cptr) return 0.0f;
 
     float bits = 0.0f;
+    float now = get_current_ts();
+    capture_delay_max = 0.0f;
     captured_packet_info info;
     while(pkt_cptr->pop_captured_packet(info))
     {
-        int size = (int)info.bytes * 8;
-        ip_pkt pkt(get_current_ts(), size, size, prev_uid, info.pkt_id, bh_d, bh_d_var);
+        // A GSO super-packet goes over the air as its segments, each one with its own headers
+        int size = (int)(info.bytes + (uint64_t)(info.segments - 1) * info.segment_hdr_bytes) * 8;
+        bool clock_mismatch = false;
+        float arrival_t = arrival_ts(info, now, clock_mismatch);
+        if(clock_mismatch) capture_clock_mismatches++;
+        capture_delay_sum += now - arrival_t;
+        capture_delay_packets++;
+        capture_delay_max = std::max(capture_delay_max, now - arrival_t);
+
+        ip_pkt pkt(arrival_t, size, size, prev_uid, info.pkt_id, bh_d, bh_d_var);
         pkt.ecn = info.ecn;
         pkt.original_ecn = info.ecn;
+        pkt.pkt_count = info.segments;
         bits += pkt.size;
         push_ingress_pkt(std::move(pkt));
         prev_uid = info.pkt_id;
@@ -59,8 +70,8 @@ void captured_packet_handler::drop_ingress_pkt(ip_pkt pkt)
 {
     pkt.erase = true;
     pkt.t_out = current_t;
-    out_pkts.push_back(std::move(pkt));
-    sort_by_id();
+    uint32_t uid = pkt.uid;
+    out_pkts.insert(uid, std::move(pkt));
 }
 
 void captured_packet_handler::push(harq_pkt pkt)
@@ -73,10 +84,9 @@ void captured_packet_handler::push(harq_pkt pkt)
         if(!add_data(&(*jt)))
         {
             jt->frags_recovered++;
-            out_pkts.push_back(std::move(*jt));
+            out_pkts.insert(jt->uid, std::move(*jt));
         }
     }
-    sort_by_id();
 }
 
 void captured_packet_handler::drop(harq_pkt pkt)
@@ -88,7 +98,7 @@ void captured_packet_handler::drop(harq_pkt pkt)
         if(!remove_data(jt->uid, jt->size))
         {
             jt->erase = true;
-            out_pkts.push_back(std::move(*jt));
+            out_pkts.insert(jt->uid, std::move(*jt));
         }
     }
 }
@@ -99,52 +109,39 @@ float captured_packet_handler::release()
     float bits = 0;
     float latency = 0;
     float ip_latency = 0;
-    for(std::deque<ip_pkt>::iterator it = out_pkts.begin(); it != out_pkts.end();)
+    while(!out_pkts.empty())
     {
-        if(it->is_ready())
+        ip_pkt &pkt = out_pkts.front();
+        if(!pkt.is_ready()) break;
+
+        if(pkt.erase)
+        {
+            update_order(pkt.uid);
+            drop_packets++;
+            verdict(pkt, final_packet_verdict::DROP);
+        }
+        else
         {
-            if(it->erase)
+            if(!check_order(pkt.prev_uid) || pkt.t_out > current_t) break;
+
+            bits += pkt.original_size;
+            latency += current_t - pkt.current_t;
+            ip_latency += current_t - pkt.ip_t;
+            update_order(pkt.uid);
+            if(pkt.ce_marked)
             {
-                update_order(it->uid);
-                drop_packets++;
-                verdict(*it, final_packet_verdict::DROP);
-                it = out_pkts.erase(it);
+                ce_rewrite_packets++;
+                verdict(pkt, final_packet_verdict::ACCEPT_CE);
             }
             else
             {
-                if(check_order(it->prev_uid))
-                {
-                    if(it->t_out <= current_t)
-                    {
-                        bits += it->original_size;
-                        latency += current_t - it->current_t;
-                        ip_latency += current_t - it->ip_t;
-                        update_order(it->uid);
-                        if(it->ce_marked)
-                        {
-                            ce_rewrite_packets++;
-                            verdict(*it, final_packet_verdict::ACCEPT_CE);
-                        }
-                        else
-                        {
-                            verdict(*it, final_packet_verdict::ACCEPT);
-                        }
-                        it = out_pkts.erase(it);
-                        count++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                else
-                {
-                    break;
-                }
+                verdict(pkt, final_packet_verdict::ACCEPT);
             }
+            count++;
         }
-        else break;
+        out_pkts.pop_front();
     }
+    if(pkt_cptr) pkt_cptr->flush_verdicts();
     tp_mean.add(bits);
     if(count > 0)
     {
@@ -165,9 +162,15 @@ void captured_packet_handler::fill_queue_status(pdcp_queue_status& status, float
         captured_packet_info oldest_capture;
         if(pkt_cptr->peek_oldest_captured(oldest_capture))
         {
+            float now = get_current_ts();
             status.capture_oldest_uid = (int)oldest_capture.pkt_id;
-            status.capture_oldest_age = -1.0f;
+            bool clock_mismatch = false;
+            status.capture_oldest_age = now - arrival_ts(oldest_capture, now, clock_mismatch);
         }
+        status.capture_delay_sum_s = capture_delay_sum;
+        status.capture_delay_packets = capture_delay_packets;
+        status.capture_delay_max_s = capture_delay_max;
+        status.capture_clock_mismatches = capture_clock_mismatches;
 
         packet_capture_stats stats = pkt_cptr->stats();
         status.nfqueue_queue_num = stats.queue_num;
@@ -175,7 +178,12 @@ void captured_packet_handler::fill_queue_status(pdcp_queue_status& status, float
         status.nfqueue_total_rlsd = (int)stats.total_rlsd;
         status.nfqueue_bytes_recv = (int)stats.bytes_recv;
         status.nfqueue_recv_fails = (int)stats.recv_fails;
+        status.nfqueue_kernel_drops = (int)stats.kernel_drops;
+        status.nfqueue_parse_fails = (int)stats.parse_fails;
+        status.nfqueue_overflow_drops = (int)stats.overflow_drops;
+        status.nfqueue_gso_pkts = (int)stats.gso_pkts;
         status.nfqueue_rlsd_fails = (int)stats.rlsd_fails;
+        status.nfqueue_rlsd_batches = (int)stats.rlsd_batches;
     }
 
     status.release_size = (int)out_pkts.size();
@@ -196,38 +204,47 @@ float captured_packet_handler::get_current_ts() const
         std::chrono::system_clock::now().time_since_epoch() - *init_t).count()) * 0.000001f;
 }
 
-void captured_packet_handler::sort_by_id()
+//--------------------------------------------------------------------------------------------------
+// arrival_ts(): arrival time of a captured packet on the emulator clock. Both the capture timestamp
+// and init_t are wall clock microseconds, so the arrival is their difference. Packets without a
+// timestamp, or without a clock to align to, arrive now; the result never lies in the future. A
+// timestamp before the emulator start or beyond now + ARRIVAL_TS_SLACK_S comes from another clock
+// (e.g. a monotonic skb tstamp on locally generated traffic): the packet arrives now and
+// clock_mismatch is set so the caller can report it.
+//--------------------------------------------------------------------------------------------------
+float captured_packet_handler::arrival_ts(const captured_packet_info& info, float now, bool& clock_mismatch) const
 {
-    std::sort(out_pkts.begin(), out_pkts.end(), sorter);
+    clock_mismatch = false;
+    if(init_t == nullptr || info.arrival_us == 0) return now;
+    int64_t rel_us = (int64_t)info.arrival_us - (int64_t)init_t->count();
+    float rel_t = (float)rel_us * 0.000001f;
+    if(rel_us < 0 || rel_t > now + ARRIVAL_TS_SLACK_S)
+    {
+        clock_mismatch = true;
+        return now;
+    }
+    return std::min(now, rel_t);
 }
 
 bool captured_packet_handler::add_data(ip_pkt *recv_pkt)
 {
-    for(std::deque<ip_pkt>::iterator jt = out_pkts.begin(); jt != out_pkts.end(); jt++)
-    {
-        if(jt->uid == recv_pkt->uid)
-        {
-            jt->size += recv_pkt->size;
-            jt->frags_recovered++;
-            jt->frags_created = recv_pkt->frags_created;
-            return true;
-        }
-    }
-    return false;
+    ip_pkt *stored = out_pkts.find(recv_pkt->uid);
+    if(stored == nullptr) return false;
+
+    stored->size += recv_pkt->size;
+    stored->frags_recovered++;
+    stored->frags_created = recv_pkt->frags_created;
+    return true;
 }
 
 bool captured_packet_handler::remove_data(int id, float bits)
 {
-    for(std::deque<ip_pkt>::iterator jt = out_pkts.begin(); jt != out_pkts.end(); jt++)
-    {
-        if(jt->uid == (uint32_t)id)
-        {
-            jt->erase = true;
-            jt->size += bits;
-            return true;
-        }
-    }
-    return false;
+    ip_pkt *stored = out_pkts.find((uint32_t)id);
+    if(stored == nullptr) return false;
+
+    stored->erase = true;
+    stored->size += bits;
+    return true;
 }
 
 bool captured_packet_handler::check_order(int id)
@@ -79,10 +79,36 @@ bool ip_buffer::add_pkt(ip_pkt pkt)
 
     current_size += pkt.size; 
     if(verbosity > 0) g_mean.add(pkt.size);
-    generated_pkts_interval++;
-    generated_pkts_total++;
+    generated_pkts_interval += pkt.pkt_count;
+    generated_pkts_total += pkt.pkt_count;
     if(!backend_has_pkts()) oldest_t = pkt.current_t;
-    backend_requeue_front(std::move(pkt));
+    backend_enqueue(std::move(pkt));
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// split_burst(): when a fluid burst (pkt_count > 1) does not fit in the buffer, cuts it down to the
+// packets that still fit and moves the rest to rejected, so an overflow only drops the excess
+// packets instead of the whole burst. Only for fluid bursts: a captured GSO packet also has
+// pkt_count > 1 but is a single skb with a single verdict. The burst packets are assumed to be
+// of equal size, size / pkt_count bits each. Output: true when rejected holds packets to drop.
+//--------------------------------------------------------------------------------------------------
+bool ip_buffer::split_burst(ip_pkt& pkt, ip_pkt& rejected)
+{
+    if(pkt.pkt_count <= 1 || current_size + pkt.size <= max_size) return false;
+    const float free_bits = max_size - current_size;
+    const float pkt_bits = pkt.size / pkt.pkt_count;
+    const uint32_t fit = free_bits > 0.0f ? (uint32_t)floorf(free_bits / pkt_bits) : 0;
+    if(fit == 0) return false;
+
+    rejected = pkt;
+    rejected.pkt_count = pkt.pkt_count - fit;
+    rejected.size = pkt.size - fit * pkt_bits;
+    rejected.original_size = rejected.size;
+    pkt.pkt_count = fit;
+    pkt.size = fit * pkt_bits;
+    pkt.original_size = pkt.size;
+    if(verbosity > 0) e_mean.add(rejected.size);
     return true;
 }
 
@@ -94,44 +120,44 @@ void ip_buffer::step(float _current_t){
     if(l4s_cfg.enabled) l4s_queue.step(current_t);
 }
 
+//--------------------------------------------------------------------------------------------------
+// get_pkts(): fills out_pkt with up to _bits bits. Packets are cut in place at the head of the
+// queue: a partial fit emits a fragment of the head packet and only shrinks what is left of it, so
+// the remainder is never popped and requeued. Output: number of bits taken from the buffer.
+//--------------------------------------------------------------------------------------------------
 float ip_buffer::get_pkts(float _bits, harq_pkt& out_pkt)
 {
     float bits = floorf(_bits); 
-    int n_out_pkts = 0; 
     out_pkt.bits = 0; 
-    while(bits > 0 && backend_has_pkts())
+    while(bits > 0)
     {
-        ip_pkt pkt = empty_pkt();
-        if(!backend_pop_next(pkt)) break;
-        if(bits >= pkt.size)
+        ip_pkt *head = backend_front();
+        if(head == nullptr) break;
+        if(bits >= head->size)
         {
-            oldest_t = pkt.current_t;
-            bits -= pkt.size; 
-            out_pkt.bits += pkt.size; 
-            pkt.is_fragment = false;
-            pkt.frags_created++;
-            out_pkt.pkts.push_back(std::move(pkt));
-            n_out_pkts++;
+            oldest_t = head->current_t;
+            bits -= head->size; 
+            out_pkt.bits += head->size; 
+            head->is_fragment = false;
+            head->frags_created++;
+            head->offset = head->original_size - head->size;
+            out_pkt.pkts.push_back(std::move(*head));
+            backend_pop_front();
 
             if(bits <= BIT_ROUND_MARGIN) {
                 break; 
             }
-                
         }
         else
         {
-            ip_pkt pkt_f(pkt);
-            pkt.size -= bits;
+            head->is_fragment = true; 
+            head->frags_created++;
+            head->offset = head->original_size - head->size;
+            out_pkt.pkts.push_back(*head);
+            out_pkt.pkts.back().size = bits;
+            head->size -= bits;
             out_pkt.bits += bits; 
-            pkt_f.size = bits;
-            pkt_f.is_fragment = true; 
-            pkt_f.frags_created++;
-            out_pkt.pkts.push_back(std::move(pkt_f));
             bits = 0; 
-            pkt.is_fragment = true; 
-            pkt.frags_created++;
-            backend_requeue_front(std::move(pkt));
-            n_out_pkts++;
         } 
     }
     current_size -= out_pkt.bits; 
@@ -174,6 +200,7 @@ bool ip_buffer::pop_oldest_pkt(harq_pkt& out_pkt)
     ip_pkt pkt = empty_pkt();
     if(!backend_pop_oldest(pkt)) return false;
 
+    pkt.offset = pkt.original_size - pkt.size;
     out_pkt.bits = pkt.size;
     out_pkt.pkts.push_back(std::move(pkt));
 
@@ -214,6 +241,7 @@ bool ip_buffer::pop_aqm_dropped_pkt(harq_pkt& out_pkt)
     if(!l4s_cfg.enabled || !l4s_queue.has_dropped_pkts()) return false;
     ip_pkt pkt(0.0f, 0.0f, 0.0f, 0, 0.0f, 0.0f);
     if(!l4s_queue.pop_dropped_pkt(pkt)) return false;
+    pkt.offset = pkt.original_size - pkt.size;
     out_pkt.pkts.clear();
     out_pkt.bits = pkt.size;
     out_pkt.ip_t = pkt.ip_t;
@@ -227,53 +255,88 @@ bool ip_buffer::pop_aqm_dropped_pkt(harq_pkt& out_pkt)
 
 bool ip_buffer::backend_has_pkts() const
 {
-    return l4s_cfg.enabled ? l4s_queue.has_pkts() : !pkt_list.empty();
+    if(l4s_cfg.enabled) return l4s_head_valid || l4s_queue.has_pkts();
+    return !pkt_list.empty();
 }
 
 int ip_buffer::backend_size() const
 {
-    return l4s_cfg.enabled ? l4s_queue.size() : (int)pkt_list.size();
+    if(l4s_cfg.enabled) return l4s_queue.size() + (l4s_head_valid ? 1 : 0);
+    return (int)pkt_list.size();
 }
 
-bool ip_buffer::backend_pop_next(ip_pkt& pkt)
+// The DualPI2 scheduler marks or drops packets when dequeuing them, so the L4S head is dequeued
+// once into l4s_head and stays there while it is being fragmented.
+ip_pkt* ip_buffer::backend_front()
 {
-    if(l4s_cfg.enabled) return l4s_queue.pop_next(pkt);
-    if(pkt_list.empty()) return false;
-    pkt = std::move(pkt_list.front());
-    pkt_list.pop_front();
-    return true;
+    if(l4s_cfg.enabled)
+    {
+        if(!l4s_head_valid) l4s_head_valid = l4s_queue.pop_next(l4s_head);
+        return l4s_head_valid ? &l4s_head : nullptr;
+    }
+    if(pkt_list.empty()) return nullptr;
+    return &pkt_list.front();
+}
+
+void ip_buffer::backend_pop_front()
+{
+    if(l4s_cfg.enabled)
+    {
+        l4s_head_valid = false;
+        return;
+    }
+    if(!pkt_list.empty()) pkt_list.pop_front();
 }
 
 bool ip_buffer::backend_pop_oldest(ip_pkt& pkt)
 {
-    if(l4s_cfg.enabled) return l4s_queue.pop_oldest(pkt);
+    if(l4s_cfg.enabled)
+    {
+        const ip_pkt *queued = l4s_queue.peek_oldest();
+        if(l4s_head_valid && (queued == nullptr || l4s_head.current_t <= queued->current_t))
+        {
+            pkt = std::move(l4s_head);
+            l4s_head_valid = false;
+            return true;
+        }
+        return l4s_queue.pop_oldest(pkt);
+    }
     if(pkt_list.empty()) return false;
     pkt = std::move(pkt_list.front());
     pkt_list.pop_front();
     return true;
 }
 
-void ip_buffer::backend_requeue_front(ip_pkt pkt)
+void ip_buffer::backend_enqueue(ip_pkt pkt)
 {
     if(l4s_cfg.enabled)
     {
         l4s_queue.enqueue(std::move(pkt));
         return;
     }
-    if(pkt.size <= pkt.original_size && pkt.is_fragment) pkt_list.push_front(std::move(pkt));
-    else pkt_list.push_back(std::move(pkt));
+    pkt_list.push_back(std::move(pkt));
 }
 
 const ip_pkt* ip_buffer::backend_peek_oldest() const
 {
-    if(l4s_cfg.enabled) return l4s_queue.peek_oldest();
+    if(l4s_cfg.enabled)
+    {
+        const ip_pkt *queued = l4s_queue.peek_oldest();
+        if(l4s_head_valid && (queued == nullptr || l4s_head.current_t <= queued->current_t)) return &l4s_head;
+        return queued;
+    }
     if(pkt_list.empty()) return nullptr;
     return &pkt_list.front();
 }
 
 float ip_buffer::backend_oldest_timestamp() const
 {
-    if(l4s_cfg.enabled) return l4s_queue.oldest_timestamp(current_t);
+    if(l4s_cfg.enabled)
+    {
+        float oldest = l4s_queue.oldest_timestamp(current_t);
+        if(l4s_head_valid && (!l4s_queue.has_pkts() || l4s_head.current_t < oldest)) oldest = l4s_head.current_t;
+        return oldest;
+    }
     if(pkt_list.empty()) return current_t;
     return pkt_list.front().current_t;
 }
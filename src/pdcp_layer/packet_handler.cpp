@@ -7,6 +7,9 @@
 #include <chrono>
 #include <utility>
 
+#include <netfilter/packet_mmap_capture.h>
+#include <netfilter/pkt_capture_group.h>
+#include <netfilter/synthetic_capture.h>
 #include <pdcp_layer/captured_packet_handler.h>
 #include <pdcp_layer/packet_handler.h>
 #include <pdcp_layer/simulated_packet_handler.h>
@@ -65,7 +68,7 @@ void packet_handler::drop_ingress_pkt(ip_pkt pkt)
 void packet_handler::push(harq_pkt pkt)
 {
     pkt.t_out += pkt.backhaul_d + gauss_dist(gauss_dist_gen)*pkt.backhaul_d_var;
-    pkt_list.push_back(std::move(pkt));
+    pkt_list.push(std::move(pkt));
 }
 
 void packet_handler::drop(harq_pkt pkt)
@@ -79,21 +82,17 @@ float packet_handler::release()
     float bits = 0;
     float latency = 0;
     float ip_latency = 0;
-    for(std::deque<harq_pkt>::iterator it=pkt_list.begin(); it!=pkt_list.end();)
+    harq_pkt pkt;
+    while(pkt_list.pop_due(current_t, pkt))
     {
-        if(it->t_out <= current_t)
+        bits += pkt.bits;
+        latency += current_t - pkt.current_t;
+        ip_latency += current_t - pkt.ip_t;
+        count++;
+        for(std::deque<ip_pkt>::const_iterator pkt_it = pkt.pkts.begin(); pkt_it != pkt.pkts.end(); ++pkt_it)
         {
-            bits += it->bits;
-            latency += current_t - it->current_t;
-            ip_latency += current_t - it->ip_t;
-            count++;
-            for(std::deque<ip_pkt>::const_iterator pkt_it = it->pkts.begin(); pkt_it != it->pkts.end(); ++pkt_it)
-            {
-                verdict(*pkt_it, pkt_it->ce_marked ? final_packet_verdict::ACCEPT_CE : final_packet_verdict::ACCEPT);
-            }
-            it = pkt_list.erase(it);
+            verdict(*pkt_it, pkt_it->ce_marked ? final_packet_verdict::ACCEPT_CE : final_packet_verdict::ACCEPT);
         }
-        else it++;
     }
     if(count > 0)
     {
@@ -109,11 +108,12 @@ float packet_handler::release()
 void packet_handler::fill_queue_status(pdcp_queue_status& status, float current_t) const
 {
     status.release_size = (int)pkt_list.size();
-    if(!pkt_list.empty())
+    int oldest_id;
+    float oldest_ip_t;
+    if(pkt_list.peek_oldest(oldest_id, oldest_ip_t))
     {
-        const harq_pkt &pkt = pkt_list.front();
-        status.release_oldest_uid = pkt.id;
-        status.release_oldest_age = current_t - pkt.ip_t;
+        status.release_oldest_uid = oldest_id;
+        status.release_oldest_age = current_t - oldest_ip_t;
     }
     status.final_accept_packets = final_accept_packets_interval;
     status.final_accept_ce_packets = final_accept_ce_packets_interval;
@@ -163,18 +163,18 @@ void packet_handler::push_ingress_pkt(ip_pkt pkt)
     ingress_pkts.push_back(std::move(pkt));
 }
 
-void packet_handler::verdict(const ip_pkt&, final_packet_verdict verdict_value)
+void packet_handler::verdict(const ip_pkt& pkt, final_packet_verdict verdict_value)
 {
     switch(verdict_value)
     {
     case final_packet_verdict::ACCEPT:
-        final_accept_packets_interval++;
+        final_accept_packets_interval += pkt.pkt_count;
         break;
     case final_packet_verdict::ACCEPT_CE:
-        final_accept_ce_packets_interval++;
+        final_accept_ce_packets_interval += pkt.pkt_count;
         break;
     case final_packet_verdict::DROP:
-        final_drop_packets_interval++;
+        final_drop_packets_interval += pkt.pkt_count;
         break;
     }
 }
@@ -183,11 +183,34 @@ std::unique_ptr<packet_handler> make_packet_handler(packet_handler_config cfg)
 {
     if(cfg.ue_type == SIM_UE)
     {
-        std::unique_ptr<packet_handler> handler(new simulated_packet_handler(cfg.ue_id, cfg.traffic_c, cfg.pdcp_c, cfg.log_traffic));
+        // DualPI2 marks and drops per packet, so the fluid mode is only used with the legacy queue.
+        bool fluid_pkts = cfg.fluid_pkts && !cfg.l4s_c.enabled;
+        std::unique_ptr<packet_handler> handler(new simulated_packet_handler(cfg.ue_id, cfg.traffic_c, cfg.pdcp_c, cfg.log_traffic, fluid_pkts));
+        return handler;
+    }
+
+    if(cfg.capture_c.backend == capture_backend::PACKET_MMAP)
+    {
+        std::unique_ptr<pkt_capture> capture(new packet_mmap_capture(cfg.capture_c.if_in, cfg.capture_c.if_out));
+        std::unique_ptr<packet_handler> handler(new captured_packet_handler(std::move(capture), cfg.init_t, cfg.pdcp_c, cfg.log_quality));
+        return handler;
+    }
+
+    if(cfg.capture_c.backend == capture_backend::SYNTHETIC)
+    {
+        const capture_config &c = cfg.capture_c;
+        std::unique_ptr<pkt_capture> capture(new synthetic_capture(c.trace, c.speed, c.loop, (uint8_t)c.ecn));
+        std::unique_ptr<packet_handler> handler(new captured_packet_handler(std::move(capture), cfg.init_t, cfg.pdcp_c, cfg.log_quality));
         return handler;
     }
 
     assert(cfg.queue_num >= 0);
+    if(cfg.queue_count > 1)
+    {
+        std::unique_ptr<pkt_capture> capture(new pkt_capture_group(cfg.queue_num, cfg.queue_count));
+        std::unique_ptr<packet_handler> handler(new captured_packet_handler(std::move(capture), cfg.init_t, cfg.pdcp_c, cfg.log_quality));
+        return handler;
+    }
     std::unique_ptr<packet_handler> handler(new captured_packet_handler(cfg.queue_num, cfg.init_t, cfg.pdcp_c, cfg.log_quality));
     return handler;
 }
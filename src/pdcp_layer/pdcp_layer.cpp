@@ -57,6 +57,11 @@ void pdcp_layer::drain_ingress_pkts()
     while(_packet_h->has_ingress_pkts())
     {
         ip_pkt pkt = _packet_h->pop_ingress_pkt();
+        if(pkt.pkt_count > 1 && _packet_h->splits_bursts())
+        {
+            ip_pkt rejected(pkt);
+            if(_ip_buffer.split_burst(pkt, rejected)) _packet_h->drop_ingress_pkt(std::move(rejected));
+        }
         if(!_ip_buffer.add_pkt(pkt))
         {
             _packet_h->drop_ingress_pkt(std::move(pkt));
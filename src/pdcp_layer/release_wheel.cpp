@@ -0,0 +1,228 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+#include <pdcp_layer/release_wheel.h>
+
+#define L0_SIZE (1 << RELEASE_WHEEL_L0_BITS)
+#define L1_SIZE (1 << RELEASE_WHEEL_L1_BITS)
+#define L0_MASK (L0_SIZE - 1)
+#define L1_MASK (L1_SIZE - 1)
+#define CYCLE_BITS (RELEASE_WHEEL_L0_BITS + RELEASE_WHEEL_L1_BITS)
+
+release_wheel::release_wheel(float _tick_s)
+    : tick_s(_tick_s > 0.0f ? _tick_s : RELEASE_WHEEL_TICK_S),
+      l0(L0_SIZE),
+      l1(L1_SIZE)
+{
+}
+
+void release_wheel::push(harq_pkt pkt)
+{
+    count++;
+    by_age.push_back(std::make_pair(pkt.ip_t, pkt.id));
+    std::push_heap(by_age.begin(), by_age.end(), std::greater<std::pair<float, int>>());
+    place(std::move(pkt));
+}
+
+//--------------------------------------------------------------------------------------------------
+// pop_due(): moves the wheel up to current_t and returns, one per call, the packets whose t_out is
+// not later than current_t. Output: false once no more packets are due.
+//--------------------------------------------------------------------------------------------------
+bool release_wheel::pop_due(float current_t, harq_pkt& pkt)
+{
+    if(ready.empty() && count > 0)
+    {
+        advance(tick_of(current_t), current_t);
+        collect(l0[cursor & L0_MASK], current_t);
+    }
+    if(ready.empty()) return false;
+
+    pkt = std::move(ready.front());
+    ready.pop_front();
+    count--;
+    forget_age(pkt);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// peek_next(): returns a packet from the earliest non empty bucket, that is one of the next packets
+// to be released, or nullptr when the wheel is empty.
+//--------------------------------------------------------------------------------------------------
+const harq_pkt* release_wheel::peek_next() const
+{
+    if(!ready.empty()) return &ready.front();
+    if(l0_count > 0)
+    {
+        for(int64_t i = cursor & L0_MASK; i < L0_SIZE; i++)
+        {
+            if(!l0[i].empty()) return &l0[i].front();
+        }
+    }
+    if(l1_count > 0)
+    {
+        for(int64_t i = ((cursor >> RELEASE_WHEEL_L0_BITS) & L1_MASK) + 1; i < L1_SIZE; i++)
+        {
+            if(!l1[i].empty()) return &l1[i].front();
+        }
+    }
+    if(!overflow.empty()) return &overflow.front();
+    return nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// peek_oldest(): id and ip_t of the waiting packet with the earliest ip_t, which is not necessarily
+// the next one released. Output: false when the wheel is empty.
+//--------------------------------------------------------------------------------------------------
+bool release_wheel::peek_oldest(int& id, float& ip_t) const
+{
+    if(by_age.empty()) return false;
+    ip_t = by_age.front().first;
+    id = by_age.front().second;
+    return true;
+}
+
+void release_wheel::clear()
+{
+    for(size_t i = 0; i < l0.size(); i++) l0[i].clear();
+    for(size_t i = 0; i < l1.size(); i++) l1[i].clear();
+    overflow.clear();
+    ready.clear();
+    by_age.clear();
+    released_age.clear();
+    count = 0;
+    l0_count = 0;
+    l1_count = 0;
+}
+
+// Marks pkt as released in the age heaps. Released entries only leave by_age once they reach its
+// top, so its top is always a waiting packet.
+void release_wheel::forget_age(const harq_pkt& pkt)
+{
+    std::greater<std::pair<float, int>> later;
+    released_age.push_back(std::make_pair(pkt.ip_t, pkt.id));
+    std::push_heap(released_age.begin(), released_age.end(), later);
+    while(!released_age.empty() && !by_age.empty() && released_age.front() == by_age.front())
+    {
+        std::pop_heap(released_age.begin(), released_age.end(), later);
+        released_age.pop_back();
+        std::pop_heap(by_age.begin(), by_age.end(), later);
+        by_age.pop_back();
+    }
+}
+
+int64_t release_wheel::tick_of(float t) const
+{
+    if(t <= 0.0f) return 0;
+    return (int64_t)std::floor(t / tick_s);
+}
+
+// Stores pkt in the level matching its tick. Packets already late go to the current bucket.
+void release_wheel::place(harq_pkt&& pkt)
+{
+    int64_t tick = tick_of(pkt.t_out);
+    if(tick < cursor) tick = cursor;
+
+    if((tick >> RELEASE_WHEEL_L0_BITS) == (cursor >> RELEASE_WHEEL_L0_BITS))
+    {
+        l0[tick & L0_MASK].push_back(std::move(pkt));
+        l0_count++;
+    }
+    else if((tick >> CYCLE_BITS) == (cursor >> CYCLE_BITS))
+    {
+        l1[(tick >> RELEASE_WHEEL_L0_BITS) & L1_MASK].push_back(std::move(pkt));
+        l1_count++;
+    }
+    else
+    {
+        overflow.push_back(std::move(pkt));
+    }
+}
+
+// Moves the cursor to tick now, emptying every level 0 bucket left behind and skipping whole
+// rounds or cycles when the levels below them are empty.
+void release_wheel::advance(int64_t now, float current_t)
+{
+    std::vector<harq_pkt> late;
+    while(cursor < now)
+    {
+        if(l0_count == 0)
+        {
+            int64_t next;
+            if(l1_count > 0) next = ((cursor >> RELEASE_WHEEL_L0_BITS) + 1) << RELEASE_WHEEL_L0_BITS;
+            else if(!overflow.empty()) next = ((cursor >> CYCLE_BITS) + 1) << CYCLE_BITS;
+            else next = now;
+
+            if(next >= now)
+            {
+                // Landing exactly on a round boundary still has to pull in the next round.
+                bool boundary = (next == now) && (l1_count > 0 || !overflow.empty());
+                cursor = now;
+                if(boundary) cascade();
+                break;
+            }
+            cursor = next;
+            cascade();
+            continue;
+        }
+
+        std::vector<harq_pkt> &bucket = l0[cursor & L0_MASK];
+        for(size_t i = 0; i < bucket.size(); i++)
+        {
+            if(bucket[i].t_out <= current_t) ready.push_back(std::move(bucket[i]));
+            else late.push_back(std::move(bucket[i]));
+        }
+        l0_count -= bucket.size();
+        bucket.clear();
+
+        cursor++;
+        if((cursor & L0_MASK) == 0) cascade();
+    }
+
+    // Rounding left a few packets a hair behind current_t, keep them in the current bucket.
+    for(size_t i = 0; i < late.size(); i++) place(std::move(late[i]));
+}
+
+// Moves the due packets of bucket to the ready list, keeping the rest in place.
+void release_wheel::collect(std::vector<harq_pkt>& bucket, float current_t)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < bucket.size(); i++)
+    {
+        if(bucket[i].t_out <= current_t) ready.push_back(std::move(bucket[i]));
+        else
+        {
+            if(kept != i) bucket[kept] = std::move(bucket[i]);
+            kept++;
+        }
+    }
+    l0_count -= bucket.size() - kept;
+    bucket.resize(kept);
+}
+
+// Called when the cursor enters a new round: refills level 0 from level 1 and, at the start of a
+// new cycle, redistributes the overflow list first.
+void release_wheel::cascade()
+{
+    if(((cursor >> RELEASE_WHEEL_L0_BITS) & L1_MASK) == 0 && !overflow.empty())
+    {
+        std::vector<harq_pkt> pending;
+        pending.swap(overflow);
+        for(size_t i = 0; i < pending.size(); i++) place(std::move(pending[i]));
+    }
+
+    std::vector<harq_pkt> &bucket = l1[(cursor >> RELEASE_WHEEL_L0_BITS) & L1_MASK];
+    if(bucket.empty()) return;
+
+    std::vector<harq_pkt> pending;
+    pending.swap(bucket);
+    l1_count -= pending.size();
+    for(size_t i = 0; i < pending.size(); i++) place(std::move(pending[i]));
+}
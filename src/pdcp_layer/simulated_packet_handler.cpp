@@ -4,13 +4,15 @@
 * SPDX-License-Identifier: BSD-3-Clause-Clear
 **********************************************/
 
+#include <algorithm>
 #include <cmath>
 
 #include <pdcp_layer/simulated_packet_handler.h>
 
-simulated_packet_handler::simulated_packet_handler(int ue_id, traffic_config traffic_c, pdcp_config pdcp_c, int verbosity)
+simulated_packet_handler::simulated_packet_handler(int ue_id, traffic_config traffic_c, pdcp_config pdcp_c, int verbosity, bool _fluid_pkts)
     : packet_handler(pdcp_c, verbosity),
-      traffic_m(new traffic_model(ue_id, traffic_c))
+      traffic_m(new traffic_model(ue_id, traffic_c)),
+      fluid_pkts(_fluid_pkts)
 {
 }
 
@@ -21,6 +23,15 @@ float simulated_packet_handler::ingest(int tx_dir, float current_t)
 
     float pkt_size = traffic_m->get_pkt_size(tx_dir);
     int pkts = (int)ceil(bits / pkt_size);
+    if(fluid_pkts)
+    {
+        ip_pkt burst(current_t, bits, bits, current_id, bh_d, bh_d_var);
+        burst.pkt_count = (uint32_t)pkts;
+        push_ingress_pkt(std::move(burst));
+        current_id++;
+        return bits;
+    }
+
     for(int i = 0; i < pkts - 1; i++)
     {
         push_ingress_pkt(ip_pkt(current_t, pkt_size, pkt_size, current_id, bh_d, bh_d_var));
@@ -36,6 +47,11 @@ float simulated_packet_handler::ingest(int tx_dir, float current_t)
     return bits;
 }
 
+void simulated_packet_handler::drop_ingress_pkt(ip_pkt pkt)
+{
+    verdict(pkt, final_packet_verdict::DROP);
+}
+
 void simulated_packet_handler::drop(harq_pkt pkt)
 {
     for(std::deque<ip_pkt>::const_iterator it = pkt.pkts.begin(); it != pkt.pkts.end(); ++it)
@@ -50,21 +66,17 @@ float simulated_packet_handler::release()
     float bits = 0.0f;
     float latency = 0.0f;
     float ip_latency = 0.0f;
-    for(std::deque<harq_pkt>::iterator it = pkt_list.begin(); it != pkt_list.end();)
+    harq_pkt pkt;
+    while(pkt_list.pop_due(current_t, pkt))
     {
-        if(it->t_out <= current_t)
+        bits += pkt.bits;
+        latency += current_t - pkt.current_t;
+        ip_latency += current_t - pkt.ip_t;
+        count++;
+        for(std::deque<ip_pkt>::const_iterator pkt_it = pkt.pkts.begin(); pkt_it != pkt.pkts.end(); ++pkt_it)
         {
-            bits += it->bits;
-            latency += current_t - it->current_t;
-            ip_latency += current_t - it->ip_t;
-            count++;
-            for(std::deque<ip_pkt>::const_iterator pkt_it = it->pkts.begin(); pkt_it != it->pkts.end(); ++pkt_it)
-            {
-                update_pending_packet(*pkt_it, false);
-            }
-            it = pkt_list.erase(it);
+            update_pending_packet(*pkt_it, false);
         }
-        else it++;
     }
     if(count > 0)
     {
@@ -79,17 +91,63 @@ float simulated_packet_handler::release()
 
 void simulated_packet_handler::update_pending_packet(const ip_pkt& pkt, bool dropped)
 {
-    pending_packet_result& state = pending_results[pkt.uid];
+    pending_packet_result *found = pending_results.find(pkt.uid);
+    pending_packet_result& state = found != nullptr ? *found : pending_results.insert(pkt.uid, pending_packet_result());
     if(state.original_size <= 0.0f) state.original_size = pkt.original_size;
     state.accounted_bits += pkt.size;
-    state.dropped = state.dropped || dropped;
+    if(dropped)
+    {
+        // Every packet the lost fragment starts, ends or lies in is lost. The packets of a burst
+        // are assumed to be of equal size.
+        const uint32_t count = pkt.pkt_count > 0 ? pkt.pkt_count : 1;
+        const float pkt_bits = state.original_size / count;
+        uint32_t first = (uint32_t)floorf((pkt.offset + BIT_ROUND_MARGIN) / pkt_bits);
+        uint32_t last = (uint32_t)std::max(0.0f, ceilf((pkt.offset + pkt.size - BIT_ROUND_MARGIN) / pkt_bits) - 1.0f);
+        if(last >= count) last = count - 1;
+        if(first > last) first = last;
+        add_lost_range(state, first, last);
+    }
     state.congestion_signal = state.congestion_signal || pkt.ce_marked;
 
     if(state.original_size > 0.0f && state.accounted_bits + BIT_ROUND_MARGIN >= state.original_size)
     {
-        if(state.dropped) verdict(pkt, final_packet_verdict::DROP);
-        else if(state.congestion_signal) verdict(pkt, final_packet_verdict::ACCEPT_CE);
-        else verdict(pkt, final_packet_verdict::ACCEPT);
+        uint32_t drop_count = std::min(lost_count(state), pkt.pkt_count);
+        const final_packet_verdict delivered = state.congestion_signal ? final_packet_verdict::ACCEPT_CE : final_packet_verdict::ACCEPT;
+        if(drop_count == 0) verdict(pkt, delivered);
+        else if(drop_count == pkt.pkt_count) verdict(pkt, final_packet_verdict::DROP);
+        else
+        {
+            // Part of a fluid burst was lost: split the verdict between its packets
+            ip_pkt part(pkt);
+            part.pkt_count = drop_count;
+            verdict(part, final_packet_verdict::DROP);
+            part.pkt_count = pkt.pkt_count - drop_count;
+            verdict(part, delivered);
+        }
         pending_results.erase(pkt.uid);
     }
 }
+
+// Adds [first, last] to the lost ranges of state, merging it with the ranges it overlaps or touches.
+void simulated_packet_handler::add_lost_range(pending_packet_result& state, uint32_t first, uint32_t last)
+{
+    std::vector<std::pair<uint32_t, uint32_t>>& lost = state.lost;
+    size_t i = 0;
+    while(i < lost.size() && lost[i].second + 1 < first) i++;
+    size_t j = i;
+    while(j < lost.size() && lost[j].first <= last + 1)
+    {
+        first = std::min(first, lost[j].first);
+        last = std::max(last, lost[j].second);
+        j++;
+    }
+    lost.erase(lost.begin() + i, lost.begin() + j);
+    lost.insert(lost.begin() + i, std::make_pair(first, last));
+}
+
+uint32_t simulated_packet_handler::lost_count(const pending_packet_result& state)
+{
+    uint32_t count = 0;
+    for(size_t i = 0; i < state.lost.size(); i++) count += state.lost[i].second - state.lost[i].first + 1;
+    return count;
+}
@@ -123,11 +123,56 @@ void configuration_loader::load(std::string cfg_file)
                                 ue_c_list.back().n_ues = std::stoi(value);
                             if (key == "ue_type")
                                 ue_c_list.back().ue_type = std::stoi(value);
-                            // QUEUE_NUM
+                            // QUEUE_NUM, either a queue or a first:last range matching --queue-balance
                             if (key == "ul_queue_n")
-                                ue_c_list.back().ue_c.ul_queue_n = std::stoi(value);
+                            {
+                                ue_config &c = ue_c_list.back().ue_c;
+                                c.ul_queue_n = std::stoi(value);
+                                size_t sep = value.find(':');
+                                c.ul_queue_count = sep == std::string::npos ? 1 : std::max(1, std::stoi(value.substr(sep + 1)) - c.ul_queue_n + 1);
+                            }
                             if (key == "dl_queue_n")
-                                ue_c_list.back().ue_c.dl_queue_n = std::stoi(value);
+                            {
+                                ue_config &c = ue_c_list.back().ue_c;
+                                c.dl_queue_n = std::stoi(value);
+                                size_t sep = value.find(':');
+                                c.dl_queue_count = sep == std::string::npos ? 1 : std::max(1, std::stoi(value.substr(sep + 1)) - c.dl_queue_n + 1);
+                            }
+                            if (key == "capture_backend")
+                            {
+                                ue_config &c = ue_c_list.back().ue_c;
+                                if (value == "nfqueue")
+                                    c.ul_capture_c.backend = c.dl_capture_c.backend = capture_backend::NFQUEUE;
+                                else if (value == "packet_mmap")
+                                    c.ul_capture_c.backend = c.dl_capture_c.backend = capture_backend::PACKET_MMAP;
+                                else if (value == "synthetic")
+                                    c.ul_capture_c.backend = c.dl_capture_c.backend = capture_backend::SYNTHETIC;
+                                else
+                                    LOG_ERROR_I("configuration_loader::load") << "Unknown capture_backend " << value << END();
+                            }
+                            if (key == "ul_if_in")
+                                ue_c_list.back().ue_c.ul_capture_c.if_in = value;
+                            if (key == "ul_if_out")
+                                ue_c_list.back().ue_c.ul_capture_c.if_out = value;
+                            if (key == "dl_if_in")
+                                ue_c_list.back().ue_c.dl_capture_c.if_in = value;
+                            if (key == "dl_if_out")
+                                ue_c_list.back().ue_c.dl_capture_c.if_out = value;
+                            if (key == "ul_trace")
+                                ue_c_list.back().ue_c.ul_capture_c.trace = value;
+                            if (key == "dl_trace")
+                                ue_c_list.back().ue_c.dl_capture_c.trace = value;
+                            if (key == "synthetic_speed")
+                                ue_c_list.back().ue_c.ul_capture_c.speed = ue_c_list.back().ue_c.dl_capture_c.speed = std::stof(value);
+                            if (key == "synthetic_ecn")
+                                ue_c_list.back().ue_c.ul_capture_c.ecn = ue_c_list.back().ue_c.dl_capture_c.ecn = std::stoi(value);
+                            if (key == "synthetic_loop")
+                            {
+                                if (value == "true" || value == "1")
+                                    ue_c_list.back().ue_c.ul_capture_c.loop = ue_c_list.back().ue_c.dl_capture_c.loop = true;
+                                if (value == "false" || value == "0")
+                                    ue_c_list.back().ue_c.ul_capture_c.loop = ue_c_list.back().ue_c.dl_capture_c.loop = false;
+                            }
                             // UE CONFIG
                             if (key == "n_antennas")
                                 ue_c_list.back().ue_c.ue_m.n_antennas = std::stoi(value);
@@ -202,6 +247,13 @@ void configuration_loader::load(std::string cfg_file)
                                 ue_c_list.back().ue_c.beta_metric = std::stof(value);
                             if (key == "pkt_delay_budget")
                                 ue_c_list.back().ue_c.pkt_delay_budget = std::stof(value);
+                            if (key == "fluid_pkts")
+                            {
+                                if (value == "true" || value == "1")
+                                    ue_c_list.back().ue_c.fluid_pkts = true;
+                                if (value == "false" || value == "0")
+                                    ue_c_list.back().ue_c.fluid_pkts = false;
+                            }
                             if (key == "l4s_dual_queue")
                             {
                                 if (value == "true" || value == "1")
@@ -279,6 +331,14 @@ void configuration_loader::load(std::string cfg_file)
 
                                 if (key == "threads")
                                     threads = std::stoi(value);
+                                if (key == "log_queue_bytes")
+                                    log_writer_c.queue_bytes = std::stoi(value);
+                                if (key == "log_buffer_bytes")
+                                    log_writer_c.buffer_bytes = std::stoi(value);
+                                if (key == "log_flush_ms")
+                                    log_writer_c.flush_ms = std::stoi(value);
+                                if (key == "health_socket")
+                                    health_socket = value;
                                 if (key == "verbose")
                                 {
                                     if (value == "true" || value == "1")
@@ -445,6 +505,14 @@ void configuration_loader::load(std::string cfg_file)
                                     if (value == "true" || value == "1") monitoring_c.emit_runtime_debug_logs = true;
                                     if (value == "false" || value == "0") monitoring_c.emit_runtime_debug_logs = false;
                                 }
+                                if (key == "sample_slots_ue_phy") monitoring_c.sample_slots_ue_phy = std::stoi(value);
+                                if (key == "sample_slots_ue_pdcp") monitoring_c.sample_slots_ue_pdcp = std::stoi(value);
+                                if (key == "sample_slots_ue_queue") monitoring_c.sample_slots_ue_queue = std::stoi(value);
+                                if (key == "sample_slots_ue_mobility") monitoring_c.sample_slots_ue_mobility = std::stoi(value);
+                                if (key == "sample_slots_l4s") monitoring_c.sample_slots_l4s = std::stoi(value);
+                                if (key == "sample_slots_mac_scheduler") monitoring_c.sample_slots_mac_scheduler = std::stoi(value);
+                                if (key == "udp_payload_bytes") monitoring_c.udp_payload_bytes = std::stoi(value);
+                                if (key == "tcp_buffer_bytes") monitoring_c.tcp_buffer_bytes = std::stoi(value);
                                 if (key == "emit_text_logs_compat")
                                 {
                                     if (value == "true" || value == "1") monitoring_c.emit_text_logs_compat = true;
@@ -504,6 +572,50 @@ void configuration_loader::load(std::string cfg_file)
                                     }
                                 }
                             }
+                            if (mode == "Recorder")
+                            {
+                                if (key == "enabled")
+                                {
+                                    if (value == "true" || value == "1") recorder_c.enabled = true;
+                                    if (value == "false" || value == "0") recorder_c.enabled = false;
+                                }
+                                if (key == "path") recorder_c.path = value;
+                                if (key == "compression") recorder_c.compression = value;
+                                if (key == "chunk_rows") recorder_c.chunk_rows = std::stoi(value);
+                            }
+                            if (mode == "NFQueue")
+                            {
+                                if (key == "busy_poll_us")
+                                    nfqueue_c.busy_poll_us = std::stoi(value);
+                                if (key == "recv_batch")
+                                    nfqueue_c.recv_batch = std::stoi(value);
+                                if (key == "rcvbuf_bytes")
+                                    nfqueue_c.rcvbuf_bytes = std::stoi(value);
+                                if (key == "no_enobufs")
+                                {
+                                    if (value == "true" || value == "1")
+                                        nfqueue_c.no_enobufs = true;
+                                    if (value == "false" || value == "0")
+                                        nfqueue_c.no_enobufs = false;
+                                }
+                                if (key == "copy_range")
+                                    nfqueue_c.copy_range = std::stoi(value);
+                                if (key == "ce_mark")
+                                    nfqueue_c.ce_mark = (uint32_t)std::stoul(value, nullptr, 0);
+                                if (key == "receive_threads")
+                                    nfqueue_c.receive_threads = std::stoi(value);
+                                if (key == "capture_ring")
+                                    nfqueue_c.capture_ring = std::stoi(value);
+                                if (key == "gso")
+                                {
+                                    if (value == "true" || value == "1")
+                                        nfqueue_c.gso = true;
+                                    if (value == "false" || value == "0")
+                                        nfqueue_c.gso = false;
+                                }
+                                if (key == "gso_mss")
+                                    nfqueue_c.gso_mss = std::stoi(value);
+                            }
                             if (mode == "PHYLayer")
                             {
                                 // NOISE INTERFERENCE
@@ -738,3 +850,23 @@ monitoring_config configuration_loader::get_monitoring_config()
 {
     return monitoring_c;
 }
+
+nfqueue_config configuration_loader::get_nfqueue_config()
+{
+    return nfqueue_c;
+}
+
+recorder_config configuration_loader::get_recorder_config()
+{
+    return recorder_c;
+}
+
+log_writer_config configuration_loader::get_log_writer_config()
+{
+    return log_writer_c;
+}
+
+std::string configuration_loader::get_health_socket()
+{
+    return health_socket;
+}
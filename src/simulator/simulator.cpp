@@ -1,5 +1,9 @@
+#include <netfilter/netfilter_interface.h>
 #include <simulator/simulator.h>
 #include <utils/monitoring/monitoring_manager.h>
+#include <utils/logging/binary_recorder.h>
+#include <utils/logging/log_writer.h>
+#include <utils/monitoring/health_endpoint.h>
 
 namespace
 {
@@ -18,6 +22,7 @@ simulator::simulator(std::string config_file)
       mac_l(config_loader.get_threading(), ue_h.get_ue_list(), config_loader.get_mac_config(), config_loader.get_tdd_config(), config_loader.get_log_config()),
       ticker(config_loader.get_period(), config_loader.get_duration())
 {
+    log_writer::instance().configure(config_loader.get_log_writer_config());
     verbosity = config_loader.get_log_config().verbosity;
     duration = config_loader.get_duration();
     progress_log_period_s = config_loader.get_progress_log_period_s();
@@ -25,6 +30,21 @@ simulator::simulator(std::string config_file)
         next_progress_log_sim_time_s = progress_log_period_s;
     // initialize monitoring manager if configured
     monitoring_manager::instance().init(config_loader.get_monitoring_config());
+    mac_l.register_monitoring();
+    // the recorder has to be open before the UEs are built, they take their streams from it
+    recorder_config recorder_c = config_loader.get_recorder_config();
+    if(recorder_c.enabled)
+    {
+        if(recorder_c.path.empty())
+            recorder_c.path = "logs/" + config_loader.get_log_config().log_id + "/ue/ue_record.bin";
+        binary_recorder::instance().open(recorder_c);
+    }
+    // same for the health endpoint and the UE counters
+    const std::string health_socket = config_loader.get_health_socket();
+    if(!health_socket.empty())
+        health_endpoint::instance().open(health_socket, config_loader.get_period() > 0);
+    nfqueue_config nfqueue_c = config_loader.get_nfqueue_config();
+    netfilter_interface_configure(&nfqueue_c);
     std::list<ue_full_config> ue_c_list = config_loader.get_ue_c_list();
     phy_enb_config phy_c = config_loader.get_phy_enb_config();
     phy_c.n_rbgs = mac_l.get_n_freq_rbg();
@@ -54,15 +74,31 @@ void simulator::start()
 void simulator::join()
 {
     ticker.wait_finished();
+    stop_monitoring();
+    health_endpoint::instance().close();
+    binary_recorder::instance().close();
+    log_writer::instance().stop();
     log_runtime_stop("completed");
 }
 
 void simulator::terminate()
 {
     ticker.stop();
+    stop_monitoring();
+    health_endpoint::instance().close();
+    binary_recorder::instance().close();
+    log_writer::instance().stop();
     log_runtime_stop("terminated");
 }
 
+// Hands over the metric windows left open by the last slots and flushes them with the aggregator.
+void simulator::stop_monitoring()
+{
+    ue_h.flush_monitoring();
+    mac_l.flush_monitoring();
+    monitoring_manager::instance().stop();
+}
+
 void simulator::print_traffic()
 {
     ue_h.print_traffic();
@@ -194,6 +230,16 @@ void simulator::step(unsigned int _ts)
     time_ue += ue_step_time;
     progress_time_ue += ue_step_time;
     progress_steps++;
+    health_endpoint &health = health_endpoint::instance();
+    if(health.is_open())
+    {
+        // The ticker knows when it meant this slot to start: a fixed grid for finite runs, one
+        // period after the previous wake up for infinite ones, where drift would otherwise add up
+        const std::int64_t lateness_us = (std::int64_t)_ts - (std::int64_t)ticker.get_due_ts();
+        health.slot_done(ts, lateness_us,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(mac_step_time).count(),
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(ue_step_time).count());
+    }
     monitoring.clear_slot_timestamp_ns();
     handle_time_log(ts);
     maybe_log_progress(ts);
@@ -35,12 +35,118 @@ std::string escape_influx_string_field(const std::string &value)
     return out;
 }
 
-metric_field make_metric_field(double value, field_aggregation aggregation)
-{
-    metric_field field;
-    field.value = value;
-    field.aggregation = aggregation;
-    return field;
+// Field lists of the UE measurements, visited by metric_schema at registration and by the series'
+// metric_window on every sampled slot.
+template<typename F>
+void mobility_fields(F &f, double x, double y, double distance_m)
+{
+    f("x", field_aggregation::last, x);
+    f("y", field_aggregation::last, y);
+    f("distance_m", field_aggregation::last, distance_m);
+}
+
+template<typename F>
+void pdcp_fields(F &f, double throughput, double generated, double generated_packets, double error,
+                 double latency, double ip_latency)
+{
+    f("throughput_mbps_mean", field_aggregation::mean, throughput);
+    f("generated_mbps_sum", field_aggregation::sum, generated);
+    f("generated_packets_sum", field_aggregation::sum, generated_packets);
+    f("error_mbps_sum", field_aggregation::sum, error);
+    f("latency_s_mean", field_aggregation::mean, latency);
+    f("ip_latency_s_mean", field_aggregation::mean, ip_latency);
+}
+
+template<typename F>
+void l4s_fields(F &f, double generated_packets, const pdcp_queue_status &status, const dualpi2_stats &interval)
+{
+    f("generated_packets_sum", field_aggregation::sum, generated_packets);
+    f("ce_packets_sum", field_aggregation::sum, interval.ce_packets);
+    f("ce_bits_sum", field_aggregation::sum, interval.ce_bits);
+    f("aqm_drops_sum", field_aggregation::sum, interval.aqm_drops);
+    f("aqm_drop_bits_sum", field_aggregation::sum, interval.aqm_drop_bits);
+    f("l4s_queue_packets_last", field_aggregation::last, status.l4s_queue_size);
+    f("classic_queue_packets_last", field_aggregation::last, status.classic_queue_size);
+    f("l4s_queue_bits_last", field_aggregation::last, status.l4s_queue_bits);
+    f("classic_queue_bits_last", field_aggregation::last, status.classic_queue_bits);
+    f("p_l_mean", field_aggregation::mean, status.dualpi2_p_l);
+    f("p_c_mean", field_aggregation::mean, status.dualpi2_p_c);
+    f("p_cl_mean", field_aggregation::mean, status.dualpi2_p_cl);
+    f("nfqueue_queue_num_last", field_aggregation::last, status.nfqueue_queue_num);
+    f("nfqueue_ce_rewrite_packets_last", field_aggregation::last, status.nfqueue_ce_rewrite_packets);
+    f("nfqueue_drop_packets_last", field_aggregation::last, status.nfqueue_drop_packets);
+    f("nfqueue_total_recv_last", field_aggregation::last, status.nfqueue_total_recv);
+    f("nfqueue_total_rlsd_last", field_aggregation::last, status.nfqueue_total_rlsd);
+    f("nfqueue_bytes_recv_last", field_aggregation::last, status.nfqueue_bytes_recv);
+    f("nfqueue_recv_fails_last", field_aggregation::last, status.nfqueue_recv_fails);
+    f("nfqueue_kernel_drops_last", field_aggregation::last, status.nfqueue_kernel_drops);
+    f("nfqueue_overflow_drops_last", field_aggregation::last, status.nfqueue_overflow_drops);
+    f("nfqueue_gso_pkts_last", field_aggregation::last, status.nfqueue_gso_pkts);
+    f("nfqueue_parse_fails_last", field_aggregation::last, status.nfqueue_parse_fails);
+    f("nfqueue_rlsd_fails_last", field_aggregation::last, status.nfqueue_rlsd_fails);
+    f("nfqueue_rlsd_batches_last", field_aggregation::last, status.nfqueue_rlsd_batches);
+    f("final_accept_packets_sum", field_aggregation::sum, status.final_accept_packets);
+    f("final_accept_ce_packets_sum", field_aggregation::sum, status.final_accept_ce_packets);
+    f("final_drop_packets_sum", field_aggregation::sum, status.final_drop_packets);
+}
+
+template<typename F>
+void queue_fields(F &f, double generated_packets, bool using_l4s, const pdcp_queue_status &status,
+                  const dualpi2_stats &interval)
+{
+    f("generated_packets_sum", field_aggregation::sum, generated_packets);
+    f("using_l4s_last", field_aggregation::last, using_l4s ? 1 : 0);
+    f("pkt_delay_budget_s_last", field_aggregation::last, status.pkt_delay_budget_s);
+    f("ip_buffer_packets_last", field_aggregation::last, status.ip_buffer_size);
+    f("capture_packets_last", field_aggregation::last, status.capture_size);
+    f("release_packets_last", field_aggregation::last, status.release_size);
+    f("harq_packets_last", field_aggregation::last, status.harq_size);
+    f("ip_oldest_age_s_last", field_aggregation::last, status.ip_oldest_age);
+    f("capture_oldest_age_s_last", field_aggregation::last, status.capture_oldest_age);
+    f("capture_delay_sum_s_last", field_aggregation::last, status.capture_delay_sum_s);
+    f("capture_delay_packets_last", field_aggregation::last, status.capture_delay_packets);
+    f("capture_delay_max_s_last", field_aggregation::last, status.capture_delay_max_s);
+    f("capture_clock_mismatches_last", field_aggregation::last, status.capture_clock_mismatches);
+    f("release_oldest_age_s_last", field_aggregation::last, status.release_oldest_age);
+    f("harq_oldest_age_s_last", field_aggregation::last, status.harq_oldest_age);
+    f("nfqueue_queue_num_last", field_aggregation::last, status.nfqueue_queue_num);
+    f("nfqueue_ce_rewrite_packets_last", field_aggregation::last, status.nfqueue_ce_rewrite_packets);
+    f("nfqueue_drop_packets_last", field_aggregation::last, status.nfqueue_drop_packets);
+    f("nfqueue_total_recv_last", field_aggregation::last, status.nfqueue_total_recv);
+    f("nfqueue_total_rlsd_last", field_aggregation::last, status.nfqueue_total_rlsd);
+    f("nfqueue_bytes_recv_last", field_aggregation::last, status.nfqueue_bytes_recv);
+    f("nfqueue_recv_fails_last", field_aggregation::last, status.nfqueue_recv_fails);
+    f("nfqueue_kernel_drops_last", field_aggregation::last, status.nfqueue_kernel_drops);
+    f("nfqueue_overflow_drops_last", field_aggregation::last, status.nfqueue_overflow_drops);
+    f("nfqueue_gso_pkts_last", field_aggregation::last, status.nfqueue_gso_pkts);
+    f("nfqueue_parse_fails_last", field_aggregation::last, status.nfqueue_parse_fails);
+    f("nfqueue_rlsd_fails_last", field_aggregation::last, status.nfqueue_rlsd_fails);
+    f("nfqueue_rlsd_batches_last", field_aggregation::last, status.nfqueue_rlsd_batches);
+    f("final_accept_packets_sum", field_aggregation::sum, status.final_accept_packets);
+    f("final_accept_ce_packets_sum", field_aggregation::sum, status.final_accept_ce_packets);
+    f("final_drop_packets_sum", field_aggregation::sum, status.final_drop_packets);
+    f("ce_packets_sum", field_aggregation::sum, interval.ce_packets);
+    f("ce_bits_sum", field_aggregation::sum, interval.ce_bits);
+    f("aqm_drops_sum", field_aggregation::sum, interval.aqm_drops);
+    f("aqm_drop_bits_sum", field_aggregation::sum, interval.aqm_drop_bits);
+    f("l4s_queue_packets_last", field_aggregation::last, status.l4s_queue_size);
+    f("classic_queue_packets_last", field_aggregation::last, status.classic_queue_size);
+    f("l4s_queue_bits_last", field_aggregation::last, status.l4s_queue_bits);
+    f("classic_queue_bits_last", field_aggregation::last, status.classic_queue_bits);
+    f("p_l_mean", field_aggregation::mean, status.dualpi2_p_l);
+    f("p_c_mean", field_aggregation::mean, status.dualpi2_p_c);
+    f("p_cl_mean", field_aggregation::mean, status.dualpi2_p_cl);
+}
+
+template<typename F>
+void phy_fields(F &f, double sinr, double rsrp, double cqi, double mcs, double eff, double ri)
+{
+    f("sinr_db_mean", field_aggregation::mean, sinr);
+    f("rsrp_db_mean", field_aggregation::mean, rsrp);
+    f("cqi_mean", field_aggregation::mean, cqi);
+    f("mcs_mean", field_aggregation::mean, mcs);
+    f("eff_mean", field_aggregation::mean, eff);
+    f("ri_mean", field_aggregation::mean, ri);
 }
 
 std::string make_text_log_line(int ue_id, const std::string &line)
@@ -63,18 +169,23 @@ std::string tx_dir_tag(int tx_dir)
 packet_handler_config make_pdcp_packet_config(int ue_type,
                                               int tx_dir,
                                               int queue_num,
+                                              int queue_count,
+                                              capture_config capture_c,
                                               int ue_id,
                                               std::chrono::microseconds *init_t,
                                               traffic_config traffic_c,
                                               pdcp_config pdcp_c,
                                               dualpi2_config l4s_c,
                                               bool log_traffic,
-                                              bool log_quality)
+                                              bool log_quality,
+                                              bool fluid_pkts)
 {
     packet_handler_config cfg;
     cfg.ue_type = ue_type;
     cfg.tx_dir = tx_dir;
     cfg.queue_num = queue_num;
+    cfg.queue_count = queue_count;
+    cfg.capture_c = capture_c;
     cfg.ue_id = ue_id;
     cfg.init_t = init_t;
     cfg.traffic_c = traffic_c;
@@ -82,6 +193,7 @@ packet_handler_config make_pdcp_packet_config(int ue_type,
     cfg.l4s_c = l4s_c;
     cfg.log_traffic = log_traffic;
     cfg.log_quality = log_quality;
+    cfg.fluid_pkts = fluid_pkts;
     return cfg;
 }
 }
@@ -97,8 +209,8 @@ ue::ue(int _id,
        std::chrono::microseconds *init_t,
        bool _stochastics)
      :  map(_scenario_c.map_file),
-        pdcp_dl(make_pdcp_packet_config(ue_type, TX_DL, ue_c.dl_queue_n, _id, init_t, ue_c.traffic_c, _pdcp_config_dl, ue_c.l4s_c, ue_c.log_traffic, ue_c.log_quality), ue_c.log_traffic || ue_c.log_quality || (monitoring_manager::instance().is_enabled() && (monitoring_manager::instance().get_config().emit_ue_pdcp || monitoring_manager::instance().get_config().emit_l4s))),
-        pdcp_ul(make_pdcp_packet_config(ue_type, TX_UL, ue_c.ul_queue_n, _id, init_t, ue_c.traffic_c, _pdcp_config_ul, ue_c.l4s_c, ue_c.log_traffic, ue_c.log_quality), ue_c.log_traffic || ue_c.log_quality || (monitoring_manager::instance().is_enabled() && (monitoring_manager::instance().get_config().emit_ue_pdcp || monitoring_manager::instance().get_config().emit_l4s))),
+        pdcp_dl(make_pdcp_packet_config(ue_type, TX_DL, ue_c.dl_queue_n, ue_c.dl_queue_count, ue_c.dl_capture_c, _id, init_t, ue_c.traffic_c, _pdcp_config_dl, ue_c.l4s_c, ue_c.log_traffic, ue_c.log_quality, ue_c.fluid_pkts), ue_c.log_traffic || ue_c.log_quality || (monitoring_manager::instance().is_enabled() && (monitoring_manager::instance().get_config().emit_ue_pdcp || monitoring_manager::instance().get_config().emit_l4s)) || binary_recorder::instance().is_open()),
+        pdcp_ul(make_pdcp_packet_config(ue_type, TX_UL, ue_c.ul_queue_n, ue_c.ul_queue_count, ue_c.ul_capture_c, _id, init_t, ue_c.traffic_c, _pdcp_config_ul, ue_c.l4s_c, ue_c.log_traffic, ue_c.log_quality, ue_c.fluid_pkts), ue_c.log_traffic || ue_c.log_quality || (monitoring_manager::instance().is_enabled() && (monitoring_manager::instance().get_config().emit_ue_pdcp || monitoring_manager::instance().get_config().emit_l4s)) || binary_recorder::instance().is_open()),
         phy_dl(TX_DL, _id, _scenario_c, ue_c.get_phy_config(), _phy_enb_config, _stochastics, ue_c.log_quality || (monitoring_manager::instance().is_enabled() && monitoring_manager::instance().get_config().emit_ue_phy)),
         phy_ul(TX_UL, _id, _scenario_c, ue_c.get_phy_config(), _phy_enb_config, _stochastics, ue_c.log_quality || (monitoring_manager::instance().is_enabled() && monitoring_manager::instance().get_config().emit_ue_phy)),
         mobility_m(_id, ue_c.mobility_c, _scenario_c.type, map.getMaxApothem()),
@@ -136,6 +248,80 @@ ue::ue(int _id,
 void ue::init()
 {
     init_logger();
+    register_monitoring();
+    recorder = binary_recorder::instance().open_stream(id);
+    health = health_endpoint::instance().add_ue();
+}
+
+//--------------------------------------------------------------------------------------------------
+// register_monitoring(): registers the series this UE publishes, once, and sizes their local windows,
+// so that the emit_*_monitoring() functions only add samples to them. Windows of disabled
+// measurements keep id -1 and are never sampled.
+//--------------------------------------------------------------------------------------------------
+void ue::register_monitoring()
+{
+    monitoring_manager &monitoring = monitoring_manager::instance();
+    if(!monitoring.is_enabled()) return;
+    const monitoring_config &cfg = monitoring.get_config();
+    const std::string ue_id = std::to_string(id);
+
+    if(cfg.emit_ue_mobility)
+    {
+        metric_schema schema;
+        mobility_fields(schema, 0, 0, 0);
+        mobility_window.init(monitoring.register_series("ue_mobility", {{"ue_id", ue_id}}, schema.fields),
+                             schema.fields.size(), cfg.sample_slots_ue_mobility);
+    }
+
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        const std::map<std::string,std::string> tags = {{"ue_id", ue_id}, {"tx_dir", tx_dir_tag(tx_dir)}};
+        const bool using_l4s = pdcp(tx_dir).using_l4s();
+        if(cfg.emit_ue_pdcp)
+        {
+            metric_schema schema;
+            pdcp_fields(schema, 0, 0, 0, 0, 0, 0);
+            pdcp_window[tx_dir].init(monitoring.register_series("ue_pdcp", tags, schema.fields),
+                                     schema.fields.size(), cfg.sample_slots_ue_pdcp);
+        }
+        if(cfg.emit_ue_queue)
+        {
+            metric_schema schema;
+            queue_fields(schema, 0, using_l4s, pdcp_queue_status(), dualpi2_stats());
+            std::map<std::string,std::string> queue_tags = tags;
+            queue_tags["queue_mode"] = using_l4s ? "l4s" : "legacy";
+            queue_window[tx_dir].init(monitoring.register_series("ue_queue", queue_tags, schema.fields),
+                                      schema.fields.size(), cfg.sample_slots_ue_queue);
+        }
+        if(cfg.emit_l4s && using_l4s)
+        {
+            metric_schema schema;
+            l4s_fields(schema, 0, pdcp_queue_status(), dualpi2_stats());
+            l4s_window[tx_dir].init(monitoring.register_series("ue_l4s", tags, schema.fields),
+                                    schema.fields.size(), cfg.sample_slots_l4s);
+        }
+        if(cfg.emit_ue_phy)
+        {
+            metric_schema schema;
+            phy_fields(schema, 0, 0, 0, 0, 0, 0);
+            phy_window[tx_dir].init(monitoring.register_series("ue_phy", tags, schema.fields),
+                                    schema.fields.size(), cfg.sample_slots_ue_phy);
+        }
+    }
+}
+
+// flush_monitoring(): hands over the metric windows still open, before monitoring stops.
+void ue::flush_monitoring()
+{
+    monitoring_manager &monitoring = monitoring_manager::instance();
+    monitoring.hand_over(mobility_window);
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        monitoring.hand_over(pdcp_window[tx_dir]);
+        monitoring.hand_over(queue_window[tx_dir]);
+        monitoring.hand_over(l4s_window[tx_dir]);
+        monitoring.hand_over(phy_window[tx_dir]);
+    }
 }
 
 void ue::init_logger()
@@ -268,16 +454,9 @@ void ue::update_pos()
 
 void ue::emit_mobility_monitoring()
 {
-    monitoring_manager &monitoring = monitoring_manager::instance();
-    if(!monitoring.is_enabled() || !monitoring.get_config().emit_ue_mobility) return;
-
-    metric_point point;
-    point.measurement = "ue_mobility";
-    point.tags["ue_id"] = std::to_string(id);
-    point.fields["x"] = make_metric_field(mobility_m.x(), field_aggregation::last);
-    point.fields["y"] = make_metric_field(mobility_m.y(), field_aggregation::last);
-    point.fields["distance_m"] = make_metric_field(mobility_m.get_distance(), field_aggregation::last);
-    monitoring.publish(point);
+    if(!plan.mobility) return;
+    mobility_fields(mobility_window, mobility_m.x(), mobility_m.y(), mobility_m.get_distance());
+    monitoring_manager::instance().publish(mobility_window);
 }
 
 
@@ -310,20 +489,22 @@ void ue::update_pdcp()
     pdcp_ul.release();
     last_l4s_ul_interval_stats = pdcp_ul.get_l4s_interval_stats();
     last_l4s_dl_interval_stats = pdcp_dl.get_l4s_interval_stats();
-    if (log_traffic && ue_log.ready())
+    if (plan.text_traffic)
     {
-        ue_log.log_partial("rul:{} rdl:{} ", pdcp_ul.get_tp(true), pdcp_dl.get_tp(true));
-        ue_log.log_partial("lul:{} ldl:{} ", pdcp_ul.get_latency(true), pdcp_dl.get_latency(true));
-        ue_log.log_partial("ilul:{} ildl:{} ", pdcp_ul.get_ip_latency(true), pdcp_dl.get_ip_latency(true));
-        ue_log.log_partial("eul:{} edl:{} ", pdcp_ul.get_error(true), pdcp_dl.get_error(true));
+        const pdcp_slot_stats &ul = slot_pdcp_stats(TX_UL);
+        const pdcp_slot_stats &dl = slot_pdcp_stats(TX_DL);
+        ue_log.log_partial("rul:{} rdl:{} ", ul.tp, dl.tp);
+        ue_log.log_partial("lul:{} ldl:{} ", ul.latency, dl.latency);
+        ue_log.log_partial("ilul:{} ildl:{} ", ul.ip_latency, dl.ip_latency);
+        ue_log.log_partial("eul:{} edl:{} ", ul.error, dl.error);
         const dualpi2_stats &l4s_ul = last_l4s_ul_interval_stats;
         const dualpi2_stats &l4s_dl = last_l4s_dl_interval_stats;
         ue_log.log_partial("ceul:{} cedl:{} cebul:{} cebdl:{} ", l4s_ul.ce_packets, l4s_dl.ce_packets, l4s_ul.ce_bits, l4s_dl.ce_bits);
         ue_log.log_partial("aqmdul:{} aqmddl:{} aqmdbul:{} aqmdbdl:{} ", l4s_ul.aqm_drops, l4s_dl.aqm_drops, l4s_ul.aqm_drop_bits, l4s_dl.aqm_drop_bits);
         ue_log.log_partial("qlul:{} qldl:{} qcul:{} qcdl:{} ", l4s_ul.l4s_queue_size, l4s_dl.l4s_queue_size, l4s_ul.classic_queue_size, l4s_dl.classic_queue_size);
         ue_log.log_partial("plul:{} pldl:{} pcul:{} pcdl:{} pclul:{} pcldl:{} ", l4s_ul.p_l, l4s_dl.p_l, l4s_ul.p_c, l4s_dl.p_c, l4s_ul.p_cl, l4s_dl.p_cl);
-        pdcp_queue_status ul_status = pdcp_ul.get_queue_status();
-        pdcp_queue_status dl_status = pdcp_dl.get_queue_status();
+        const pdcp_queue_status &ul_status = slot_queue_status(TX_UL);
+        const pdcp_queue_status &dl_status = slot_queue_status(TX_DL);
         if(ul_status.nfqueue_queue_num >= 0 || dl_status.nfqueue_queue_num >= 0)
         {
             ue_log.log_partial(
@@ -341,147 +522,73 @@ void ue::update_pdcp()
     }
 }
 
-void ue::emit_pdcp_monitoring()
+const pdcp_slot_stats &ue::slot_pdcp_stats(int tx_dir)
 {
-    monitoring_manager &monitoring = monitoring_manager::instance();
-    if(!monitoring.is_enabled() || !monitoring.get_config().emit_ue_pdcp) return;
+    pdcp_slot_stats &stats = pdcp_slot[tx_dir];
+    if(!stats.read)
+    {
+        pdcp_layer &layer = pdcp(tx_dir);
+        stats.tp = layer.get_tp(true);
+        stats.generated = layer.get_generated(true);
+        stats.error = layer.get_error(true);
+        stats.latency = layer.get_latency(true);
+        stats.ip_latency = layer.get_ip_latency(true);
+        stats.read = true;
+    }
+    return stats;
+}
 
-    const auto ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
+const pdcp_queue_status &ue::slot_queue_status(int tx_dir)
+{
+    pdcp_slot_stats &stats = pdcp_slot[tx_dir];
+    if(!stats.queue_read)
+    {
+        stats.queue = pdcp(tx_dir).get_queue_status();
+        stats.queue_read = true;
+    }
+    return stats.queue;
+}
 
-    metric_point ul_point;
-    ul_point.measurement = "ue_pdcp";
-    ul_point.tags["ue_id"] = std::to_string(id);
-    ul_point.tags["tx_dir"] = tx_dir_tag(TX_UL);
-    ul_point.ts_ns = ts_ns;
-    ul_point.fields["throughput_mbps_mean"] = make_metric_field(pdcp_ul.get_tp(true), field_aggregation::mean);
-    ul_point.fields["generated_mbps_sum"] = make_metric_field(pdcp_ul.get_generated(true), field_aggregation::sum);
-    ul_point.fields["generated_packets_sum"] = make_metric_field(pdcp_ul.get_generated_packets(true), field_aggregation::sum);
-    ul_point.fields["error_mbps_sum"] = make_metric_field(pdcp_ul.get_error(true), field_aggregation::sum);
-    ul_point.fields["latency_s_mean"] = make_metric_field(pdcp_ul.get_latency(true), field_aggregation::mean);
-    ul_point.fields["ip_latency_s_mean"] = make_metric_field(pdcp_ul.get_ip_latency(true), field_aggregation::mean);
-    monitoring.publish(ul_point);
-
-    metric_point dl_point;
-    dl_point.measurement = "ue_pdcp";
-    dl_point.tags["ue_id"] = std::to_string(id);
-    dl_point.tags["tx_dir"] = tx_dir_tag(TX_DL);
-    dl_point.ts_ns = ts_ns;
-    dl_point.fields["throughput_mbps_mean"] = make_metric_field(pdcp_dl.get_tp(true), field_aggregation::mean);
-    dl_point.fields["generated_mbps_sum"] = make_metric_field(pdcp_dl.get_generated(true), field_aggregation::sum);
-    dl_point.fields["generated_packets_sum"] = make_metric_field(pdcp_dl.get_generated_packets(true), field_aggregation::sum);
-    dl_point.fields["error_mbps_sum"] = make_metric_field(pdcp_dl.get_error(true), field_aggregation::sum);
-    dl_point.fields["latency_s_mean"] = make_metric_field(pdcp_dl.get_latency(true), field_aggregation::mean);
-    dl_point.fields["ip_latency_s_mean"] = make_metric_field(pdcp_dl.get_ip_latency(true), field_aggregation::mean);
-    monitoring.publish(dl_point);
+void ue::emit_pdcp_monitoring()
+{
+    monitoring_manager &monitoring = monitoring_manager::instance();
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        metric_window &window = pdcp_window[tx_dir];
+        if(!plan.pdcp[tx_dir]) continue;
+        const pdcp_slot_stats &stats = slot_pdcp_stats(tx_dir);
+        pdcp_fields(window, stats.tp, stats.generated, pdcp(tx_dir).get_generated_packets(true),
+                    stats.error, stats.latency, stats.ip_latency);
+        monitoring.publish(window);
+    }
 }
 
 void ue::emit_l4s_monitoring()
 {
     monitoring_manager &monitoring = monitoring_manager::instance();
-    if(!monitoring.is_enabled() || !monitoring.get_config().emit_l4s) return;
-    if(!pdcp_ul.using_l4s() && !pdcp_dl.using_l4s()) return;
-
-    const auto ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-
-    auto publish_l4s = [&](pdcp_layer &layer, int tx_dir) {
-        if(!layer.using_l4s()) return;
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        metric_window &window = l4s_window[tx_dir];
+        if(!plan.l4s[tx_dir]) continue;
+        pdcp_layer &layer = pdcp(tx_dir);
         const dualpi2_stats &interval = (tx_dir == TX_UL) ? last_l4s_ul_interval_stats : last_l4s_dl_interval_stats;
-        pdcp_queue_status status = layer.get_queue_status();
-
-        metric_point point;
-        point.measurement = "ue_l4s";
-        point.tags["ue_id"] = std::to_string(id);
-        point.tags["tx_dir"] = tx_dir_tag(tx_dir);
-        point.ts_ns = ts_ns;
-        point.fields["generated_packets_sum"] = make_metric_field(layer.get_generated_packets(true), field_aggregation::sum);
-        point.fields["ce_packets_sum"] = make_metric_field(interval.ce_packets, field_aggregation::sum);
-        point.fields["ce_bits_sum"] = make_metric_field(interval.ce_bits, field_aggregation::sum);
-        point.fields["aqm_drops_sum"] = make_metric_field(interval.aqm_drops, field_aggregation::sum);
-        point.fields["aqm_drop_bits_sum"] = make_metric_field(interval.aqm_drop_bits, field_aggregation::sum);
-        point.fields["l4s_queue_packets_last"] = make_metric_field(status.l4s_queue_size, field_aggregation::last);
-        point.fields["classic_queue_packets_last"] = make_metric_field(status.classic_queue_size, field_aggregation::last);
-        point.fields["l4s_queue_bits_last"] = make_metric_field(status.l4s_queue_bits, field_aggregation::last);
-        point.fields["classic_queue_bits_last"] = make_metric_field(status.classic_queue_bits, field_aggregation::last);
-        point.fields["p_l_mean"] = make_metric_field(status.dualpi2_p_l, field_aggregation::mean);
-        point.fields["p_c_mean"] = make_metric_field(status.dualpi2_p_c, field_aggregation::mean);
-        point.fields["p_cl_mean"] = make_metric_field(status.dualpi2_p_cl, field_aggregation::mean);
-        point.fields["nfqueue_queue_num_last"] = make_metric_field(status.nfqueue_queue_num, field_aggregation::last);
-        point.fields["nfqueue_ce_rewrite_packets_last"] = make_metric_field(status.nfqueue_ce_rewrite_packets, field_aggregation::last);
-        point.fields["nfqueue_drop_packets_last"] = make_metric_field(status.nfqueue_drop_packets, field_aggregation::last);
-        point.fields["nfqueue_total_recv_last"] = make_metric_field(status.nfqueue_total_recv, field_aggregation::last);
-        point.fields["nfqueue_total_rlsd_last"] = make_metric_field(status.nfqueue_total_rlsd, field_aggregation::last);
-        point.fields["nfqueue_bytes_recv_last"] = make_metric_field(status.nfqueue_bytes_recv, field_aggregation::last);
-        point.fields["nfqueue_recv_fails_last"] = make_metric_field(status.nfqueue_recv_fails, field_aggregation::last);
-        point.fields["nfqueue_rlsd_fails_last"] = make_metric_field(status.nfqueue_rlsd_fails, field_aggregation::last);
-        point.fields["final_accept_packets_sum"] = make_metric_field(status.final_accept_packets, field_aggregation::sum);
-        point.fields["final_accept_ce_packets_sum"] = make_metric_field(status.final_accept_ce_packets, field_aggregation::sum);
-        point.fields["final_drop_packets_sum"] = make_metric_field(status.final_drop_packets, field_aggregation::sum);
-        monitoring.publish(point);
-    };
-
-    publish_l4s(pdcp_ul, TX_UL);
-    publish_l4s(pdcp_dl, TX_DL);
+        l4s_fields(window, layer.get_generated_packets(true), slot_queue_status(tx_dir), interval);
+        monitoring.publish(window);
+    }
 }
 
 void ue::emit_queue_monitoring()
 {
     monitoring_manager &monitoring = monitoring_manager::instance();
-    if(!monitoring.is_enabled() || !monitoring.get_config().emit_ue_queue) return;
-
-    const auto ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-
-    auto publish_queue = [&](pdcp_layer &layer, int tx_dir) {
-        const bool using_l4s = layer.using_l4s();
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        metric_window &window = queue_window[tx_dir];
+        if(!plan.queue[tx_dir]) continue;
+        pdcp_layer &layer = pdcp(tx_dir);
         const dualpi2_stats &interval = (tx_dir == TX_UL) ? last_l4s_ul_interval_stats : last_l4s_dl_interval_stats;
-        pdcp_queue_status status = layer.get_queue_status();
-
-        metric_point point;
-        point.measurement = "ue_queue";
-        point.tags["ue_id"] = std::to_string(id);
-        point.tags["tx_dir"] = tx_dir_tag(tx_dir);
-        point.tags["queue_mode"] = using_l4s ? "l4s" : "legacy";
-        point.ts_ns = ts_ns;
-        point.fields["generated_packets_sum"] = make_metric_field(layer.get_generated_packets(true), field_aggregation::sum);
-        point.fields["using_l4s_last"] = make_metric_field(using_l4s ? 1 : 0, field_aggregation::last);
-        point.fields["pkt_delay_budget_s_last"] = make_metric_field(status.pkt_delay_budget_s, field_aggregation::last);
-        point.fields["ip_buffer_packets_last"] = make_metric_field(status.ip_buffer_size, field_aggregation::last);
-        point.fields["capture_packets_last"] = make_metric_field(status.capture_size, field_aggregation::last);
-        point.fields["release_packets_last"] = make_metric_field(status.release_size, field_aggregation::last);
-        point.fields["harq_packets_last"] = make_metric_field(status.harq_size, field_aggregation::last);
-        point.fields["ip_oldest_age_s_last"] = make_metric_field(status.ip_oldest_age, field_aggregation::last);
-        point.fields["capture_oldest_age_s_last"] = make_metric_field(status.capture_oldest_age, field_aggregation::last);
-        point.fields["release_oldest_age_s_last"] = make_metric_field(status.release_oldest_age, field_aggregation::last);
-        point.fields["harq_oldest_age_s_last"] = make_metric_field(status.harq_oldest_age, field_aggregation::last);
-        point.fields["nfqueue_queue_num_last"] = make_metric_field(status.nfqueue_queue_num, field_aggregation::last);
-        point.fields["nfqueue_ce_rewrite_packets_last"] = make_metric_field(status.nfqueue_ce_rewrite_packets, field_aggregation::last);
-        point.fields["nfqueue_drop_packets_last"] = make_metric_field(status.nfqueue_drop_packets, field_aggregation::last);
-        point.fields["nfqueue_total_recv_last"] = make_metric_field(status.nfqueue_total_recv, field_aggregation::last);
-        point.fields["nfqueue_total_rlsd_last"] = make_metric_field(status.nfqueue_total_rlsd, field_aggregation::last);
-        point.fields["nfqueue_bytes_recv_last"] = make_metric_field(status.nfqueue_bytes_recv, field_aggregation::last);
-        point.fields["nfqueue_recv_fails_last"] = make_metric_field(status.nfqueue_recv_fails, field_aggregation::last);
-        point.fields["nfqueue_rlsd_fails_last"] = make_metric_field(status.nfqueue_rlsd_fails, field_aggregation::last);
-        point.fields["final_accept_packets_sum"] = make_metric_field(status.final_accept_packets, field_aggregation::sum);
-        point.fields["final_accept_ce_packets_sum"] = make_metric_field(status.final_accept_ce_packets, field_aggregation::sum);
-        point.fields["final_drop_packets_sum"] = make_metric_field(status.final_drop_packets, field_aggregation::sum);
-        point.fields["ce_packets_sum"] = make_metric_field(interval.ce_packets, field_aggregation::sum);
-        point.fields["ce_bits_sum"] = make_metric_field(interval.ce_bits, field_aggregation::sum);
-        point.fields["aqm_drops_sum"] = make_metric_field(interval.aqm_drops, field_aggregation::sum);
-        point.fields["aqm_drop_bits_sum"] = make_metric_field(interval.aqm_drop_bits, field_aggregation::sum);
-        point.fields["l4s_queue_packets_last"] = make_metric_field(status.l4s_queue_size, field_aggregation::last);
-        point.fields["classic_queue_packets_last"] = make_metric_field(status.classic_queue_size, field_aggregation::last);
-        point.fields["l4s_queue_bits_last"] = make_metric_field(status.l4s_queue_bits, field_aggregation::last);
-        point.fields["classic_queue_bits_last"] = make_metric_field(status.classic_queue_bits, field_aggregation::last);
-        point.fields["p_l_mean"] = make_metric_field(status.dualpi2_p_l, field_aggregation::mean);
-        point.fields["p_c_mean"] = make_metric_field(status.dualpi2_p_c, field_aggregation::mean);
-        point.fields["p_cl_mean"] = make_metric_field(status.dualpi2_p_cl, field_aggregation::mean);
-        monitoring.publish(point);
-    };
-
-    publish_queue(pdcp_ul, TX_UL);
-    publish_queue(pdcp_dl, TX_DL);
+        queue_fields(window, layer.get_generated_packets(true), layer.using_l4s(), slot_queue_status(tx_dir), interval);
+        monitoring.publish(window);
+    }
 }
 
 void ue::add_ts()
@@ -515,36 +622,15 @@ void ue::init_phy_update_rates(float _doppler_f, int _cqi_p, int _ri_p)
 void ue::emit_phy_monitoring()
 {
     monitoring_manager &monitoring = monitoring_manager::instance();
-    if(!monitoring.is_enabled() || !monitoring.get_config().emit_ue_phy) return;
-
-    const auto ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-
-    metric_point dl_point;
-    dl_point.measurement = "ue_phy";
-    dl_point.tags["ue_id"] = std::to_string(id);
-    dl_point.tags["tx_dir"] = tx_dir_tag(TX_DL);
-    dl_point.ts_ns = ts_ns;
-    dl_point.fields["sinr_db_mean"] = make_metric_field(phy_dl.get_mean_sinr(), field_aggregation::mean);
-    dl_point.fields["rsrp_db_mean"] = make_metric_field(phy_dl.get_mean_rsrp(), field_aggregation::mean);
-    dl_point.fields["cqi_mean"] = make_metric_field(phy_dl.get_mean_cqi(), field_aggregation::mean);
-    dl_point.fields["mcs_mean"] = make_metric_field(phy_dl.get_mean_mcs(), field_aggregation::mean);
-    dl_point.fields["eff_mean"] = make_metric_field(phy_dl.get_mean_eff(), field_aggregation::mean);
-    dl_point.fields["ri_mean"] = make_metric_field(phy_dl.get_ri(), field_aggregation::mean);
-    monitoring.publish(dl_point);
-
-    metric_point ul_point;
-    ul_point.measurement = "ue_phy";
-    ul_point.tags["ue_id"] = std::to_string(id);
-    ul_point.tags["tx_dir"] = tx_dir_tag(TX_UL);
-    ul_point.ts_ns = ts_ns;
-    ul_point.fields["sinr_db_mean"] = make_metric_field(phy_ul.get_mean_sinr(), field_aggregation::mean);
-    ul_point.fields["rsrp_db_mean"] = make_metric_field(phy_ul.get_mean_rsrp(), field_aggregation::mean);
-    ul_point.fields["cqi_mean"] = make_metric_field(phy_ul.get_mean_cqi(), field_aggregation::mean);
-    ul_point.fields["mcs_mean"] = make_metric_field(phy_ul.get_mean_mcs(), field_aggregation::mean);
-    ul_point.fields["eff_mean"] = make_metric_field(phy_ul.get_mean_eff(), field_aggregation::mean);
-    ul_point.fields["ri_mean"] = make_metric_field(phy_ul.get_ri(), field_aggregation::mean);
-    monitoring.publish(ul_point);
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        metric_window &window = phy_window[tx_dir];
+        if(!plan.phy[tx_dir]) continue;
+        phy_layer &layer = phy(tx_dir);
+        phy_fields(window, layer.get_mean_sinr(), layer.get_mean_rsrp(), layer.get_mean_cqi(), layer.get_mean_mcs(),
+                   layer.get_mean_eff(), layer.get_ri());
+        monitoring.publish(window);
+    }
 }
 
 void ue::estimate_channel_state()
@@ -583,14 +669,40 @@ void ue::estimate_channel_state()
     phy_period_counter++;
 }
 
+//--------------------------------------------------------------------------------------------------
+// plan_slot(): decides once per slot which consumers (text log, monitoring windows, recorder) take
+// data this slot and drops the previous slot's snapshots. The shared data is then gathered lazily,
+// at most once per slot, and only when one of them is due.
+//--------------------------------------------------------------------------------------------------
+void ue::plan_slot()
+{
+    plan.text_traffic = log_traffic && ue_log.ready();
+    plan.mobility = mobility_window.sample_due();
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        plan.pdcp[tx_dir] = pdcp_window[tx_dir].sample_due();
+        plan.queue[tx_dir] = queue_window[tx_dir].sample_due();
+        plan.l4s[tx_dir] = l4s_window[tx_dir].sample_due();
+        plan.phy[tx_dir] = phy_window[tx_dir].sample_due();
+        pdcp_slot[tx_dir].read = false;
+        pdcp_slot[tx_dir].queue_read = false;
+    }
+}
+
 void ue::step()
 {
+    // Phase boundaries for the health endpoint, only read when it is open
+    std::chrono::steady_clock::time_point t[6];
+    if (health) t[0] = std::chrono::steady_clock::now();
+    plan_slot();
     update_pdcp();
+    if (health) t[1] = std::chrono::steady_clock::now();
     update_pos();
+    if (health) t[2] = std::chrono::steady_clock::now();
     emit_mobility_monitoring();
-    if (log_traffic && ue_log.ready())
+    if (plan.text_traffic)
     {
-        ue_log.log_partial("gul:{} gdl:{} ", pdcp_ul.get_generated(true), pdcp_dl.get_generated(true));
+        ue_log.log_partial("gul:{} gdl:{} ", slot_pdcp_stats(TX_UL).generated, slot_pdcp_stats(TX_DL).generated);
     }
     emit_pdcp_monitoring();
     emit_queue_monitoring();
@@ -598,12 +710,94 @@ void ue::step()
     if (log_ue)
         add_ts();
 
+    if (health) t[3] = std::chrono::steady_clock::now();
     estimate_channel_state();
+    if (health) t[4] = std::chrono::steady_clock::now();
     emit_phy_monitoring();
+    if (recorder)
+        record_slot();
+    if (health)
+    {
+        t[5] = std::chrono::steady_clock::now();
+        update_health(t);
+    }
 
     return;
 }
 
+//--------------------------------------------------------------------------------------------------
+// update_health(): adds the PDCP, mobility, PHY and monitoring/logging phase times of this step to
+// the health endpoint counters and stores the queue depths. Relaxed atomics written only by this
+// UE's thread.
+//--------------------------------------------------------------------------------------------------
+void ue::update_health(const std::chrono::steady_clock::time_point *t)
+{
+    typedef std::chrono::nanoseconds ns;
+    health->pdcp_ns.fetch_add(std::chrono::duration_cast<ns>(t[1] - t[0]).count(), std::memory_order_relaxed);
+    health->mobility_ns.fetch_add(std::chrono::duration_cast<ns>(t[2] - t[1]).count(), std::memory_order_relaxed);
+    health->phy_ns.fetch_add(std::chrono::duration_cast<ns>(t[4] - t[3]).count(), std::memory_order_relaxed);
+    health->monitoring_ns.fetch_add(std::chrono::duration_cast<ns>((t[3] - t[2]) + (t[5] - t[4])).count(), std::memory_order_relaxed);
+    for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+    {
+        health->ip_packets[tx_dir].store(pdcp(tx_dir).ip_queue_size(), std::memory_order_relaxed);
+        health->harq_packets[tx_dir].store(pdcp(tx_dir).harq_queue_size(), std::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// record_slot(): appends this slot to the UE's binary record, with the values of the text UE log.
+//--------------------------------------------------------------------------------------------------
+void ue::record_slot()
+{
+    double row[REC_N_COLUMNS];
+    const pdcp_slot_stats &ul = slot_pdcp_stats(TX_UL);
+    const pdcp_slot_stats &dl = slot_pdcp_stats(TX_DL);
+    const dualpi2_stats &l4s_ul = last_l4s_ul_interval_stats;
+    const dualpi2_stats &l4s_dl = last_l4s_dl_interval_stats;
+    row[REC_T] = current_t;
+    row[REC_X] = mobility_m.x();
+    row[REC_Y] = mobility_m.y();
+    row[REC_RUL] = ul.tp;
+    row[REC_RDL] = dl.tp;
+    row[REC_LUL] = ul.latency;
+    row[REC_LDL] = dl.latency;
+    row[REC_ILUL] = ul.ip_latency;
+    row[REC_ILDL] = dl.ip_latency;
+    row[REC_EUL] = ul.error;
+    row[REC_EDL] = dl.error;
+    row[REC_GUL] = ul.generated;
+    row[REC_GDL] = dl.generated;
+    row[REC_CEUL] = l4s_ul.ce_packets;
+    row[REC_CEDL] = l4s_dl.ce_packets;
+    row[REC_CEBUL] = l4s_ul.ce_bits;
+    row[REC_CEBDL] = l4s_dl.ce_bits;
+    row[REC_AQMDUL] = l4s_ul.aqm_drops;
+    row[REC_AQMDDL] = l4s_dl.aqm_drops;
+    row[REC_AQMDBUL] = l4s_ul.aqm_drop_bits;
+    row[REC_AQMDBDL] = l4s_dl.aqm_drop_bits;
+    row[REC_QLUL] = l4s_ul.l4s_queue_size;
+    row[REC_QLDL] = l4s_dl.l4s_queue_size;
+    row[REC_QCUL] = l4s_ul.classic_queue_size;
+    row[REC_QCDL] = l4s_dl.classic_queue_size;
+    row[REC_PLUL] = l4s_ul.p_l;
+    row[REC_PLDL] = l4s_dl.p_l;
+    row[REC_PCUL] = l4s_ul.p_c;
+    row[REC_PCDL] = l4s_dl.p_c;
+    row[REC_PCLUL] = l4s_ul.p_cl;
+    row[REC_PCLDL] = l4s_dl.p_cl;
+    row[REC_SINR_UL] = phy_ul.get_mean_sinr();
+    row[REC_SINR_DL] = phy_dl.get_mean_sinr();
+    row[REC_RSRP_UL] = phy_ul.get_mean_rsrp();
+    row[REC_RSRP_DL] = phy_dl.get_mean_rsrp();
+    row[REC_CQI_UL] = phy_ul.get_mean_cqi();
+    row[REC_CQI_DL] = phy_dl.get_mean_cqi();
+    row[REC_MCS_UL] = phy_ul.get_mean_mcs();
+    row[REC_MCS_DL] = phy_dl.get_mean_mcs();
+    row[REC_RI_UL] = phy_ul.get_ri();
+    row[REC_RI_DL] = phy_dl.get_ri();
+    recorder->record(row);
+}
+
 void ue::print_traffic()
 {
     if (verbosity >= 1)
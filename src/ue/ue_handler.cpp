@@ -95,6 +95,11 @@ void ue_handler::print_traffic()
     }
 }
 
+void ue_handler::flush_monitoring()
+{
+    for(size_t i = 0; i < ue_list.size(); i++) ue_list[i].flush_monitoring();
+}
+
 std::vector<ue>* ue_handler::get_ue_list()
 {
     return &ue_list;
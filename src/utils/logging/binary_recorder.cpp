@@ -0,0 +1,248 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#include <utils/logging/binary_recorder.h>
+#include <utils/terminal_logging.h>
+#include <spdlog/details/os.h>
+#include <cstring>
+#include <zlib.h>
+
+namespace
+{
+const char *const column_names[REC_N_COLUMNS] = {
+    "t",
+    "x", "y",
+    "rul", "rdl", "lul", "ldl", "ilul", "ildl", "eul", "edl", "gul", "gdl",
+    "ceul", "cedl", "cebul", "cebdl", "aqmdul", "aqmddl", "aqmdbul", "aqmdbdl",
+    "qlul", "qldl", "qcul", "qcdl", "plul", "pldl", "pcul", "pcdl", "pclul", "pcldl",
+    "sinr_ul", "sinr_dl", "rsrp_ul", "rsrp_dl", "cqi_ul", "cqi_dl", "mcs_ul", "mcs_dl",
+    "ri_ul", "ri_dl"
+};
+
+struct chunk_header
+{
+    uint32_t magic;
+    int32_t ue_id;
+    uint32_t rows;
+    uint32_t codec;
+    uint64_t stored_bytes;
+    uint64_t raw_bytes;
+};
+}
+
+void recorder_stream::record(const double *row)
+{
+    if(chunk == nullptr)
+    {
+        chunk = owner->take_chunk(*this);
+        if(chunk == nullptr)
+        {
+            dropped_rows++;
+            return;
+        }
+        chunk->ue_id = ue_id;
+        chunk->rows = 0;
+    }
+
+    const uint32_t r = chunk->rows;
+    const uint32_t chunk_rows = (uint32_t)owner->cfg.chunk_rows;
+    uint8_t *column = chunk->data.data();
+    for(int c = 0; c < REC_N_COLUMNS; c++)
+    {
+        if(c == REC_T) reinterpret_cast<double*>(column)[r] = row[c];
+        else reinterpret_cast<float*>(column)[r] = (float)row[c];
+        column += binary_recorder::column_bytes(c, chunk_rows);
+    }
+    if(++chunk->rows == chunk_rows) owner->submit(*this);
+}
+
+binary_recorder::~binary_recorder()
+{
+    close();
+}
+
+binary_recorder &binary_recorder::instance()
+{
+    static binary_recorder r;
+    return r;
+}
+
+const char *binary_recorder::column_name(int column)
+{
+    return column >= 0 && column < REC_N_COLUMNS ? column_names[column] : "";
+}
+
+bool binary_recorder::open(const recorder_config &c)
+{
+    if(file != nullptr) return true;
+    cfg = c;
+    if(cfg.chunk_rows < 1) cfg.chunk_rows = 1;
+    codec = cfg.compression == "zlib" ? RECORDER_CODEC_ZLIB : RECORDER_CODEC_NONE;
+    if(cfg.compression != "zlib" && cfg.compression != "none")
+    {
+        LOG_WARNING_I("binary_recorder::open") << "Unknown compression " << cfg.compression << ", writing uncompressed" << END();
+    }
+
+    const std::string dir = spdlog::details::os::dir_name(cfg.path);
+    if(!dir.empty()) spdlog::details::os::create_dir(dir);
+    file = std::fopen(cfg.path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        LOG_ERROR_I("binary_recorder::open") << "Cannot open " << cfg.path << ": " << std::strerror(errno) << END();
+        return false;
+    }
+
+    std::fwrite(RECORDER_MAGIC, 1, 8, file);
+    const uint32_t version = 1;
+    const uint32_t n_columns = REC_N_COLUMNS;
+    std::fwrite(&version, sizeof(version), 1, file);
+    std::fwrite(&n_columns, sizeof(n_columns), 1, file);
+    for(int col = 0; col < REC_N_COLUMNS; col++)
+    {
+        uint8_t entry[1 + RECORDER_NAME_LEN] = {0};
+        entry[0] = col == REC_T ? 1 : 0;
+        std::strncpy((char*)entry + 1, column_names[col], RECORDER_NAME_LEN - 1);
+        std::fwrite(entry, sizeof(entry), 1, file);
+    }
+
+    chunk_bytes = 0;
+    for(int col = 0; col < REC_N_COLUMNS; col++) chunk_bytes += column_bytes(col, cfg.chunk_rows);
+    stopping = false;
+    writer = std::thread(&binary_recorder::writer_loop, this);
+    LOG_INFO_I("binary_recorder::open") << "Recording UE slots to " << cfg.path << " (compression " << (codec == RECORDER_CODEC_ZLIB ? "zlib" : "none") << ")" << END();
+    return true;
+}
+
+recorder_stream *binary_recorder::open_stream(int ue_id)
+{
+    if(file == nullptr) return nullptr;
+    std::unique_ptr<recorder_stream> stream(new recorder_stream());
+    stream->owner = this;
+    stream->ue_id = ue_id;
+    std::lock_guard<std::mutex> lk(mtx);
+    streams.push_back(std::move(stream));
+    return streams.back().get();
+}
+
+//--------------------------------------------------------------------------------------------------
+// close(): writes the partial chunks and waits for the writer. UE threads must be done recording.
+//--------------------------------------------------------------------------------------------------
+void binary_recorder::close()
+{
+    if(file == nullptr) return;
+
+    uint64_t dropped = 0;
+    for(auto &stream: streams)
+    {
+        if(stream->chunk != nullptr && stream->chunk->rows > 0) submit(*stream);
+        dropped += stream->dropped_rows;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    if(writer.joinable()) writer.join();
+
+    std::fclose(file);
+    file = nullptr;
+    if(dropped > 0)
+    {
+        LOG_WARNING_I("binary_recorder::close") << "Dropped " << dropped << " rows, the writer could not keep up" << END();
+    }
+}
+
+recorder_chunk *binary_recorder::take_chunk(recorder_stream &stream)
+{
+    std::lock_guard<std::mutex> lk(mtx);
+    if(stream.queued >= RECORDER_MAX_QUEUED_PER_STREAM) return nullptr;
+    if(!free_chunks.empty())
+    {
+        recorder_chunk *chunk = free_chunks.back();
+        free_chunks.pop_back();
+        return chunk;
+    }
+    chunks.emplace_back(new recorder_chunk());
+    chunks.back()->data.resize(chunk_bytes);
+    return chunks.back().get();
+}
+
+void binary_recorder::submit(recorder_stream &stream)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        full.emplace_back(&stream, stream.chunk);
+        stream.queued++;
+    }
+    stream.chunk = nullptr;
+    cv.notify_one();
+}
+
+void binary_recorder::writer_loop()
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    while(true)
+    {
+        cv.wait(lk, [this](){ return stopping || !full.empty(); });
+        if(full.empty()) break;
+        std::pair<recorder_stream*, recorder_chunk*> item = full.front();
+        full.pop_front();
+        lk.unlock();
+        write_chunk(*item.second);
+        lk.lock();
+        free_chunks.push_back(item.second);
+        item.first->queued--;
+    }
+}
+
+void binary_recorder::write_chunk(recorder_chunk &chunk)
+{
+    // Partial chunks are compacted so that the columns follow each other
+    const uint8_t *raw = chunk.data.data();
+    size_t raw_bytes = chunk_bytes;
+    if(chunk.rows < (uint32_t)cfg.chunk_rows)
+    {
+        raw_bytes = 0;
+        for(int col = 0; col < REC_N_COLUMNS; col++) raw_bytes += column_bytes(col, chunk.rows);
+        packed.assign(raw_bytes, 0);
+        const uint8_t *src = chunk.data.data();
+        uint8_t *dst = packed.data();
+        for(int col = 0; col < REC_N_COLUMNS; col++)
+        {
+            std::memcpy(dst, src, column_size(col) * chunk.rows);
+            src += column_bytes(col, cfg.chunk_rows);
+            dst += column_bytes(col, chunk.rows);
+        }
+        raw = packed.data();
+    }
+
+    chunk_header h;
+    h.magic = RECORDER_CHUNK_MAGIC;
+    h.ue_id = chunk.ue_id;
+    h.rows = chunk.rows;
+    h.codec = RECORDER_CODEC_NONE;
+    h.raw_bytes = raw_bytes;
+    h.stored_bytes = raw_bytes;
+    const uint8_t *payload = raw;
+
+    if(codec == RECORDER_CODEC_ZLIB)
+    {
+        uLongf out_len = compressBound(raw_bytes);
+        compressed.resize(out_len);
+        // Kept raw when it does not shrink
+        if(compress2(compressed.data(), &out_len, raw, raw_bytes, 1) == Z_OK && out_len < raw_bytes)
+        {
+            h.codec = RECORDER_CODEC_ZLIB;
+            h.stored_bytes = out_len;
+            payload = compressed.data();
+        }
+    }
+
+    static const uint8_t pad[8] = {0};
+    std::fwrite(&h, sizeof(h), 1, file);
+    std::fwrite(payload, 1, h.stored_bytes, file);
+    std::fwrite(pad, 1, (8 - h.stored_bytes % 8) % 8, file);
+}
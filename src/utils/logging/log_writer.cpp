@@ -0,0 +1,190 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#include <utils/logging/log_writer.h>
+#include <utils/terminal_logging.h>
+#include <spdlog/details/os.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+log_stream::log_stream(size_t bytes)
+{
+    size_t n = 64;
+    while(n < bytes) n <<= 1;
+    ring.resize(n);
+    mask = n - 1;
+}
+
+void log_stream::copy_in(size_t pos, const char *src, size_t n)
+{
+    const size_t off = pos & mask;
+    const size_t first = std::min(n, ring.size() - off);
+    std::memcpy(&ring[off], src, first);
+    std::memcpy(&ring[0], src + first, n - first);
+}
+
+void log_stream::copy_out(size_t pos, char *dst, size_t n) const
+{
+    const size_t off = pos & mask;
+    const size_t first = std::min(n, ring.size() - off);
+    std::memcpy(dst, &ring[off], first);
+    std::memcpy(dst + first, &ring[0], n - first);
+}
+
+bool log_stream::write(const char *data, size_t size)
+{
+    const uint32_t len = (uint32_t)size;
+    const size_t need = sizeof(len) + size;
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if(t + need - head_cache > ring.size())
+    {
+        head_cache = head.load(std::memory_order_acquire);
+        if(t + need - head_cache > ring.size())
+        {
+            dropped++;
+            return false;
+        }
+    }
+    copy_in(t, (const char*)&len, sizeof(len));
+    copy_in(t + sizeof(len), data, size);
+    tail.store(t + need, std::memory_order_release);
+    return true;
+}
+
+log_writer::~log_writer()
+{
+    stop();
+}
+
+log_writer &log_writer::instance()
+{
+    static log_writer w;
+    return w;
+}
+
+void log_writer::configure(const log_writer_config &c)
+{
+    std::lock_guard<std::mutex> lk(mtx);
+    cfg = c;
+    if(cfg.flush_ms < 1) cfg.flush_ms = 1;
+}
+
+log_stream *log_writer::open_stream(const std::string &path)
+{
+    const std::string dir = spdlog::details::os::dir_name(path);
+    if(!dir.empty()) spdlog::details::os::create_dir(dir);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        LOG_ERROR_I("log_writer::open_stream") << "Cannot open " << path << ": " << std::strerror(errno) << END();
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(mtx);
+    std::unique_ptr<log_stream> stream(new log_stream(cfg.queue_bytes));
+    stream->fd = fd;
+    stream->path = path;
+    stream->out.reserve(cfg.buffer_bytes);
+    streams.push_back(std::move(stream));
+    n_streams.store(streams.size(), std::memory_order_release);
+    if(!writer.joinable() && !stopping.load()) writer = std::thread(&log_writer::writer_loop, this);
+    return streams.back().get();
+}
+
+void log_writer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        if(!writer.joinable()) return;
+        stopping.store(true);
+    }
+    writer.join();
+
+    uint64_t dropped = 0;
+    for(auto &stream: streams)
+    {
+        dropped += stream->dropped;
+        close(stream->fd);
+        stream->fd = -1;
+    }
+    if(dropped > 0)
+    {
+        LOG_WARNING_I("log_writer::stop") << "Dropped " << dropped << " log lines, raise log_queue_bytes" << END();
+    }
+}
+
+void log_writer::writer_loop()
+{
+    std::vector<log_stream*> local;
+    log_writer_config c;
+    std::chrono::steady_clock::time_point next_flush = std::chrono::steady_clock::now();
+    while(true)
+    {
+        // Read before draining: a pass that starts after the stop and finds nothing is the last one
+        const bool stop = stopping.load();
+        if(local.size() != n_streams.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            c = cfg;
+            local.clear();
+            for(auto &stream: streams) local.push_back(stream.get());
+        }
+
+        size_t drained = 0;
+        for(log_stream *stream: local) drained += drain(*stream, c.buffer_bytes);
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(now >= next_flush || (stop && drained == 0))
+        {
+            for(log_stream *stream: local) write_out(*stream);
+            next_flush = now + std::chrono::milliseconds(c.flush_ms);
+        }
+        if(stop && drained == 0) break;
+        if(drained == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+size_t log_writer::drain(log_stream &stream, size_t buffer_bytes)
+{
+    size_t lines = 0;
+    size_t h = stream.head.load(std::memory_order_relaxed);
+    const size_t t = stream.tail.load(std::memory_order_acquire);
+    while(h != t)
+    {
+        uint32_t len;
+        stream.copy_out(h, (char*)&len, sizeof(len));
+        const size_t start = stream.out.size();
+        stream.out.resize(start + len + 1);
+        stream.copy_out(h + sizeof(len), &stream.out[start], len);
+        stream.out[start + len] = '\n';
+        h += sizeof(len) + len;
+        lines++;
+        if(stream.out.size() >= buffer_bytes) write_out(stream);
+    }
+    stream.head.store(h, std::memory_order_release);
+    return lines;
+}
+
+void log_writer::write_out(log_stream &stream)
+{
+    size_t off = 0;
+    while(off < stream.out.size())
+    {
+        ssize_t n = ::write(stream.fd, stream.out.data() + off, stream.out.size() - off);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0)
+        {
+            LOG_ERROR_I("log_writer::write_out") << "Cannot write " << stream.path << ": " << std::strerror(errno) << END();
+            break;
+        }
+        off += n;
+    }
+    stream.out.clear();
+}
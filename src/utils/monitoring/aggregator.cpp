@@ -1,24 +1,14 @@
 #include "utils/monitoring/aggregator.h"
+#include "utils/monitoring/line_protocol.h"
 #include <thread>
-#include <sstream>
-#include <iomanip>
 #include <iostream>
 #include <algorithm>
 
-namespace
-{
-std::string format_numeric_field(double value)
-{
-    std::ostringstream out;
-    out << std::fixed << std::setprecision(6) << value;
-    return out.str();
-}
-}
-
+// The emit callbacks may point into objects already destroyed, so nothing is flushed here; owners
+// call stop() while they are alive.
 aggregator::~aggregator()
 {
-    running = false;
-    if(worker.joinable()) worker.join();
+    stop_worker();
 }
 
 void aggregator::init(const monitoring_config &c)
@@ -26,66 +16,216 @@ void aggregator::init(const monitoring_config &c)
     cfg = c;
     running = true;
     worker = std::thread([this]() {
+        std::unique_lock<std::mutex> lk(stop_mtx);
         while(running)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.aggregation_window_ms));
-            // swap accumulators
-            std::unordered_map<std::string, series_window> snapshot;
+            stop_cv.wait_for(lk, std::chrono::milliseconds(cfg.aggregation_window_ms), [this]() { return !running; });
+            if(!running) break;
+            lk.unlock();
+            flush_window();
+            lk.lock();
+        }
+    });
+}
+
+//--------------------------------------------------------------------------------------------------
+// stop(): wakes and joins the flush thread, then flushes the window in progress so that whatever was
+// added since the last window boundary, e.g. a run shorter than one window, still reaches the output.
+//--------------------------------------------------------------------------------------------------
+void aggregator::stop()
+{
+    if(stop_worker()) flush_window();
+}
+
+// Wakes and joins the flush thread. Output: false when it was not running.
+bool aggregator::stop_worker()
+{
+    {
+        std::lock_guard<std::mutex> lk(stop_mtx);
+        if(!running) return false;
+        running = false;
+    }
+    stop_cv.notify_all();
+    if(worker.joinable()) worker.join();
+    return true;
+}
+
+// Emits one aggregation window: the ad hoc points, then the registered series.
+void aggregator::flush_window()
+{
+    // swap accumulators
+    std::unordered_map<std::string, series_window> snapshot;
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        snapshot.swap(accum);
+    }
+    // emit aggregated metrics
+    for(auto &kv: snapshot)
+    {
+        const std::string &key = kv.first;
+        const series_window &series = kv.second;
+        if(series.fields.empty()) continue;
+        // key format: measurement|tag1=val,tag2=val
+        line.clear();
+        auto pos = key.find('|');
+        if(pos != std::string::npos)
+        {
+            line.append(key, 0, pos);
+            if(pos + 1 < key.size())
             {
-                std::lock_guard<std::mutex> lk(mtx);
-                snapshot.swap(accum);
+                line += ',';
+                line.append(key, pos + 1, std::string::npos);
             }
-            // emit aggregated metrics
-            for(auto &kv: snapshot)
+        }
+        else line += key;
+
+        bool first_field = true;
+        for(const auto &field_kv : series.fields)
+        {
+            line += first_field ? ' ' : ',';
+            line += field_kv.first;
+            line += '=';
+            lp_append_fixed6(line, window_value(field_kv.second));
+            first_field = false;
+        }
+        line += ' ';
+        lp_append_int(line, series.latest_ts_ns > 0 ? series.latest_ts_ns
+            : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::system_clock::now().time_since_epoch()).count());
+
+        if(emit_cb) emit_cb(line);
+    }
+    flush_registered();
+    if(flush_cb) flush_cb();
+    windows.fetch_add(1, std::memory_order_relaxed);
+}
+
+int aggregator::register_series(const std::string &measurement, const std::map<std::string,std::string> &tags,
+                                const std::vector<metric_field_spec> &fields)
+{
+    if(fields.empty() || fields.size() > METRIC_MAX_FIELDS) return -1;
+
+    std::unique_ptr<registered_series> series(new registered_series());
+    series->line_prefix = measurement;
+    for(auto &t: tags) series->line_prefix += "," + t.first + "=" + t.second;
+    series->fields = fields;
+    series->buffers[0].fields.resize(fields.size());
+    series->buffers[1].fields.resize(fields.size());
+
+    std::lock_guard<std::mutex> lk(mtx);
+    const int id = series_count.load(std::memory_order_relaxed);
+    if(id >= AGGREGATOR_SERIES_PAGE * AGGREGATOR_SERIES_PAGES) return -1;
+    std::unique_ptr<series_page> &page = pages[id / AGGREGATOR_SERIES_PAGE];
+    if(!page) page.reset(new series_page());
+    page->series[id % AGGREGATOR_SERIES_PAGE] = std::move(series);
+    series_count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+aggregator::registered_series *aggregator::find_series(int series_id) const
+{
+    if(series_id < 0 || series_id >= series_count.load(std::memory_order_acquire)) return nullptr;
+    return pages[series_id / AGGREGATOR_SERIES_PAGE]->series[series_id % AGGREGATOR_SERIES_PAGE].get();
+}
+
+void aggregator::add_values(int series_id, const double *values, std::int64_t ts_ns)
+{
+    add_window(series_id, values, values, 1, ts_ns);
+}
+
+//--------------------------------------------------------------------------------------------------
+// add_window(): merges samples already summed by the publisher (see metric_window): per field the sum
+// and the last value of samples. add_values() is the single sample case. Lock free; a series must
+// only be published by one thread at a time (the UE or layer owning it). publishing is raised before
+// the epoch is read, so flush_registered() either sees it and waits, or has already bumped the epoch
+// and this call writes to the next window.
+//--------------------------------------------------------------------------------------------------
+void aggregator::add_window(int series_id, const double *sums, const double *lasts, int samples, std::int64_t ts_ns)
+{
+    registered_series *series = find_series(series_id);
+    if(series == nullptr || samples <= 0) return;
+
+    series->publishing.store(true);
+    series_buffer &buffer = series->buffers[series->epoch.load() & 1];
+    if(ts_ns > buffer.latest_ts_ns) buffer.latest_ts_ns = ts_ns;
+    buffer.touched = true;
+    for(size_t i = 0; i < series->fields.size(); i++)
+        merge(buffer.fields[i], series->fields[i].aggregation, sums[i], lasts[i], samples, ts_ns);
+    series->publishing.store(false, std::memory_order_release);
+}
+
+void aggregator::flush_registered()
+{
+    const int n = series_count.load(std::memory_order_acquire);
+    for(int id = 0; id < n; id++)
+    {
+        registered_series *series = find_series(id);
+        const unsigned epoch = series->epoch.load(std::memory_order_relaxed);
+        series->epoch.store(epoch + 1);
+        while(series->publishing.load()) std::this_thread::yield();
+
+        // The publisher has moved to the other buffer, this one is only touched here until the next flip
+        series_buffer &buffer = series->buffers[epoch & 1];
+        if(!buffer.touched) continue;
+
+        line = series->line_prefix;
+        for(size_t i = 0; i < series->fields.size(); i++)
+        {
+            line += i == 0 ? ' ' : ',';
+            line += series->fields[i].name;
+            line += '=';
+            lp_append_fixed6(line, window_value(buffer.fields[i]));
+        }
+        line += ' ';
+        lp_append_int(line, buffer.latest_ts_ns > 0 ? buffer.latest_ts_ns
+            : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::system_clock::now().time_since_epoch()).count());
+
+        for(auto &a: buffer.fields) a = window_accum();
+        buffer.latest_ts_ns = 0;
+        buffer.touched = false;
+
+        if(emit_cb) emit_cb(line);
+    }
+}
+
+void aggregator::merge(window_accum &a, field_aggregation aggregation, double sum, double last, int samples,
+                       std::int64_t ts_ns)
+{
+    a.aggregation = aggregation;
+    a.initialized = true;
+    switch(aggregation)
+    {
+        case field_aggregation::sum:
+            a.sum += sum;
+            break;
+        case field_aggregation::mean:
+            a.sum += sum;
+            a.count += samples;
+            break;
+        case field_aggregation::last:
+            if(ts_ns >= a.last_ts)
             {
-                const std::string &key = kv.first;
-                const series_window &series = kv.second;
-                // key format: measurement|tag1=val,tag2=val
-                std::string measurement;
-                std::string tags;
-                auto pos = key.find('|');
-                if(pos != std::string::npos)
-                {
-                    measurement = key.substr(0,pos);
-                    tags = key.substr(pos+1);
-                }
-                else measurement = key;
-
-                std::ostringstream out;
-                out << measurement;
-                if(!tags.empty()) out << "," << tags;
-                bool first_field = true;
-                for(const auto &field_kv : series.fields)
-                {
-                    const std::string &field_name = field_kv.first;
-                    const window_accum &a = field_kv.second;
-                    double value = 0.0;
-                    switch(a.aggregation)
-                    {
-                        case field_aggregation::sum:
-                            value = a.sum;
-                            break;
-                        case field_aggregation::mean:
-                            value = a.count ? (a.sum / a.count) : 0.0;
-                            break;
-                        case field_aggregation::last:
-                            value = a.last_value;
-                            break;
-                    }
-                    out << (first_field ? " " : ",");
-                    out << field_name << "=" << format_numeric_field(value);
-                    first_field = false;
-                }
-                if(first_field) continue;
-                const std::int64_t ts_ns = series.latest_ts_ns > 0 ? series.latest_ts_ns
-                    : std::chrono::duration_cast<std::chrono::nanoseconds>(
-                          std::chrono::system_clock::now().time_since_epoch()).count();
-                out << " " << ts_ns;
-
-                if(emit_cb) emit_cb(out.str());
+                a.last_value = last;
+                a.last_ts = ts_ns;
             }
-        }
-    });
+            break;
+    }
+    if(aggregation != field_aggregation::last) a.last_ts = ts_ns;
+}
+
+double aggregator::window_value(const window_accum &a)
+{
+    switch(a.aggregation)
+    {
+        case field_aggregation::sum:
+            return a.sum;
+        case field_aggregation::mean:
+            return a.count ? (a.sum / a.count) : 0.0;
+        case field_aggregation::last:
+            return a.last_value;
+    }
+    return 0.0;
 }
 
 void aggregator::add_point(const metric_point &p)
@@ -110,28 +250,7 @@ void aggregator::add_point(const metric_point &p)
     if(p.ts_ns > series.latest_ts_ns) series.latest_ts_ns = p.ts_ns;
     for(const auto &field_kv : p.fields)
     {
-        const std::string &field_name = field_kv.first;
         const metric_field &field = field_kv.second;
-        window_accum &a = series.fields[field_name];
-        a.aggregation = field.aggregation;
-        a.initialized = true;
-        switch(field.aggregation)
-        {
-            case field_aggregation::sum:
-                a.sum += field.value;
-                break;
-            case field_aggregation::mean:
-                a.sum += field.value;
-                a.count += 1;
-                break;
-            case field_aggregation::last:
-                if(p.ts_ns >= a.last_ts)
-                {
-                    a.last_value = field.value;
-                    a.last_ts = p.ts_ns;
-                }
-                break;
-        }
-        if(field.aggregation != field_aggregation::last) a.last_ts = p.ts_ns;
+        merge(series.fields[field_kv.first], field.aggregation, field.value, field.value, 1, p.ts_ns);
     }
 }
@@ -0,0 +1,183 @@
+#include "utils/monitoring/health_endpoint.h"
+#include <utils/terminal_logging.h>
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+
+#define HEALTH_POLL_MS 200
+
+health_endpoint::~health_endpoint()
+{
+    close();
+}
+
+health_endpoint &health_endpoint::instance()
+{
+    static health_endpoint e;
+    return e;
+}
+
+bool health_endpoint::open(const std::string &socket_path, bool realtime)
+{
+    if(listen_fd != -1) return true;
+    sockaddr_un sa{};
+    if(socket_path.size() >= sizeof(sa.sun_path))
+    {
+        LOG_ERROR_I("health_endpoint::open") << "Socket path too long: " << socket_path << END();
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        LOG_ERROR_I("health_endpoint::open") << "Cannot create socket: " << std::strerror(errno) << END();
+        return false;
+    }
+    sa.sun_family = AF_UNIX;
+    std::strncpy(sa.sun_path, socket_path.c_str(), sizeof(sa.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if(bind(fd, (sockaddr*)&sa, sizeof(sa)) != 0 || listen(fd, 4) != 0)
+    {
+        LOG_ERROR_I("health_endpoint::open") << "Cannot listen on " << socket_path << ": " << std::strerror(errno) << END();
+        ::close(fd);
+        return false;
+    }
+
+    listen_fd = fd;
+    path = socket_path;
+    realtime_mode = realtime;
+    start_tp = std::chrono::steady_clock::now();
+    stopping.store(false);
+    server = std::thread(&health_endpoint::serve, this);
+    return true;
+}
+
+void health_endpoint::close()
+{
+    if(listen_fd == -1) return;
+    stopping.store(true);
+    if(server.joinable()) server.join();
+    ::close(listen_fd);
+    listen_fd = -1;
+    unlink(path.c_str());
+}
+
+ue_health_counters *health_endpoint::add_ue()
+{
+    if(listen_fd == -1) return nullptr;
+    std::lock_guard<std::mutex> lk(ues_mtx);
+    ues.emplace_back(new ue_health_counters());
+    n_ues.store(ues.size(), std::memory_order_release);
+    return ues.back().get();
+}
+
+void health_endpoint::serve()
+{
+    while(!stopping.load())
+    {
+        pollfd pfd;
+        pfd.fd = listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if(poll(&pfd, 1, HEALTH_POLL_MS) <= 0) continue;
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(client < 0) continue;
+
+        const std::string body = snapshot() + "\n";
+        size_t off = 0;
+        while(off < body.size())
+        {
+            ssize_t n = send(client, body.data() + off, body.size() - off, MSG_NOSIGNAL);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) break;
+            off += n;
+        }
+        ::close(client);
+    }
+}
+
+std::string health_endpoint::snapshot() const
+{
+    const std::uint64_t n_slots = slots.load(std::memory_order_relaxed);
+    const double per_slot = n_slots > 0 ? 1e-6 / n_slots : 0.0; // ns totals to ms per slot
+
+    std::uint64_t pdcp_ns = 0, mobility_ns = 0, phy_ns = 0, monitoring_ns = 0;
+    long ip[2] = {0, 0}, harq[2] = {0, 0};
+    int ip_max = 0, harq_max = 0;
+    const size_t ue_count = n_ues.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lk(ues_mtx);
+        for(size_t i = 0; i < ue_count; i++)
+        {
+            const ue_health_counters &c = *ues[i];
+            pdcp_ns += c.pdcp_ns.load(std::memory_order_relaxed);
+            mobility_ns += c.mobility_ns.load(std::memory_order_relaxed);
+            phy_ns += c.phy_ns.load(std::memory_order_relaxed);
+            monitoring_ns += c.monitoring_ns.load(std::memory_order_relaxed);
+            for(int tx_dir = 0; tx_dir < 2; tx_dir++)
+            {
+                const int ip_n = c.ip_packets[tx_dir].load(std::memory_order_relaxed);
+                const int harq_n = c.harq_packets[tx_dir].load(std::memory_order_relaxed);
+                ip[tx_dir] += ip_n;
+                harq[tx_dir] += harq_n;
+                ip_max = std::max(ip_max, ip_n);
+                harq_max = std::max(harq_max, harq_n);
+            }
+        }
+    }
+
+    nlohmann::json j;
+    j["mode"] = realtime_mode ? "realtime" : "fast";
+    j["sim_time_s"] = sim_time_us.load(std::memory_order_relaxed) * 1e-6;
+    j["wall_time_s"] = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start_tp).count();
+    j["slots"] = n_slots;
+    j["ues"] = ue_count;
+    j["step_time_ms_mean"] = {
+        {"mac", mac_total_ns.load(std::memory_order_relaxed) * per_slot},
+        {"ue", ue_total_ns.load(std::memory_order_relaxed) * per_slot},
+        // Summed over the UEs, so several threads can add up to more than the UE step
+        {"pdcp", pdcp_ns * per_slot},
+        {"mobility", mobility_ns * per_slot},
+        {"phy", phy_ns * per_slot},
+        {"monitoring", monitoring_ns * per_slot},
+    };
+
+    if(realtime_mode)
+    {
+        std::uint64_t hist[HEALTH_LATENESS_BUCKETS];
+        std::uint64_t total = 0;
+        for(int b = 0; b < HEALTH_LATENESS_BUCKETS; b++)
+        {
+            hist[b] = lateness_hist[b].load(std::memory_order_relaxed);
+            total += hist[b];
+        }
+        // Upper bound of the bucket holding the percentile
+        auto percentile = [&](double p) -> std::int64_t {
+            if(total == 0) return 0;
+            const std::uint64_t rank = (std::uint64_t)(p * (total - 1)) + 1;
+            std::uint64_t seen = 0;
+            for(int b = 0; b < HEALTH_LATENESS_BUCKETS; b++)
+            {
+                seen += hist[b];
+                if(seen >= rank) return ((std::int64_t)1 << b) - 1;
+            }
+            return lateness_max_us.load(std::memory_order_relaxed);
+        };
+        j["slot_lateness_us"] = {
+            {"p50", percentile(0.50)},
+            {"p90", percentile(0.90)},
+            {"p99", percentile(0.99)},
+            {"max", lateness_max_us.load(std::memory_order_relaxed)},
+        };
+    }
+
+    j["queues"] = {
+        {"ip_packets", {{"ul", ip[1]}, {"dl", ip[0]}, {"max_ue", ip_max}}},
+        {"harq_packets", {{"ul", harq[1]}, {"dl", harq[0]}, {"max_ue", harq_max}}},
+    };
+    return j.dump();
+}
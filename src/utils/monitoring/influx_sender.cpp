@@ -3,51 +3,225 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <cerrno>
 #include <cstring>
+#include <chrono>
 #include <mutex>
 #include <iostream>
+#include <algorithm>
+
+#define INFLUX_RECONNECT_MIN_MS 500
+#define INFLUX_RECONNECT_MAX_MS 30000
+// Full datagrams collected before send_line() flushes on its own
+#define INFLUX_MAX_BATCH_DATAGRAMS 64
 
 struct influx_sender::impl
 {
     monitoring_config cfg;
 
-    struct dest
+    struct datagram_dest
     {
         monitoring_output_config c;
-        int fd = -1;
         sockaddr_storage addr{};
         socklen_t addr_len = 0;
-        bool stream = false;
+        bool failing = false; // Reported once until a flush reaches it again
+        bool failed = false;  // In the current flush
+    };
+
+    struct stream_dest
+    {
+        monitoring_output_config c;
+        sockaddr_in addr{};
+        int fd = -1;
+        bool connected = false;
+        bool mid_line = false; // Last send() stopped inside a line
+        std::string pending;
+        std::chrono::steady_clock::time_point retry_at;
+        int backoff_ms = INFLUX_RECONNECT_MIN_MS;
+        bool dropping = false;
     };
 
-    std::vector<dest> destinations;
+    int udp_fd = -1;
+    int unix_fd = -1;
+    std::vector<datagram_dest> udp_dests;
+    std::vector<datagram_dest> unix_dests;
+    std::vector<stream_dest> stream_dests;
+
     std::mutex mtx;
+    std::string batch; // '\n' terminated lines
+    std::vector<size_t> datagram_ends; // End offsets of the closed datagrams of batch
+    size_t datagram_start = 0;
+    std::vector<iovec> iovs;
+    std::vector<mmsghdr> msgs;
 
-    void send_to_destination(const dest &d, const std::string &line) const
+    void close_datagram()
     {
-        if(d.fd == -1) return;
+        if(batch.size() > datagram_start)
+        {
+            datagram_ends.push_back(batch.size());
+            datagram_start = batch.size();
+        }
+    }
+
+    void send_datagrams(int fd, std::vector<datagram_dest> &dests)
+    {
+        if(fd == -1 || dests.empty() || datagram_ends.empty()) return;
 
-        if(d.stream)
+        iovs.resize(datagram_ends.size());
+        size_t start = 0;
+        for(size_t i = 0; i < datagram_ends.size(); i++)
+        {
+            iovs[i].iov_base = &batch[start];
+            iovs[i].iov_len = datagram_ends[i] - start;
+            start = datagram_ends[i];
+        }
+        msgs.resize(iovs.size() * dests.size());
+        size_t m = 0;
+        for(auto &d: dests)
         {
-            ssize_t s = send(d.fd, line.c_str(), line.size(), 0);
-            if(s < 0)
+            for(auto &iov: iovs)
             {
-                std::cerr << "influx_sender: send failed for " << d.c.name
-                          << ": " << std::strerror(errno) << "\n";
+                std::memset(&msgs[m], 0, sizeof(mmsghdr));
+                msgs[m].msg_hdr.msg_name = &d.addr;
+                msgs[m].msg_hdr.msg_namelen = d.addr_len;
+                msgs[m].msg_hdr.msg_iov = &iov;
+                msgs[m].msg_hdr.msg_iovlen = 1;
+                m++;
             }
         }
-        else
+
+        for(auto &d: dests) d.failed = false;
+        size_t off = 0;
+        while(off < msgs.size())
         {
-            ssize_t s = sendto(d.fd, line.c_str(), line.size(), 0, (sockaddr*)&d.addr, d.addr_len);
-            if(s < 0)
+            int sent = sendmmsg(fd, &msgs[off], msgs.size() - off, 0);
+            if(sent < 0)
             {
-                std::cerr << "influx_sender: sendto failed for " << d.c.name
+                if(errno == EINTR) continue;
+                // The first unsent message names the destination that failed, skip the rest of it
+                datagram_dest &d = dests[off / iovs.size()];
+                if(!d.failing)
+                {
+                    std::cerr << "influx_sender: sendmmsg failed for " << d.c.name
+                              << ": " << std::strerror(errno) << ", dropping lines\n";
+                    d.failing = true;
+                }
+                d.failed = true;
+                off = (off / iovs.size() + 1) * iovs.size();
+                continue;
+            }
+            off += sent;
+        }
+        for(auto &d: dests) if(!d.failed) d.failing = false;
+    }
+
+    void disconnect(stream_dest &d)
+    {
+        if(d.fd != -1) close(d.fd);
+        d.fd = -1;
+        d.connected = false;
+        // A line cut by the old connection cannot be completed on the new one
+        if(d.mid_line)
+        {
+            size_t nl = d.pending.find('\n');
+            d.pending.erase(0, nl == std::string::npos ? d.pending.size() : nl + 1);
+            d.mid_line = false;
+        }
+        d.retry_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(d.backoff_ms);
+        d.backoff_ms = std::min(d.backoff_ms * 2, INFLUX_RECONNECT_MAX_MS);
+    }
+
+    // Non blocking: connects, completes a pending connect or writes what the socket accepts.
+    void service_stream(stream_dest &d)
+    {
+        if(d.fd == -1)
+        {
+            if(std::chrono::steady_clock::now() < d.retry_at) return;
+            d.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if(d.fd < 0)
+            {
+                std::cerr << "influx_sender: failed to create socket for " << d.c.name << "\n";
+                disconnect(d);
+                return;
+            }
+            if(connect(d.fd, (sockaddr*)&d.addr, sizeof(d.addr)) == 0) d.connected = true;
+            else if(errno != EINPROGRESS)
+            {
+                std::cerr << "influx_sender: connect failed for " << d.c.name
                           << ": " << std::strerror(errno) << "\n";
+                disconnect(d);
+                return;
+            }
+        }
+
+        if(!d.connected)
+        {
+            pollfd pfd;
+            pfd.fd = d.fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if(poll(&pfd, 1, 0) <= 0) return;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(d.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if(err != 0)
+            {
+                std::cerr << "influx_sender: connect failed for " << d.c.name
+                          << ": " << std::strerror(err) << "\n";
+                disconnect(d);
+                return;
             }
+            d.connected = true;
         }
+        d.backoff_ms = INFLUX_RECONNECT_MIN_MS;
+
+        size_t off = 0;
+        while(off < d.pending.size())
+        {
+            ssize_t s = send(d.fd, d.pending.data() + off, d.pending.size() - off, MSG_NOSIGNAL);
+            if(s > 0)
+            {
+                off += s;
+                continue;
+            }
+            if(s < 0 && errno == EINTR) continue;
+            if(s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if(off > 0) d.mid_line = d.pending[off - 1] != '\n';
+            d.pending.erase(0, off);
+            std::cerr << "influx_sender: send failed for " << d.c.name
+                      << ": " << std::strerror(errno) << ", reconnecting\n";
+            disconnect(d);
+            return;
+        }
+        if(off > 0) d.mid_line = d.pending[off - 1] != '\n';
+        d.pending.erase(0, off);
+    }
+
+    void flush_locked()
+    {
+        close_datagram();
+        send_datagrams(udp_fd, udp_dests);
+        send_datagrams(unix_fd, unix_dests);
+        for(auto &d: stream_dests)
+        {
+            if(d.pending.size() + batch.size() <= (size_t)cfg.tcp_buffer_bytes)
+            {
+                d.pending += batch;
+                d.dropping = false;
+            }
+            else if(!d.dropping)
+            {
+                std::cerr << "influx_sender: " << d.c.name << " is not keeping up, dropping lines\n";
+                d.dropping = true;
+            }
+            service_stream(d);
+        }
+        batch.clear();
+        datagram_ends.clear();
+        datagram_start = 0;
     }
 };
 
@@ -55,19 +229,18 @@ influx_sender::~influx_sender()
 {
     if(pimpl)
     {
-        for(auto &d: pimpl->destinations) if(d.fd != -1) close(d.fd);
+        {
+            std::lock_guard<std::mutex> lk(pimpl->mtx);
+            pimpl->flush_locked();
+        }
+        if(pimpl->udp_fd != -1) close(pimpl->udp_fd);
+        if(pimpl->unix_fd != -1) close(pimpl->unix_fd);
+        for(auto &d: pimpl->stream_dests) if(d.fd != -1) close(d.fd);
         delete pimpl;
         pimpl = nullptr;
     }
 }
 
-static int set_nonblocking(int fd)
-{
-    int flags = fcntl(fd, F_GETFL, 0);
-    if(flags == -1) return -1;
-    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-}
-
 bool influx_sender::init(const monitoring_config &cfg)
 {
     pimpl = new impl();
@@ -75,48 +248,59 @@ bool influx_sender::init(const monitoring_config &cfg)
 
     for(const auto &out: cfg.outputs)
     {
-        impl::dest d;
-        d.c = out;
         if(out.type == "udp" || out.type == "tcp")
         {
-            int fd = socket(AF_INET, out.type=="udp"?SOCK_DGRAM:SOCK_STREAM, 0);
-            if(fd < 0)
-            {
-                std::cerr << "influx_sender: failed to create socket for " << out.name << "\n";
-                continue;
-            }
-            set_nonblocking(fd);
             sockaddr_in sa{};
             sa.sin_family = AF_INET;
             sa.sin_port = htons(out.port);
             inet_pton(AF_INET, out.address.c_str(), &sa.sin_addr);
-            d.addr_len = sizeof(sa);
-            memcpy(&d.addr, &sa, sizeof(sa));
-            d.fd = fd;
-            d.stream = out.type=="tcp";
-            if(d.stream)
+            if(out.type == "tcp")
+            {
+                impl::stream_dest d;
+                d.c = out;
+                d.addr = sa;
+                d.retry_at = std::chrono::steady_clock::now();
+                pimpl->stream_dests.push_back(d);
+                pimpl->service_stream(pimpl->stream_dests.back());
+                continue;
+            }
+            if(pimpl->udp_fd == -1)
             {
-                connect(fd, (sockaddr*)&sa, d.addr_len);
+                pimpl->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+                if(pimpl->udp_fd < 0)
+                {
+                    std::cerr << "influx_sender: failed to create socket for " << out.name << "\n";
+                    pimpl->udp_fd = -1;
+                    continue;
+                }
             }
+            impl::datagram_dest d;
+            d.c = out;
+            d.addr_len = sizeof(sa);
+            memcpy(&d.addr, &sa, sizeof(sa));
+            pimpl->udp_dests.push_back(d);
         }
         else if(out.type == "unix")
         {
-            int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-            if(fd < 0)
+            if(pimpl->unix_fd == -1)
             {
-                std::cerr << "influx_sender: failed to create unix socket for " << out.name << "\n";
-                continue;
+                pimpl->unix_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+                if(pimpl->unix_fd < 0)
+                {
+                    std::cerr << "influx_sender: failed to create unix socket for " << out.name << "\n";
+                    pimpl->unix_fd = -1;
+                    continue;
+                }
             }
-            set_nonblocking(fd);
             sockaddr_un sa{};
             sa.sun_family = AF_UNIX;
             strncpy(sa.sun_path, out.address.c_str(), sizeof(sa.sun_path)-1);
+            impl::datagram_dest d;
+            d.c = out;
             d.addr_len = sizeof(sa);
             memcpy(&d.addr, &sa, sizeof(sa));
-            d.fd = fd;
-            d.stream = false;
+            pimpl->unix_dests.push_back(d);
         }
-        pimpl->destinations.push_back(std::move(d));
     }
 
     return true;
@@ -126,6 +310,16 @@ void influx_sender::send_line(const std::string &line)
 {
     if(!pimpl) return;
     std::lock_guard<std::mutex> lk(pimpl->mtx);
-    const std::string payload = line + "\n";
-    for(const auto &d: pimpl->destinations) pimpl->send_to_destination(d, payload);
+    impl &p = *pimpl;
+    if(p.batch.size() - p.datagram_start + line.size() + 1 > (size_t)p.cfg.udp_payload_bytes) p.close_datagram();
+    p.batch += line;
+    p.batch += '\n';
+    if(p.datagram_ends.size() >= INFLUX_MAX_BATCH_DATAGRAMS) p.flush_locked();
+}
+
+void influx_sender::flush()
+{
+    if(!pimpl) return;
+    std::lock_guard<std::mutex> lk(pimpl->mtx);
+    pimpl->flush_locked();
 }
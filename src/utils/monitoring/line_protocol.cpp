@@ -0,0 +1,61 @@
+#include "utils/monitoring/line_protocol.h"
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+// Digits of v, most significant first; returns the count.
+int write_digits(char *buf, std::uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    do
+    {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while(v);
+    for(int i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+    return n;
+}
+}
+
+void lp_append_fixed6(std::string &out, double value)
+{
+    // Above 2^53 / 1e6 the scaled value loses integer precision, let printf handle it
+    if(!std::isfinite(value) || std::fabs(value) >= 9.0e9)
+    {
+        char buf[352];
+        int n = std::snprintf(buf, sizeof(buf), "%.6f", value);
+        if(n > 0) out.append(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+        return;
+    }
+
+    const std::uint64_t scaled = (std::uint64_t)std::llround(std::fabs(value) * 1e6);
+    char buf[32];
+    int n = 0;
+    if(std::signbit(value)) buf[n++] = '-';
+    n += write_digits(buf + n, scaled / 1000000);
+    buf[n++] = '.';
+    std::uint64_t frac = scaled % 1000000;
+    for(int i = 5; i >= 0; i--)
+    {
+        buf[n + i] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    n += 6;
+    out.append(buf, n);
+}
+
+void lp_append_int(std::string &out, std::int64_t value)
+{
+    char buf[24];
+    int n = 0;
+    std::uint64_t v = (std::uint64_t)value;
+    if(value < 0)
+    {
+        buf[n++] = '-';
+        v = 0 - v;
+    }
+    n += write_digits(buf + n, v);
+    out.append(buf, n);
+}
@@ -18,8 +18,9 @@ bool monitoring_manager::init(const monitoring_config &c)
     if(!cfg.enabled) return false;
 
     sender.init(cfg);
-    ag.init(cfg);
     ag.set_emit_callback([this](const std::string &line){ sender.send_line(line); });
+    ag.set_flush_callback([this](){ sender.flush(); });
+    ag.init(cfg);
     return true;
 }
 
@@ -39,18 +40,82 @@ void monitoring_manager::publish(const metric_point &point)
     metric_point effective_point = point;
     const std::int64_t slot_ts = slot_timestamp_ns.load();
     if(slot_ts > 0) effective_point.ts_ns = slot_ts;
-    if(effective_point.ts_ns <= 0)
-    {
-        effective_point.ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count();
-    }
+    if(effective_point.ts_ns <= 0) effective_point.ts_ns = publish_ts_ns();
     ag.add_point(effective_point);
 }
 
+//--------------------------------------------------------------------------------------------------
+// register_series(): declares one series (measurement + fixed tag values) and its field list up front.
+// Returns the id to pass to publish(series_id, values), or -1 when monitoring is disabled.
+//--------------------------------------------------------------------------------------------------
+int monitoring_manager::register_series(const std::string &measurement, const std::map<std::string,std::string> &tags,
+                                        const std::vector<metric_field_spec> &fields)
+{
+    if(!cfg.enabled) return -1;
+    return ag.register_series(measurement, tags, fields);
+}
+
+//--------------------------------------------------------------------------------------------------
+// publish(): fast path of the slot thread. values holds one entry per registered field, in
+// registration order; nothing is allocated or formatted here.
+//--------------------------------------------------------------------------------------------------
+void monitoring_manager::publish(int series_id, const double *values)
+{
+    if(!cfg.enabled || series_id < 0) return;
+    ag.add_values(series_id, values, publish_ts_ns());
+}
+
+//--------------------------------------------------------------------------------------------------
+// publish(): closes the sample just visited into window and, once the aggregator has flushed a window
+// since the last hand-over, hands the accumulated samples over and restarts the window. Samples thus
+// reach the output one aggregation window later, but the slot thread only pays the hand-over once per
+// window.
+//--------------------------------------------------------------------------------------------------
+void monitoring_manager::publish(metric_window &window)
+{
+    window.end_sample();
+    if(!cfg.enabled || window.id() < 0) return;
+    const unsigned current = ag.window_index();
+    if(current == window.handed_over_window()) return;
+    ag.add_window(window.id(), window.sum_values(), window.last_values(), window.sample_count(), publish_ts_ns());
+    window.reset(current);
+}
+
+//--------------------------------------------------------------------------------------------------
+// hand_over(): hands the samples of window over right away, whatever the aggregator window. Used at
+// shutdown for the windows still open, which publish() would only hand over after the next flush.
+//--------------------------------------------------------------------------------------------------
+void monitoring_manager::hand_over(metric_window &window)
+{
+    if(!cfg.enabled || window.id() < 0 || window.sample_count() == 0) return;
+    ag.add_window(window.id(), window.sum_values(), window.last_values(), window.sample_count(), publish_ts_ns());
+    window.reset(ag.window_index());
+}
+
+//--------------------------------------------------------------------------------------------------
+// stop(): stops the aggregator, which flushes the window in progress. Call it after the publishers
+// have handed over their last windows; lines published afterwards are lost.
+//--------------------------------------------------------------------------------------------------
+void monitoring_manager::stop()
+{
+    if(!cfg.enabled) return;
+    ag.stop();
+}
+
+std::int64_t monitoring_manager::publish_ts_ns() const
+{
+    const std::int64_t slot_ts = slot_timestamp_ns.load();
+    if(slot_ts > 0) return slot_ts;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 void monitoring_manager::send_text_line(const std::string &line)
 {
     if(!cfg.enabled || !cfg.emit_text_logs_compat) return;
+    // Text lines are not tied to aggregation windows, send them right away
     sender.send_line(line);
+    sender.flush();
 }
 
 void monitoring_manager::set_slot_timestamp_ns(std::int64_t ts_ns)
@@ -0,0 +1,246 @@
+/**********************************************
+* Copyright 2022 Nokia
+* Licensed under the BSD 3-Clause Clear License
+* SPDX-License-Identifier: BSD-3-Clause-Clear
+**********************************************/
+
+#include <utils/terminal_logging.h>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+std::string suppressed_note(uint64_t n, const char *tag, const char *where)
+{
+    std::string note = "[WARNING][terminal_logging]: last [";
+    note += tag;
+    note += "]";
+    if(where != nullptr)
+    {
+        note += "[";
+        note += where;
+        note += "]";
+    }
+    return note + " line repeated " + std::to_string(n) + " more times\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+// terminal_writer: the thread writing the LOG_* lines to stdout. Logging threads append complete
+// lines to one bounded buffer under a short lock; the writer swaps it out and writes it in one call.
+// It is never destroyed: at exit it writes what is left and later lines are written directly.
+//--------------------------------------------------------------------------------------------------
+class terminal_writer
+{
+public:
+    static terminal_writer &instance()
+    {
+        static terminal_writer *w = new terminal_writer();
+        return *w;
+    }
+
+    void enqueue(const std::string &line)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        if(stopped)
+        {
+            std::cout.write(line.data(), line.size());
+            std::cout.flush();
+            return;
+        }
+        if(pending.size() + line.size() > TERMINAL_LOG_QUEUE_BYTES)
+        {
+            dropped++;
+            return;
+        }
+        pending += line;
+    }
+
+    // Remembers a site that suppressed lines, so its count is not lost if it never logs again.
+    void watch(terminal_site *site, const char *tag, const char *where)
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        watched.push_back(watched_site{site, tag, where});
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        pending += take_suppressed();
+        const uint64_t target = enqueued_epoch();
+        cv.wait(lk, [&]() { return stopped || written >= target; });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if(stopped) return;
+            pending += take_suppressed();
+            stopping = true;
+        }
+        writer.join();
+    }
+
+private:
+    terminal_writer()
+    {
+        colors = isatty(STDOUT_FILENO);
+        pending.reserve(64 << 10);
+        writer = std::thread(&terminal_writer::writer_loop, this);
+        std::atexit([]() { terminal_writer::instance().stop(); });
+    }
+
+    // Notes for the counts suppressed since each watched site last printed; called with mtx held.
+    std::string take_suppressed()
+    {
+        std::string notes;
+        for(size_t i = 0; i < watched.size(); i++)
+        {
+            const uint64_t n = watched[i].site->suppressed.exchange(0, std::memory_order_relaxed);
+            if(n > 0) notes += suppressed_note(n, watched[i].tag, watched[i].where);
+        }
+        return notes;
+    }
+
+    // Number of swaps needed for everything queued so far to be written
+    uint64_t enqueued_epoch() const { return pending.empty() ? swaps : swaps + 1; }
+
+    void writer_loop()
+    {
+        std::string out;
+        out.reserve(64 << 10);
+        while(true)
+        {
+            uint64_t lost;
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                out.swap(pending);
+                if(!out.empty()) swaps++;
+                lost = dropped;
+                dropped = 0;
+                stop = stopping;
+            }
+            if(lost > 0) out += "[WARNING][terminal_logging]: " + std::to_string(lost) + " lines dropped\n";
+            if(!out.empty())
+            {
+                if(!colors) strip_colors(out);
+                std::cout.write(out.data(), out.size());
+                std::cout.flush();
+                out.clear();
+            }
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                written = swaps;
+                if(stop && pending.empty()) stopped = true;
+            }
+            cv.notify_all();
+            if(stopped) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    static void strip_colors(std::string &s)
+    {
+        size_t w = 0;
+        for(size_t r = 0; r < s.size(); r++)
+        {
+            if(s[r] == '\033')
+            {
+                while(r < s.size() && s[r] != 'm') r++;
+                continue;
+            }
+            s[w++] = s[r];
+        }
+        s.resize(w);
+    }
+
+private:
+    struct watched_site
+    {
+        terminal_site *site;
+        const char *tag;
+        const char *where;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<watched_site> watched;
+    std::string pending;
+    uint64_t dropped = 0;
+    uint64_t swaps = 0;
+    uint64_t written = 0;
+    bool stopping = false;
+    bool stopped = false; // Guarded by mtx like the rest, read by the writer after its last pass
+    bool colors = true;
+    std::thread writer;
+};
+
+thread_local std::ostringstream line_stream;
+thread_local bool line_stream_busy = false;
+}
+
+terminal_line::terminal_line(terminal_site &_site, const char *color, const char *_tag, const char *_where)
+    : site(_site), tag(_tag), where(_where)
+{
+    const uint64_t now_ms = ms_since_start();
+    window = now_ms / 1000;
+    if(line_stream_busy)
+    {
+        owned = new std::ostringstream();
+        out = owned;
+    }
+    else
+    {
+        line_stream_busy = true;
+        line_stream.str(std::string());
+        line_stream.clear();
+        out = &line_stream;
+    }
+    *out << color << now_ms << " [" << tag << "]";
+    if(where != nullptr) *out << "[" << where << "]";
+    *out << ": ";
+    text_start = (size_t)out->tellp();
+}
+
+//--------------------------------------------------------------------------------------------------
+// ~terminal_line(): queues the line unless it repeats the previous line of its site more than
+// TERMINAL_LOG_RATE times in the current second. Lines are told apart by a hash of the message,
+// without the timestamp.
+//--------------------------------------------------------------------------------------------------
+terminal_line::~terminal_line()
+{
+    std::string line = out->str();
+    if(owned != nullptr) delete owned;
+    else line_stream_busy = false;
+
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for(size_t i = text_start; i < line.size(); i++) hash = (hash ^ (uint8_t)line[i]) * 1099511628211ULL;
+
+    uint64_t current = site.window_s.load(std::memory_order_relaxed);
+    if(window != current && site.window_s.compare_exchange_strong(current, window, std::memory_order_relaxed))
+        site.repeats.store(0, std::memory_order_relaxed);
+    if(site.last_hash.exchange(hash, std::memory_order_relaxed) != hash)
+        site.repeats.store(0, std::memory_order_relaxed);
+    if(site.repeats.fetch_add(1, std::memory_order_relaxed) >= TERMINAL_LOG_RATE)
+    {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        if(!site.watched.exchange(true)) terminal_writer::instance().watch(&site, tag, where);
+        return;
+    }
+
+    const uint64_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if(suppressed > 0) line.insert(0, suppressed_note(suppressed, tag, where));
+    line += RESET;
+    line += "\n";
+    terminal_writer::instance().enqueue(line);
+}
+
+void terminal_flush()
+{
+    terminal_writer::instance().flush();
+}
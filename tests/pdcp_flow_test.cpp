@@ -1,21 +1,54 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <linux/if_packet.h>
+
 #include <common/direction.h>
 #include <mac_layer/harq_handler.h>
+#include <netfilter/packet_mmap_capture.h>
 #include <netfilter/pkt_capture.h>
+#include <netfilter/pkt_capture_group.h>
+#include <netfilter/synthetic_capture.h>
 #include <pdcp_layer/captured_packet_handler.h>
 #include <pdcp_layer/ip_buffer.h>
 #include <pdcp_layer/packet_handler.h>
 #include <pdcp_layer/pdcp_layer.h>
+#include <pdcp_layer/release_wheel.h>
 #include <pdcp_layer/simulated_packet_handler.h>
 #include <simulator/configuration_loader.h>
 #include <traffic_models/traffic_config.h>
+#include <utils/logging/binary_recorder.h>
+#include <utils/logging/log_writer.h>
+#include <utils/monitoring/health_endpoint.h>
+#include <utils/terminal_logging.h>
+#include <utils/monitoring/aggregator.h>
+#include <utils/monitoring/influx_sender.h>
+#include <utils/monitoring/line_protocol.h>
+#include <nlohmann/json.hpp>
+#include <utils/monitoring/metric_window.h>
+#include <utils/spsc_ring.h>
 
 namespace
 {
@@ -51,6 +84,10 @@ public:
         }
         original_ecns.erase(pkt_id);
     }
+    void flush_verdicts() override
+    {
+        flushed_verdicts = verdicts.size();
+    }
     packet_capture_stats stats() const override
     {
         packet_capture_stats out;
@@ -59,21 +96,29 @@ public:
         return out;
     }
 
-    void capture(uint64_t size_bytes, uint32_t id, uint8_t ecn = ECN_NOT_ECT, std::vector<uint8_t> payload = std::vector<uint8_t>())
+    void capture(uint64_t size_bytes, uint32_t id, uint8_t ecn = ECN_NOT_ECT, std::vector<uint8_t> payload = std::vector<uint8_t>(), uint64_t arrival_us = 0)
     {
         captured_packet_info info;
         info.bytes = size_bytes;
         info.pkt_id = id;
         info.ecn = ecn;
+        info.arrival_us = arrival_us;
         payloads[id] = payload;
         original_ecns[id] = ecn;
-        enqueue_captured_packet(info, std::move(payload), ecn);
+        enqueue_captured_packet(info, payload.data(), (uint32_t)payload.size());
+    }
+
+    void capture(const captured_packet_info& info)
+    {
+        original_ecns[info.pkt_id] = info.ecn;
+        enqueue_captured_packet(info, nullptr, 0);
     }
 
     std::vector<int> released;
     std::vector<int> dropped;
     std::vector<std::vector<uint8_t> > released_payloads;
     std::vector<std::pair<uint32_t, packet_capture_action>> verdicts;
+    size_t flushed_verdicts = 0;
 
 private:
     std::unordered_map<uint32_t, std::vector<uint8_t>> payloads;
@@ -87,6 +132,36 @@ public:
     float ingest(int, float) override { return 0.0f; }
 };
 
+// packet_mmap_capture without sockets: frames are fed to handle_frame() directly and verdicts land
+// in a two frame TX ring on the heap.
+class test_packet_mmap_capture : public packet_mmap_capture
+{
+public:
+    test_packet_mmap_capture() : packet_mmap_capture("fk_in", "fk_out"), tx_ring(2 * PACKET_MMAP_FRAME_SIZE, 0)
+    {
+        use_tx_ring(tx_ring.data(), tx_ring.size());
+    }
+    ~test_packet_mmap_capture() override
+    {
+        use_tx_ring(nullptr, 0);
+    }
+
+    using packet_mmap_capture::handle_frame;
+    using packet_mmap_capture::stored_bytes;
+
+    const tpacket2_hdr* tx_hdr(int frame) const
+    {
+        return (const tpacket2_hdr*)(tx_ring.data() + (size_t)frame * PACKET_MMAP_FRAME_SIZE);
+    }
+    const uint8_t* tx_data(int frame) const
+    {
+        return tx_ring.data() + (size_t)frame * PACKET_MMAP_FRAME_SIZE + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    }
+
+private:
+    std::vector<uint8_t> tx_ring;
+};
+
 bool near(float lhs, float rhs)
 {
     return std::fabs(lhs - rhs) < 0.001f;
@@ -104,6 +179,33 @@ std::vector<uint8_t> make_ipv4_payload(uint8_t ecn)
     return payload;
 }
 
+// Ethernet frame carrying an IPv4/UDP packet with a valid header checksum and payload_len bytes.
+std::vector<uint8_t> make_ipv4_frame(uint8_t ecn, uint16_t payload_len)
+{
+    std::vector<uint8_t> frame(14, 0);
+    frame[12] = 0x08;
+    std::vector<uint8_t> ip = make_ipv4_payload(ecn);
+    uint16_t total = (uint16_t)(ip.size() + payload_len);
+    ip[2] = (uint8_t)(total >> 8);
+    ip[3] = (uint8_t)(total & 0xff);
+    uint32_t sum = 0;
+    for(size_t i = 0; i < ip.size(); i += 2) sum += ((uint32_t)ip[i] << 8) | ip[i + 1];
+    while(sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    ip[10] = (uint8_t)(~sum >> 8);
+    ip[11] = (uint8_t)(~sum & 0xff);
+    frame.insert(frame.end(), ip.begin(), ip.end());
+    for(uint16_t i = 0; i < payload_len; i++) frame.push_back((uint8_t)i);
+    return frame;
+}
+
+bool ipv4_header_checksum_ok(const uint8_t* ip)
+{
+    uint32_t sum = 0;
+    for(int i = 0; i < 20; i += 2) sum += ((uint32_t)ip[i] << 8) | ip[i + 1];
+    while(sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return sum == 0xffff;
+}
+
 packet_handler_config make_sim_config(pdcp_config pdcp_c, traffic_config traffic)
 {
     packet_handler_config cfg;
@@ -240,6 +342,102 @@ void test_harq_and_packet_handlers()
     assert(status.final_accept_packets == 0);
 }
 
+void test_spsc_ring_handoff()
+{
+    spsc_ring<uint32_t> ring(3);
+    assert(ring.capacity() == 4);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        uint32_t *slot = ring.claim();
+        assert(slot != nullptr);
+        *slot = i;
+        ring.publish();
+    }
+    assert(ring.claim() == nullptr);
+    assert(*ring.front() == 0);
+    ring.pop();
+    assert(ring.claim() != nullptr);
+
+    // Wrap many times with a concurrent producer, order has to be kept.
+    spsc_ring<uint32_t> shared(64);
+    const uint32_t total = 200000;
+    std::thread producer([&shared, total]() {
+        for(uint32_t i = 0; i < total; i++)
+        {
+            uint32_t *slot;
+            while((slot = shared.claim()) == nullptr) std::this_thread::yield();
+            *slot = i;
+            shared.publish();
+        }
+    });
+    for(uint32_t expected = 0; expected < total; expected++)
+    {
+        uint32_t *slot;
+        while((slot = shared.front()) == nullptr) std::this_thread::yield();
+        assert(*slot == expected);
+        shared.pop();
+    }
+    producer.join();
+    assert(shared.size() == 0);
+}
+
+void test_release_wheel_jittered_release()
+{
+    release_wheel wheel;
+    const float t_outs[] = {0.5f, 0.0001f, 3.0f, 0.04f, 0.00021f, 0.0002f, 5.0f};
+    for(int i = 0; i < 7; ++i)
+    {
+        harq_pkt pkt(i, 0.0f, 0.0f, 0, 0, 100.0f, 0.0f, 0.0f);
+        pkt.t_out = t_outs[i];
+        wheel.push(std::move(pkt));
+    }
+    assert(wheel.size() == 7);
+
+    harq_pkt out;
+    assert(!wheel.pop_due(0.00005f, out));
+    assert(wheel.pop_due(0.0002f, out));
+    assert(out.id == 1 || out.id == 5);
+    assert(wheel.pop_due(0.0002f, out));
+    assert(out.id == 1 || out.id == 5);
+    assert(!wheel.pop_due(0.0002f, out));
+    assert(wheel.pop_due(0.00021f, out) && out.id == 4);
+    assert(!wheel.pop_due(0.039f, out));
+    assert(wheel.pop_due(0.45f, out) && out.id == 3);
+    assert(!wheel.pop_due(0.45f, out));
+    assert(wheel.pop_due(2.9f, out) && out.id == 0);
+    assert(!wheel.pop_due(2.9f, out));
+    assert(wheel.peek_next() != nullptr && wheel.peek_next()->t_out > 2.9f);
+    assert(wheel.pop_due(3.0f, out) && out.id == 2);
+    assert(wheel.size() == 1);
+    assert(wheel.pop_due(10.0f, out) && out.id == 6);
+    assert(wheel.empty());
+    assert(wheel.peek_next() == nullptr);
+}
+
+void test_release_wheel_oldest_by_ip_t()
+{
+    release_wheel wheel;
+    const float ip_ts[] = {0.3f, 0.1f, 0.2f};
+    const float t_outs[] = {0.31f, 0.5f, 0.32f};
+    for(int i = 0; i < 3; ++i)
+    {
+        harq_pkt pkt(i, ip_ts[i], ip_ts[i], 0, 0, 100.0f, 0.0f, 0.0f);
+        pkt.t_out = t_outs[i];
+        wheel.push(std::move(pkt));
+    }
+
+    int id = -1;
+    float ip_t = -1.0f;
+    assert(wheel.peek_next()->id == 0);
+    assert(wheel.peek_oldest(id, ip_t) && id == 1 && ip_t == 0.1f);
+
+    harq_pkt out;
+    while(wheel.pop_due(0.4f, out)) {}
+    assert(wheel.peek_oldest(id, ip_t) && id == 1);
+    assert(wheel.pop_due(0.5f, out) && out.id == 1);
+    assert(!wheel.peek_oldest(id, ip_t));
+}
+
 void test_harq_timeout_drop()
 {
     harq_handler harq(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0);
@@ -292,6 +490,7 @@ void test_captured_packet_handler_release()
     assert(near(handler.release(), 2000.0f));
     assert(fake_ptr->released.size() == 1);
     assert(fake_ptr->released.front() == 42);
+    assert(fake_ptr->flushed_verdicts == 1);
     pdcp_queue_status status;
     handler.fill_queue_status(status, 0.0f);
     assert(status.final_accept_packets == 1);
@@ -327,6 +526,385 @@ void test_captured_packet_handler_timeout_drop()
     assert(status.final_drop_packets == 1);
 }
 
+void test_captured_packet_handler_uses_arrival_timestamps()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    std::unique_ptr<fake_packet_capture> fake(new fake_packet_capture(81));
+    fake_packet_capture *fake_ptr = fake.get();
+    std::unique_ptr<pkt_capture> capture(std::move(fake));
+    // Emulator clock started 2 s ago
+    std::chrono::microseconds init_t = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()) - std::chrono::microseconds(2000000);
+    captured_packet_handler handler(std::move(capture), &init_t, config, 1);
+
+    handler.init();
+    uint64_t start_us = (uint64_t)init_t.count();
+    fake_ptr->capture(100, 60, ECN_NOT_ECT, std::vector<uint8_t>(), start_us + 500000);
+    fake_ptr->capture(100, 61, ECN_NOT_ECT, std::vector<uint8_t>(), start_us + 1500000);
+    fake_ptr->capture(100, 62);
+    // Monotonic clock timestamps: before the emulator start, and far in its future
+    fake_ptr->capture(100, 63, ECN_NOT_ECT, std::vector<uint8_t>(), 5000000);
+    fake_ptr->capture(100, 64, ECN_NOT_ECT, std::vector<uint8_t>(), start_us + 3600000000ULL);
+    handler.step(2.0f);
+    handler.ingest(TX_DL, 2.0f);
+
+    std::vector<ip_pkt> pkts;
+    while(handler.has_ingress_pkts()) pkts.push_back(handler.pop_ingress_pkt());
+    assert(pkts.size() == 5);
+    assert(std::fabs(pkts[0].ip_t - 0.5f) < 0.001f);
+    assert(std::fabs(pkts[1].ip_t - 1.5f) < 0.001f);
+    // No timestamp, or one on another clock: arrives at ingest time
+    assert(pkts[2].ip_t >= 2.0f);
+    assert(pkts[3].ip_t >= 2.0f);
+    assert(pkts[4].ip_t >= 2.0f);
+
+    pdcp_queue_status status;
+    handler.fill_queue_status(status, 2.0f);
+    assert(status.capture_delay_packets == 5);
+    assert(status.capture_delay_max_s >= 1.5f && status.capture_delay_max_s < 1.6f);
+    assert(status.capture_clock_mismatches == 2);
+}
+
+void test_captured_packet_handler_accounts_gso_segments()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    std::unique_ptr<fake_packet_capture> fake(new fake_packet_capture(82));
+    fake_packet_capture *fake_ptr = fake.get();
+    std::unique_ptr<pkt_capture> capture(std::move(fake));
+    captured_packet_handler handler(std::move(capture), nullptr, config, 1);
+
+    handler.init();
+    // 4 segments of 1448 bytes behind a 52 byte IP+TCP header
+    captured_packet_info info;
+    info.pkt_id = 70;
+    info.bytes = 52 + 4 * 1448;
+    info.gso = true;
+    info.segments = 4;
+    info.segment_hdr_bytes = 52;
+    fake_ptr->capture(info);
+    handler.step(0.0f);
+    assert(near(handler.ingest(TX_DL, 0.0f), (float)(4 * (52 + 1448) * 8)));
+
+    ip_pkt pkt = handler.pop_ingress_pkt();
+    assert(pkt.pkt_count == 4);
+    assert(near(pkt.size, (float)(4 * (52 + 1448) * 8)));
+
+    harq_pkt harq(50, 0.0f, 0.0f, 0, 0, pkt.size, 0.0f, 0.0f);
+    harq.pkts.push_back(pkt);
+    handler.push(std::move(harq));
+    assert(near(handler.release(), pkt.size));
+    pdcp_queue_status status;
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_accept_packets == 4);
+}
+
+void test_captured_gso_overflow_stays_whole()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    std::unique_ptr<fake_packet_capture> fake(new fake_packet_capture(83));
+    fake_packet_capture *fake_ptr = fake.get();
+    std::unique_ptr<pkt_capture> capture(std::move(fake));
+    captured_packet_handler handler(std::move(capture), nullptr, config, 1);
+
+    handler.init();
+    captured_packet_info info;
+    info.pkt_id = 71;
+    info.bytes = 52 + 4 * 1448;
+    info.gso = true;
+    info.segments = 4;
+    info.segment_hdr_bytes = 52;
+    fake_ptr->capture(info);
+    handler.step(0.0f);
+    handler.ingest(TX_DL, 0.0f);
+    ip_pkt pkt = handler.pop_ingress_pkt();
+    assert(pkt.pkt_count == 4);
+
+    // 30720 bits left: two of the four segments would fit, but the GSO packet is one skb with one
+    // verdict, so it is not split and is dropped whole, once
+    ip_buffer full(1);
+    full.step(0.0f);
+    assert(full.add_pkt(ip_pkt(0.0f, 1.0e10f, 1.0e10f, 1, 0.0f, 0.0f)));
+    assert(full.add_pkt(ip_pkt(0.0f, 479969280.0f, 479969280.0f, 2, 0.0f, 0.0f)));
+    ip_pkt probe(pkt);
+    ip_pkt rejected(pkt);
+    assert(full.split_burst(probe, rejected));
+    assert(!handler.splits_bursts());
+    assert(!full.add_pkt(pkt));
+    handler.drop_ingress_pkt(pkt);
+    handler.step(0.001f);
+    handler.release();
+    assert(fake_ptr->dropped.size() == 1 && fake_ptr->dropped.front() == 71);
+    assert(fake_ptr->released.empty());
+
+    traffic_config traffic(CONSTANT_TRAFFIC_MODEL, 1.0f, 1.0f, "", "", 0.0f, 1000, 0.0f, 0.0f);
+    assert(simulated_packet_handler(1, traffic, config, 1, true).splits_bursts());
+    assert(!simulated_packet_handler(1, traffic, config, 1, false).splits_bursts());
+}
+
+void test_pkt_capture_group_merges_queues()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    fake_packet_capture *q0 = new fake_packet_capture(90);
+    fake_packet_capture *q1 = new fake_packet_capture(91);
+    std::vector<std::unique_ptr<pkt_capture>> members;
+    members.emplace_back(q0);
+    members.emplace_back(q1);
+    std::unique_ptr<pkt_capture> capture(new pkt_capture_group(std::move(members)));
+    captured_packet_handler handler(std::move(capture), nullptr, config, 1);
+
+    handler.init();
+    // Both queues number their packets from 1. q1 holds the first and last arrivals, so the merged
+    // order is q1, q0, q0, q1 rather than a plain alternation; sizes tell the packets apart.
+    q0->capture(200, 1, ECN_NOT_ECT, std::vector<uint8_t>(), 2000);
+    q0->capture(300, 2, ECN_NOT_ECT, std::vector<uint8_t>(), 3000);
+    q1->capture(100, 1, ECN_NOT_ECT, std::vector<uint8_t>(), 1000);
+    q1->capture(400, 2, ECN_NOT_ECT, std::vector<uint8_t>(), 4000);
+    handler.step(0.0f);
+    handler.ingest(TX_DL, 0.0f);
+
+    std::vector<ip_pkt> pkts;
+    while(handler.has_ingress_pkts()) pkts.push_back(handler.pop_ingress_pkt());
+    assert(pkts.size() == 4);
+    for(size_t i = 0; i < pkts.size(); i++)
+    {
+        assert(pkts[i].uid == (uint32_t)i);
+        assert(near(pkts[i].size, (i + 1) * 100 * 8.0f));
+    }
+
+    // Release one uid at a time: each verdict must reach the owning queue with that queue's id
+    fake_packet_capture *owner[4] = {q1, q0, q0, q1};
+    int owner_id[4] = {1, 1, 2, 2};
+    for(size_t i = 0; i < pkts.size(); i++)
+    {
+        size_t q0_before = q0->released.size();
+        size_t q1_before = q1->released.size();
+        harq_pkt harq(60 + (int)i, 0.0f, 0.0f, 0, 0, pkts[i].size, 0.0f, 0.0f);
+        harq.pkts.push_back(pkts[i]);
+        handler.push(std::move(harq));
+        assert(near(handler.release(), pkts[i].size));
+        fake_packet_capture *other = owner[i] == q0 ? q1 : q0;
+        assert(owner[i]->released.size() == (owner[i] == q0 ? q0_before : q1_before) + 1);
+        assert(other->released.size() == (other == q0 ? q0_before : q1_before));
+        assert(owner[i]->released.back() == owner_id[i]);
+    }
+    assert(q0->flushed_verdicts == 2 && q1->flushed_verdicts == 2);
+}
+
+void test_packet_mmap_capture_frames()
+{
+    test_packet_mmap_capture capture;
+    std::vector<uint8_t> frame = make_ipv4_frame(ECN_ECT0, 100);
+    const uint32_t len = (uint32_t)frame.size();
+
+    // Non IPv4 frames are forwarded at once (the pass through send() fails without a socket)
+    std::vector<uint8_t> arp(42, 0);
+    arp[12] = 0x08;
+    arp[13] = 0x06;
+    capture.handle_frame(arp.data(), (uint32_t)arp.size(), (uint32_t)arp.size(), 0);
+    assert(capture.captured_queue_size() == 0);
+    assert(capture.stats().total_recv == 0 && capture.stats().rlsd_fails == 1);
+
+    // A frame cut by the ring slot (GSO super-frame) is dropped, never captured
+    capture.handle_frame(frame.data(), len, len + 4000, 0);
+    assert(capture.captured_queue_size() == 0);
+    assert(capture.stats().gso_pkts == 1);
+
+    for(int i = 0; i < 4; i++) capture.handle_frame(frame.data(), len, len, 1000 + i);
+    assert(capture.captured_queue_size() == 4);
+    captured_packet_info info[4];
+    for(int i = 0; i < 4; i++)
+    {
+        assert(capture.pop_captured_packet(info[i]));
+        assert(info[i].pkt_id == (uint32_t)i);
+        assert(info[i].bytes == len - 14);
+        assert(info[i].ecn == ECN_ECT0);
+        assert(info[i].arrival_us == (uint64_t)(1000 + i));
+    }
+    assert(capture.stats().total_recv == 4 && capture.stats().bytes_recv == 4 * (len - 14));
+
+    // ACCEPT_CE: the frame goes out with CE set and a fixed header checksum, the rest untouched
+    capture.verdict(info[0].pkt_id, packet_capture_action::ACCEPT_CE);
+    assert(capture.tx_hdr(0)->tp_status == TP_STATUS_SEND_REQUEST);
+    assert(capture.tx_hdr(0)->tp_len == len);
+    const uint8_t *sent = capture.tx_data(0);
+    assert((sent[14 + 1] & 0x03) == ECN_CE);
+    assert(ipv4_header_checksum_ok(sent + 14));
+    for(uint32_t i = 0; i < len; i++)
+    {
+        if(i == 14 + 1 || i == 14 + 10 || i == 14 + 11) continue;
+        assert(sent[i] == frame[i]);
+    }
+
+    // DROP leaves the TX ring alone
+    capture.verdict(info[1].pkt_id, packet_capture_action::DROP);
+    assert(capture.tx_hdr(1)->tp_status == TP_STATUS_AVAILABLE);
+    assert(capture.stats().total_rlsd == 1);
+
+    capture.verdict(info[2].pkt_id, packet_capture_action::ACCEPT);
+    assert(capture.tx_hdr(1)->tp_status == TP_STATUS_SEND_REQUEST);
+    assert(memcmp(capture.tx_data(1), frame.data(), len) == 0);
+
+    // Both TX frames still wait for the kernel: the next accepted frame fails instead of overwriting
+    capture.verdict(info[3].pkt_id, packet_capture_action::ACCEPT);
+    assert(capture.stats().total_rlsd == 2);
+    assert(capture.stats().rlsd_fails == 2);
+    assert(memcmp(capture.tx_data(0) + 14 + 12, frame.data() + 14 + 12, len - 14 - 12) == 0);
+}
+
+void test_pkt_capture_slab_slot_reuse()
+{
+    test_packet_mmap_capture capture;
+    std::vector<uint8_t> frame = make_ipv4_frame(ECN_NOT_ECT, 100);
+    const uint32_t len = (uint32_t)frame.size();
+    const int first = PKT_CAPTURE_SLAB_CHUNK_SLOTS + 44;
+
+    // More frames than one slab chunk, each tagged in its IPv4 id field
+    captured_packet_info info;
+    for(int i = 0; i < first; i++)
+    {
+        frame[14 + 4] = (uint8_t)(i >> 8);
+        frame[14 + 5] = (uint8_t)i;
+        capture.handle_frame(frame.data(), len, len, 0);
+        assert(capture.pop_captured_packet(info));
+    }
+
+    // Dropped frames give their slots back to the receive side, which reuses them
+    for(int i = 0; i < 100; i++) capture.verdict((uint32_t)i, packet_capture_action::DROP);
+    for(int i = first; i < first + 100; i++)
+    {
+        frame[14 + 4] = (uint8_t)(i >> 8);
+        frame[14 + 5] = (uint8_t)i;
+        capture.handle_frame(frame.data(), len, len, 0);
+        assert(capture.pop_captured_packet(info));
+    }
+
+    for(int i = 100; i < first + 100; i++)
+    {
+        uint32_t stored_len = 0;
+        const uint8_t *stored = capture.stored_bytes((uint32_t)i, stored_len);
+        assert(stored != nullptr && stored_len == len);
+        assert(stored[14 + 4] == (uint8_t)(i >> 8) && stored[14 + 5] == (uint8_t)i);
+    }
+}
+
+void test_synthetic_capture_replays_trace()
+{
+    const char *text_path = "/tmp/fikore_synthetic_test.txt";
+    {
+        std::ofstream text(text_path);
+        text << "0E-9 214\n0.000015889 942\n0.000021370 1161\n";
+    }
+    const char *pcap_path = "/tmp/fikore_synthetic_test.pcap";
+    {
+        // Ethernet pcap with two records of 114 and 1514 bytes, 1 ms apart
+        std::ofstream pcap(pcap_path, std::ios::binary);
+        uint32_t global[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+        pcap.write((const char*)global, sizeof(global));
+        uint32_t lens[2] = {114, 1514};
+        for(uint32_t i = 0; i < 2; i++)
+        {
+            uint32_t rec[4] = {100, i * 1000, 14, lens[i]};
+            pcap.write((const char*)rec, sizeof(rec));
+            pcap.write("\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 14);
+        }
+    }
+
+    std::vector<synthetic_trace_pkt> trace;
+    assert(synthetic_capture::load_trace(pcap_path, trace));
+    assert(trace.size() == 2 && trace[0].bytes == 100 && trace[1].bytes == 1500);
+    assert(std::fabs(trace[1].t_s - 0.001) < 1e-9);
+
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    synthetic_capture *synthetic = new synthetic_capture(text_path, 0.0f, false, ECN_ECT1);
+    synthetic->keep_records(true);
+    std::unique_ptr<pkt_capture> capture(synthetic);
+    captured_packet_handler handler(std::move(capture), nullptr, config, 1);
+
+    handler.init();
+    while(!synthetic->finished()) std::this_thread::yield();
+    handler.step(0.0f);
+    assert(near(handler.ingest(TX_DL, 0.0f), (214 + 942 + 1161) * 8.0f));
+
+    harq_pkt harq(70, 0.0f, 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+    while(handler.has_ingress_pkts())
+    {
+        ip_pkt pkt = handler.pop_ingress_pkt();
+        assert(pkt.ecn == ECN_ECT1);
+        harq.pkts.push_back(pkt);
+    }
+    handler.push(std::move(harq));
+    handler.release();
+    assert(synthetic->accepted() == 3);
+    assert(synthetic->records().size() == 3 && synthetic->records()[2].pkt_id == 2);
+    assert(synthetic->stats().total_recv == 3);
+
+    // A restart replays the trace once more, not the trace loaded twice
+    synthetic_capture restarted(text_path, 0.0f, false);
+    restarted.start();
+    while(!restarted.finished()) std::this_thread::yield();
+    restarted.start();
+    while(!restarted.finished()) std::this_thread::yield();
+    assert(restarted.stats().total_recv == 6);
+
+    // A pcap header without records must not start a (looping) replay
+    {
+        std::ofstream pcap(pcap_path, std::ios::binary | std::ios::trunc);
+        uint32_t global[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+        pcap.write((const char*)global, sizeof(global));
+    }
+    synthetic_capture empty(pcap_path, 0.0f, true);
+    empty.start();
+    assert(empty.finished() && empty.stats().total_recv == 0);
+
+    std::remove(text_path);
+    std::remove(pcap_path);
+}
+
+void test_captured_packet_handler_reorders_by_uid()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    std::unique_ptr<fake_packet_capture> fake(new fake_packet_capture(80));
+    fake_packet_capture *fake_ptr = fake.get();
+    std::unique_ptr<pkt_capture> capture(std::move(fake));
+    captured_packet_handler handler(std::move(capture), nullptr, config, 1);
+
+    handler.init();
+    fake_ptr->capture(100, 50);
+    fake_ptr->capture(100, 51);
+    fake_ptr->capture(100, 52);
+    handler.step(0.0f);
+    handler.ingest(TX_DL, 0.0f);
+
+    std::vector<ip_pkt> pkts;
+    while(handler.has_ingress_pkts()) pkts.push_back(handler.pop_ingress_pkt());
+    assert(pkts.size() == 3);
+
+    harq_pkt first(40, 0.0f, 0.0f, 0, 0, pkts[0].size, 0.0f, 0.0f);
+    first.pkts.push_back(pkts[0]);
+    handler.push(std::move(first));
+    assert(near(handler.release(), 800.0f));
+
+    harq_pkt last(41, 0.0f, 0.0f, 0, 0, pkts[2].size, 0.0f, 0.0f);
+    last.pkts.push_back(pkts[2]);
+    handler.push(std::move(last));
+    assert(near(handler.release(), 0.0f));
+    assert(fake_ptr->verdicts.size() == 1);
+
+    harq_pkt middle(42, 0.0f, 0.0f, 0, 0, pkts[1].size, 0.0f, 0.0f);
+    middle.pkts.push_back(pkts[1]);
+    handler.drop(std::move(middle));
+    assert(near(handler.release(), 800.0f));
+    assert(fake_ptr->verdicts.size() == 3);
+    assert(fake_ptr->verdicts[0].first == 50);
+    assert(fake_ptr->verdicts[1].first == 51);
+    assert(fake_ptr->verdicts[1].second == packet_capture_action::DROP);
+    assert(fake_ptr->verdicts[2].first == 52);
+
+    pdcp_queue_status status;
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.release_size == 0);
+}
+
 void test_simulated_packet_handler_final_verdicts()
 {
     pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
@@ -383,6 +961,108 @@ void test_simulated_packet_handler_final_verdicts()
     assert(status.final_drop_packets == 1);
 }
 
+void test_simulated_packet_handler_fluid_bursts()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    traffic_config traffic(CONSTANT_TRAFFIC_MODEL, 1.0f, 1.0f, "", "", 0.0f, 1000, 0.0f, 0.0f);
+    simulated_packet_handler handler(1, traffic, config, 1, true);
+
+    float bits = 0.0f;
+    for(int i = 0; i < 10 && bits <= 1000.0f; ++i)
+    {
+        handler.step(i * 0.001f);
+        bits = handler.ingest(TX_DL, i * 0.001f);
+    }
+    assert(bits > 1000.0f);
+    assert(handler.has_ingress_pkts());
+    ip_pkt burst = handler.pop_ingress_pkt();
+    assert(!handler.has_ingress_pkts());
+    assert(near(burst.size, bits));
+    assert(burst.pkt_count == (uint32_t)ceil(bits / 1000.0f));
+
+    ip_buffer buffer(1);
+    buffer.step(0.0f);
+    buffer.add_pkt(burst);
+    harq_pkt first(30, buffer.get_oldest_timestamp(), 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+    buffer.get_pkts(bits / 2.0f, first);
+    handler.push(std::move(first));
+    handler.release();
+
+    pdcp_queue_status status;
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_accept_packets == 0);
+
+    harq_pkt second(31, buffer.get_oldest_timestamp(), 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+    buffer.get_pkts(bits, second);
+    handler.push(std::move(second));
+    handler.release();
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_accept_packets == (int)burst.pkt_count);
+}
+
+void test_simulated_packet_handler_fluid_partial_drop()
+{
+    pdcp_config config(4, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+    traffic_config traffic(CONSTANT_TRAFFIC_MODEL, 1.0f, 1.0f, "", "", 0.0f, 1000, 0.0f, 0.0f);
+    simulated_packet_handler handler(1, traffic, config, 1, true);
+
+    // A burst of 8 packets of 1000 bits sent in three TBs; HARQ loses the middle one, bits
+    // 2500-5500, which touches packets #2 to #5 as it would in per-packet mode
+    ip_pkt burst(0.0f, 8000.0f, 8000.0f, 0, 0.0f, 0.0f);
+    burst.pkt_count = 8;
+    ip_buffer buffer(1);
+    buffer.step(0.0f);
+    assert(buffer.add_pkt(burst));
+    harq_pkt tbs[3] = {harq_pkt(40, 0.0f, 0.0f, 0, 0, 0.0f, 0.0f, 0.0f),
+                       harq_pkt(41, 0.0f, 0.0f, 0, 0, 0.0f, 0.0f, 0.0f),
+                       harq_pkt(42, 0.0f, 0.0f, 0, 0, 0.0f, 0.0f, 0.0f)};
+    assert(near(buffer.get_pkts(2500.0f, tbs[0]), 2500.0f));
+    assert(near(buffer.get_pkts(3000.0f, tbs[1]), 3000.0f));
+    assert(near(buffer.get_pkts(2500.0f, tbs[2]), 2500.0f));
+    assert(!buffer.has_pkts());
+
+    handler.push(std::move(tbs[0]));
+    handler.drop(std::move(tbs[1]));
+    handler.push(std::move(tbs[2]));
+    handler.release();
+    pdcp_queue_status status;
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_drop_packets == 4);
+    assert(status.final_accept_packets == 4);
+
+    // Two lost fragments of packet #0 and one of packet #9 lose two packets, not three
+    ip_pkt spread(0.0f, 10000.0f, 10000.0f, 1, 0.0f, 0.0f);
+    spread.pkt_count = 10;
+    assert(buffer.add_pkt(spread));
+    const float cuts[4] = {300.0f, 300.0f, 8900.0f, 500.0f};
+    for(int i = 0; i < 4; i++)
+    {
+        harq_pkt tb(50 + i, 0.0f, 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+        assert(near(buffer.get_pkts(cuts[i], tb), cuts[i]));
+        if(i == 2) handler.push(std::move(tb));
+        else handler.drop(std::move(tb));
+    }
+    handler.release();
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_drop_packets == 4 + 2);
+    assert(status.final_accept_packets == 4 + 8);
+
+    // Buffer overflow only rejects the packets of a burst that do not fit
+    ip_buffer full(1);
+    full.step(0.0f);
+    assert(full.add_pkt(ip_pkt(0.0f, 1.0e10f, 1.0e10f, 1, 0.0f, 0.0f)));
+    ip_pkt big(0.0f, 1.0e9f, 1.0e9f, 2, 0.0f, 0.0f);
+    big.pkt_count = 10;
+    ip_pkt rejected(big);
+    assert(full.split_burst(big, rejected));
+    assert(big.pkt_count == 4 && rejected.pkt_count == 6);
+    assert(near(big.size + rejected.size, 1.0e9f));
+    assert(full.add_pkt(big));
+    handler.drop_ingress_pkt(rejected);
+    handler.fill_queue_status(status, 0.0f);
+    assert(status.final_drop_packets == 4 + 2 + 6);
+}
+
 void test_dualpi2_classification_and_ce_marking()
 {
     dualpi2_config l4s;
@@ -415,6 +1095,38 @@ void test_dualpi2_classification_and_ce_marking()
     assert(stats.classic_queue_size == 1);
 }
 
+void test_dualpi2_fragment_stays_at_head()
+{
+    dualpi2_config l4s;
+    l4s.enabled = true;
+    ip_buffer buffer(1);
+    buffer.configure_l4s(l4s);
+    buffer.step(0.0f);
+
+    for(int uid = 5; uid < 7; ++uid)
+    {
+        ip_pkt pkt(0.0f, 1000.0f, 1000.0f, uid, 0.0f, 0.0f);
+        pkt.ecn = ECN_ECT1;
+        pkt.original_ecn = ECN_ECT1;
+        assert(buffer.add_pkt(pkt));
+    }
+
+    harq_pkt first(12, buffer.get_oldest_timestamp(), 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+    assert(near(buffer.get_pkts(400.0f, first), 400.0f));
+    assert(first.pkts.size() == 1);
+    assert(first.pkts.front().uid == 5);
+    assert(first.pkts.front().is_fragment);
+    assert(buffer.size() == 2);
+
+    harq_pkt second(13, buffer.get_oldest_timestamp(), 0.0f, 0, 0, 0.0f, 0.0f, 0.0f);
+    assert(near(buffer.get_pkts(2000.0f, second), 1600.0f));
+    assert(second.pkts.size() == 2);
+    assert(second.pkts.front().uid == 5);
+    assert(near(second.pkts.front().size, 600.0f));
+    assert(second.pkts.back().uid == 6);
+    assert(!buffer.has_pkts());
+}
+
 void test_dualpi2_classic_drop_notification()
 {
     dualpi2_config l4s;
@@ -467,6 +1179,545 @@ void test_captured_packet_handler_rewrites_ecn_payload()
     assert(fake_ptr->verdicts.front().second == packet_capture_action::ACCEPT_CE);
     assert((fake_ptr->released_payloads.front()[1] & 0x03) == ECN_CE);
 }
+
+void test_aggregator_registered_series()
+{
+    aggregator ag;
+    std::mutex lines_mtx;
+    std::vector<std::string> lines;
+    ag.set_emit_callback([&](const std::string &line) {
+        std::lock_guard<std::mutex> lk(lines_mtx);
+        lines.push_back(line);
+    });
+
+    metric_schema schema;
+    schema("a_sum", field_aggregation::sum, 0);
+    schema("b_mean", field_aggregation::mean, 0);
+    schema("c_last", field_aggregation::last, 0);
+    const int series = ag.register_series("m", {{"ue_id", "3"}, {"tx_dir", "ul"}}, schema.fields);
+    const int idle = ag.register_series("m", {{"ue_id", "4"}}, schema.fields);
+    assert(series == 0 && idle == 1);
+
+    // Published before the flush thread starts, so both land in its first window
+    const double first[] = {1.0, 2.0, 3.0};
+    const double second[] = {2.0, 4.0, 5.0};
+    ag.add_values(series, first, 100);
+    ag.add_values(series, second, 200);
+    ag.add_values(7, first, 300); // Unknown ids are ignored
+
+    monitoring_config cfg;
+    cfg.aggregation_window_ms = 10;
+    ag.init(cfg);
+    for(int i = 0; i < 100; i++)
+    {
+        {
+            std::lock_guard<std::mutex> lk(lines_mtx);
+            if(!lines.empty()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    std::lock_guard<std::mutex> lk(lines_mtx);
+    assert(lines.size() == 1); // The idle series is not emitted
+    assert(lines.front() == "m,tx_dir=ul,ue_id=3 a_sum=3.000000,b_mean=3.000000,c_last=5.000000 200");
+}
+
+void test_aggregator_sharded_publishers()
+{
+    aggregator ag;
+    std::mutex lines_mtx;
+    std::vector<std::string> lines;
+    ag.set_emit_callback([&](const std::string &line) {
+        std::lock_guard<std::mutex> lk(lines_mtx);
+        lines.push_back(line);
+    });
+    monitoring_config cfg;
+    cfg.aggregation_window_ms = 1;
+    ag.init(cfg);
+
+    // Each thread owns one series and publishes while the flush thread keeps swapping windows
+    const int n_threads = 4;
+    const int n_publish = 20000;
+    metric_schema schema;
+    schema("n_sum", field_aggregation::sum, 0);
+    std::vector<int> ids;
+    for(int t = 0; t < n_threads; t++)
+        ids.push_back(ag.register_series("shard", {{"t", std::to_string(t)}}, schema.fields));
+
+    std::vector<std::thread> publishers;
+    for(int t = 0; t < n_threads; t++)
+    {
+        publishers.emplace_back([&ag, &ids, t, n_publish]() {
+            const double one = 1.0;
+            for(int i = 0; i < n_publish; i++) ag.add_values(ids[t], &one, i + 1);
+        });
+    }
+    for(auto &p: publishers) p.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // No sample is lost or counted twice across the window swaps
+    std::vector<double> totals(n_threads, 0.0);
+    std::lock_guard<std::mutex> lk(lines_mtx);
+    for(const std::string &line: lines)
+    {
+        int t = -1;
+        double n = 0;
+        const int parsed = std::sscanf(line.c_str(), "shard,t=%d n_sum=%lf", &t, &n);
+        assert(parsed == 2 && t >= 0 && t < n_threads);
+        totals[t] += n;
+    }
+    for(int t = 0; t < n_threads; t++) assert(totals[t] == n_publish);
+}
+
+void test_metric_window_handover()
+{
+    aggregator ag;
+    std::mutex lines_mtx;
+    std::vector<std::string> lines;
+    ag.set_emit_callback([&](const std::string &line) {
+        std::lock_guard<std::mutex> lk(lines_mtx);
+        lines.push_back(line);
+    });
+
+    metric_schema schema;
+    schema("a_sum", field_aggregation::sum, 0);
+    schema("b_mean", field_aggregation::mean, 0);
+    schema("c_last", field_aggregation::last, 0);
+    metric_window window;
+    window.init(ag.register_series("w", {}, schema.fields), schema.fields.size(), 2);
+
+    // Sampled on every second slot: slots 2 and 4 out of 5
+    int sampled = 0;
+    for(int slot = 1; slot <= 5; slot++)
+    {
+        if(!window.sample_due()) continue;
+        window("a_sum", field_aggregation::sum, slot);
+        window("b_mean", field_aggregation::mean, 10.0 * slot);
+        window("c_last", field_aggregation::last, slot);
+        window.end_sample();
+        sampled++;
+    }
+    assert(sampled == 2 && window.sample_count() == 2);
+    ag.add_window(window.id(), window.sum_values(), window.last_values(), window.sample_count(), 50);
+    window.reset(1);
+    assert(window.sample_count() == 0 && window.handed_over_window() == 1);
+
+    monitoring_config cfg;
+    cfg.aggregation_window_ms = 10;
+    ag.init(cfg);
+    for(int i = 0; i < 100 && ag.window_index() < 2; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::lock_guard<std::mutex> lk(lines_mtx);
+    assert(lines.size() == 1);
+    assert(lines.front() == "w a_sum=12.000000,b_mean=30.000000,c_last=4.000000 50");
+}
+
+void test_aggregator_stop_flushes_open_window()
+{
+    std::vector<std::string> lines;
+    aggregator ag;
+    ag.set_emit_callback([&](const std::string &line) { lines.push_back(line); });
+    int flushes = 0;
+    ag.set_flush_callback([&]() { flushes++; });
+
+    metric_schema schema;
+    schema("a_sum", field_aggregation::sum, 0);
+    metric_window window;
+    window.init(ag.register_series("w", {}, schema.fields), schema.fields.size(), 1);
+
+    // A run much shorter than one window: nothing is emitted until stop()
+    monitoring_config cfg;
+    cfg.aggregation_window_ms = 60000;
+    ag.init(cfg);
+    for(int slot = 1; slot <= 3; slot++)
+    {
+        if(!window.sample_due()) continue;
+        window("a_sum", field_aggregation::sum, slot);
+        window.end_sample();
+    }
+    assert(ag.window_index() == 0);
+    ag.add_window(window.id(), window.sum_values(), window.last_values(), window.sample_count(), 70);
+
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    ag.stop();
+    assert(std::chrono::steady_clock::now() - t0 < std::chrono::seconds(5));
+    assert(lines.size() == 1 && lines.front() == "w a_sum=6.000000 70");
+    assert(flushes == 1);
+    ag.stop();
+    assert(lines.size() == 1 && flushes == 1);
+}
+
+void test_line_protocol_formatting()
+{
+    const double values[] = {0.0, 1.5, -2.25, 1234567.1234564, 0.0000004, -0.0000004, 58906936.324219, 1e12};
+    for(double v: values)
+    {
+        std::string out = "x=";
+        lp_append_fixed6(out, v);
+        char expected[64];
+        std::snprintf(expected, sizeof(expected), "x=%.6f", v);
+        assert(out == expected);
+    }
+    std::string ts;
+    lp_append_int(ts, 1792363272764587941LL);
+    lp_append_int(ts, -42);
+    lp_append_int(ts, 0);
+    assert(ts == "1792363272764587941-420");
+}
+
+void test_influx_sender_batches_datagrams()
+{
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(rx >= 0);
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(rx, (sockaddr*)&sa, sizeof(sa)) == 0);
+    socklen_t len = sizeof(sa);
+    getsockname(rx, (sockaddr*)&sa, &len);
+
+    monitoring_config cfg;
+    cfg.udp_payload_bytes = 256;
+    monitoring_output_config out;
+    out.name = "test";
+    out.type = "udp";
+    out.address = "127.0.0.1";
+    out.port = ntohs(sa.sin_port);
+    cfg.outputs.push_back(out);
+
+    std::string expected;
+    {
+        influx_sender sender;
+        sender.init(cfg);
+        for(int i = 0; i < 20; i++)
+        {
+            std::string line = "m,ue_id=" + std::to_string(i) + " f=1.000000 " + std::to_string(1000 + i);
+            line.resize(60, '0');
+            sender.send_line(line);
+            expected += line + "\n";
+        }
+        sender.flush();
+    }
+
+    // 20 lines of 61 bytes, four per 256 byte datagram
+    std::string received;
+    int datagrams = 0;
+    char buf[2048];
+    while(received.size() < expected.size())
+    {
+        ssize_t n = recv(rx, buf, sizeof(buf), 0);
+        assert(n > 0 && n <= cfg.udp_payload_bytes);
+        received.append(buf, n);
+        datagrams++;
+    }
+    close(rx);
+    assert(received == expected);
+    assert(datagrams == 5);
+}
+
+void test_influx_sender_skips_failed_destination()
+{
+    const std::string missing = "/tmp/fikore_influx_missing.sock";
+    const std::string listening = "/tmp/fikore_influx_listening.sock";
+    std::remove(missing.c_str());
+    std::remove(listening.c_str());
+    int rx = socket(AF_UNIX, SOCK_DGRAM, 0);
+    assert(rx >= 0);
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    std::strncpy(sa.sun_path, listening.c_str(), sizeof(sa.sun_path) - 1);
+    assert(bind(rx, (sockaddr*)&sa, sizeof(sa)) == 0);
+
+    monitoring_config cfg;
+    cfg.udp_payload_bytes = 256;
+    monitoring_output_config out;
+    out.type = "unix";
+    out.name = "missing";
+    out.address = missing;
+    cfg.outputs.push_back(out);
+    out.name = "listening";
+    out.address = listening;
+    cfg.outputs.push_back(out);
+
+    // The destination without a listener fails every flush: one error line, and the next
+    // destination still gets every datagram
+    std::ostringstream errors;
+    std::streambuf *old_cerr = std::cerr.rdbuf(errors.rdbuf());
+    std::string expected;
+    {
+        influx_sender sender;
+        sender.init(cfg);
+        for(int flush = 0; flush < 3; flush++)
+        {
+            for(int i = 0; i < 8; i++)
+            {
+                std::string line = "m,ue_id=" + std::to_string(i) + " f=1.000000 " + std::to_string(1000 + i);
+                line.resize(60, '0');
+                sender.send_line(line);
+                expected += line + "\n";
+            }
+            sender.flush();
+        }
+    }
+    std::cerr.rdbuf(old_cerr);
+
+    std::string received;
+    char buf[2048];
+    while(received.size() < expected.size())
+    {
+        ssize_t n = recv(rx, buf, sizeof(buf), 0);
+        assert(n > 0);
+        received.append(buf, n);
+    }
+    close(rx);
+    std::remove(listening.c_str());
+    assert(received == expected);
+    const std::string text = errors.str();
+    assert(text.find("missing") != std::string::npos);
+    assert(std::count(text.begin(), text.end(), '\n') == 1);
+}
+
+// Reads back the recorder file: per UE, the t and rdl columns of every chunk in order.
+void read_record(const std::string &path, std::unordered_map<int, std::vector<std::pair<double, float>>> &rows,
+                 int &compressed_chunks)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(file.size() >= 16 && std::string(file.data(), 8) == RECORDER_MAGIC);
+    uint32_t n_columns = 0;
+    std::memcpy(&n_columns, &file[12], 4);
+    assert(n_columns == REC_N_COLUMNS);
+    assert(file[16] == 1 && std::string(&file[17]) == "t");
+    size_t off = 16 + n_columns * (1 + RECORDER_NAME_LEN);
+
+    compressed_chunks = 0;
+    while(off < file.size())
+    {
+        uint32_t magic, rows_n, codec;
+        int32_t ue_id;
+        uint64_t stored, raw_bytes;
+        std::memcpy(&magic, &file[off], 4);
+        std::memcpy(&ue_id, &file[off + 4], 4);
+        std::memcpy(&rows_n, &file[off + 8], 4);
+        std::memcpy(&codec, &file[off + 12], 4);
+        std::memcpy(&stored, &file[off + 16], 8);
+        std::memcpy(&raw_bytes, &file[off + 24], 8);
+        assert(magic == RECORDER_CHUNK_MAGIC);
+        off += 32;
+        std::vector<char> raw(raw_bytes);
+        if(codec == RECORDER_CODEC_ZLIB)
+        {
+            uLongf out_len = raw_bytes;
+            assert(uncompress((Bytef*)raw.data(), &out_len, (const Bytef*)&file[off], stored) == Z_OK);
+            assert(out_len == raw_bytes);
+            compressed_chunks++;
+        }
+        else
+        {
+            assert(stored == raw_bytes);
+            std::memcpy(raw.data(), &file[off], raw_bytes);
+        }
+        off += (stored + 7) & ~(uint64_t)7;
+
+        size_t rdl = 0;
+        for(int col = 0; col < REC_RDL; col++) rdl += binary_recorder::column_bytes(col, rows_n);
+        for(uint32_t r = 0; r < rows_n; r++)
+        {
+            double t;
+            float v;
+            std::memcpy(&t, &raw[r * 8], 8);
+            std::memcpy(&v, &raw[rdl + r * 4], 4);
+            rows[ue_id].push_back(std::make_pair(t, v));
+        }
+    }
+    assert(off == file.size());
+}
+
+void test_binary_recorder_roundtrip()
+{
+    const char *codecs[] = {"none", "zlib"};
+    for(const char *codec: codecs)
+    {
+        const std::string path = "/tmp/fikore_recorder_test.bin";
+        {
+            recorder_config cfg;
+            cfg.enabled = true;
+            cfg.path = path;
+            cfg.compression = codec;
+            cfg.chunk_rows = 4;
+            binary_recorder rec;
+            assert(rec.open(cfg));
+            recorder_stream *a = rec.open_stream(3);
+            recorder_stream *b = rec.open_stream(7);
+            double row[REC_N_COLUMNS] = {0};
+            for(int i = 0; i < 10; i++)
+            {
+                row[REC_T] = 1000.0 + i;
+                row[REC_RDL] = i * 0.5;
+                a->record(row);
+                if(i < 5)
+                {
+                    row[REC_RDL] = -i;
+                    b->record(row);
+                }
+            }
+            rec.close();
+        }
+
+        std::unordered_map<int, std::vector<std::pair<double, float>>> rows;
+        int compressed_chunks = 0;
+        read_record(path, rows, compressed_chunks);
+        std::remove(path.c_str());
+        assert(rows.size() == 2 && rows[3].size() == 10 && rows[7].size() == 5);
+        for(int i = 0; i < 10; i++)
+        {
+            assert(rows[3][i].first == 1000.0 + i);
+            assert(rows[3][i].second == i * 0.5f);
+        }
+        for(int i = 0; i < 5; i++) assert(rows[7][i].second == -i);
+        // The mostly zero columns compress
+        assert(std::string(codec) == "zlib" ? compressed_chunks > 0 : compressed_chunks == 0);
+    }
+}
+
+void test_log_writer_shared_thread()
+{
+    log_writer_config cfg;
+    cfg.queue_bytes = 256 << 10; // Room for every line: nothing may be dropped
+    cfg.buffer_bytes = 1024;
+    cfg.flush_ms = 1;
+    const std::string paths[2] = {"/tmp/fikore_log_writer_test/a.txt", "/tmp/fikore_log_writer_test/b.txt"};
+    for(const std::string &path: paths) std::remove(path.c_str());
+    {
+        log_writer writer;
+        writer.configure(cfg);
+        log_stream *streams[2] = {writer.open_stream(paths[0]), writer.open_stream(paths[1])};
+        assert(streams[0] != nullptr && streams[1] != nullptr);
+        std::vector<std::thread> producers;
+        for(int p = 0; p < 2; p++)
+        {
+            producers.emplace_back([p, &streams]() {
+                for(int i = 0; i < 5000; i++)
+                {
+                    std::string line = "ue:" + std::to_string(p) + " line:" + std::to_string(i);
+                    bool queued = streams[p]->write(line.data(), line.size());
+                    assert(queued);
+                }
+            });
+        }
+        for(auto &t: producers) t.join();
+        writer.stop();
+    }
+
+    for(int p = 0; p < 2; p++)
+    {
+        std::ifstream in(paths[p]);
+        std::string line;
+        int i = 0;
+        while(std::getline(in, line))
+        {
+            assert(line == "ue:" + std::to_string(p) + " line:" + std::to_string(i));
+            i++;
+        }
+        assert(i == 5000);
+        std::remove(paths[p].c_str());
+    }
+    rmdir("/tmp/fikore_log_writer_test");
+}
+
+void test_health_endpoint_snapshot()
+{
+    const std::string path = "/tmp/fikore_health_test.sock";
+    health_endpoint health;
+    assert(health.add_ue() == nullptr);
+    assert(health.open(path, true));
+    ue_health_counters *ues[2] = {health.add_ue(), health.add_ue()};
+    assert(ues[0] != nullptr && ues[1] != nullptr);
+    ues[0]->pdcp_ns.fetch_add(4000000);
+    ues[1]->pdcp_ns.fetch_add(2000000);
+    ues[0]->mobility_ns.fetch_add(1000000);
+    ues[0]->ip_packets[TX_DL].store(7);
+    ues[1]->ip_packets[TX_DL].store(3);
+    ues[1]->harq_packets[TX_UL].store(2);
+    // 100 slots: 98 on time, one 100 us and one 5000 us late
+    for(int i = 0; i < 100; i++)
+    {
+        const std::int64_t lateness = (i == 10) ? 100 : (i == 20) ? 5000 : 0;
+        health.slot_done(0.001 * (i + 1), lateness, 1000000, 2000000);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    std::strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+    assert(connect(fd, (sockaddr*)&sa, sizeof(sa)) == 0);
+    std::string body;
+    char buf[1024];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0) body.append(buf, n);
+    close(fd);
+
+    nlohmann::json j = nlohmann::json::parse(body);
+    assert(j["mode"] == "realtime");
+    assert(j["slots"] == 100);
+    assert(j["ues"] == 2);
+    assert(std::fabs(j["sim_time_s"].get<double>() - 0.1) < 1e-6);
+    assert(std::fabs(j["step_time_ms_mean"]["mac"].get<double>() - 1.0) < 1e-9);
+    assert(std::fabs(j["step_time_ms_mean"]["ue"].get<double>() - 2.0) < 1e-9);
+    assert(std::fabs(j["step_time_ms_mean"]["pdcp"].get<double>() - 0.06) < 1e-9);
+    assert(std::fabs(j["step_time_ms_mean"]["mobility"].get<double>() - 0.01) < 1e-9);
+    assert(j["step_time_ms_mean"]["monitoring"].get<double>() == 0.0);
+    assert(j["slot_lateness_us"]["p50"] == 0);
+    assert(j["slot_lateness_us"]["p99"] == 127);
+    assert(j["slot_lateness_us"]["max"] == 5000);
+    assert(j["queues"]["ip_packets"]["dl"] == 10);
+    assert(j["queues"]["ip_packets"]["max_ue"] == 7);
+    assert(j["queues"]["harq_packets"]["ul"] == 2);
+
+    health.close();
+    assert(!health.is_open());
+    assert(access(path.c_str(), F_OK) != 0);
+}
+
+void test_terminal_log_rate_limit()
+{
+    terminal_flush();
+    std::ostringstream captured;
+    std::streambuf *stdout_buf = std::cout.rdbuf(captured.rdbuf());
+
+    // Distinct lines, like one per UE, all go through; a burst of the same line is limited
+    static terminal_site site; // The writer keeps a pointer to sites that suppressed lines
+    const uint64_t window = ms_since_start() / 1000;
+    for(int i = 0; i < 100; i++)
+    {
+        terminal_voidify() & terminal_line(site, BLUE, "INFO", "test_terminal_log_rate_limit") << "ue " << i << END();
+    }
+    for(int i = 0; i < 100; i++)
+    {
+        terminal_voidify() & terminal_line(site, RED, "ERROR", "test_terminal_log_rate_limit") << "burst line" << END();
+    }
+    const bool same_window = ms_since_start() / 1000 == window;
+    if(same_window) assert(site.suppressed.load() == 100 - TERMINAL_LOG_RATE);
+
+    // Counts still pending are reported by the flush, not only with the site's next line
+    terminal_flush();
+    std::cout.rdbuf(stdout_buf);
+    assert(site.suppressed.load() == 0);
+    const std::string text = captured.str();
+    assert(text.find("ue 0") != std::string::npos && text.find("ue 99") != std::string::npos);
+    if(same_window)
+    {
+        const std::string note = "last [ERROR][test_terminal_log_rate_limit] line repeated " + std::to_string(100 - TERMINAL_LOG_RATE) + " more times";
+        assert(text.find(note) != std::string::npos);
+    }
+    // Compiled out levels never build their line
+    int evaluated = 0;
+    TERMINAL_LOG(TERMINAL_LOG_LEVEL - 1, BLUE, "INFO", "test_terminal_log_rate_limit") << ++evaluated << END();
+    assert(evaluated == 0);
+}
 }
 
 int main()
@@ -477,11 +1728,36 @@ int main()
     test_simulated_pdcp_timeout_drop();
     test_harq_and_packet_handlers();
     test_harq_timeout_drop();
+    test_release_wheel_jittered_release();
+    test_release_wheel_oldest_by_ip_t();
+    test_spsc_ring_handoff();
     test_captured_packet_handler_release();
     test_captured_packet_handler_timeout_drop();
+    test_captured_packet_handler_reorders_by_uid();
+    test_captured_packet_handler_uses_arrival_timestamps();
+    test_captured_packet_handler_accounts_gso_segments();
+    test_captured_gso_overflow_stays_whole();
+    test_pkt_capture_group_merges_queues();
+    test_packet_mmap_capture_frames();
+    test_pkt_capture_slab_slot_reuse();
+    test_synthetic_capture_replays_trace();
     test_simulated_packet_handler_final_verdicts();
+    test_simulated_packet_handler_fluid_bursts();
+    test_simulated_packet_handler_fluid_partial_drop();
     test_dualpi2_classification_and_ce_marking();
     test_dualpi2_classic_drop_notification();
+    test_dualpi2_fragment_stays_at_head();
     test_captured_packet_handler_rewrites_ecn_payload();
+    test_aggregator_registered_series();
+    test_aggregator_sharded_publishers();
+    test_metric_window_handover();
+    test_aggregator_stop_flushes_open_window();
+    test_line_protocol_formatting();
+    test_influx_sender_batches_datagrams();
+    test_influx_sender_skips_failed_destination();
+    test_binary_recorder_roundtrip();
+    test_log_writer_shared_thread();
+    test_health_endpoint_snapshot();
+    test_terminal_log_rate_limit();
     return 0;
 }